@@ -5,12 +5,95 @@
 #define SYNC_CONSENSUS_PARAMS_H
 
 #include <stdint.h>
+#include <array>
+#include <cstddef>
 #include <limits>
-#include <map>
-#include <string>
+#include <string_view>
 
 namespace Consensus {
 
+/**
+ * Consensus features that activate at a block height
+ */
+enum class Feature : uint8_t {
+    PODD,                   // Proof-of-Device-Distribution bonus
+    SMALL_MINER_BOOST,      // Tiered small miner multipliers
+    SQUAD_MINING,           // Squad formation and squad bonus
+    DEVICE_REGISTRY,        // On-chain device registration
+    COUNT
+};
+
+constexpr size_t FEATURE_COUNT = static_cast<size_t>(Feature::COUNT);
+
+/** Activation height of every feature, indexed by Feature */
+using ActivationHeights = std::array<int32_t, FEATURE_COUNT>;
+
+/** Names of the features in configuration, indexed by Feature */
+constexpr std::array<std::string_view, FEATURE_COUNT> FEATURE_NAMES = {
+    "podd",
+    "small_miner_boost",
+    "squad_mining",
+    "device_registry"
+};
+
+/**
+ * Look up a feature by its configuration name; for parsing configuration
+ * only, consensus code checks features by enum
+ * @return False if no feature has that name
+ */
+constexpr bool ParseFeature(std::string_view name, Feature& feature) {
+    for (size_t i = 0; i < FEATURE_COUNT; ++i) {
+        if (FEATURE_NAMES[i] == name) {
+            feature = static_cast<Feature>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Block subsidy of each halving epoch. A non-negative int64 subsidy halved
+ * 63 times is zero, so every later epoch pays the last entry, 0.
+ */
+constexpr size_t SUBSIDY_EPOCHS = 64;
+using SubsidySchedule = std::array<int64_t, SUBSIDY_EPOCHS>;
+
+constexpr SubsidySchedule MakeSubsidySchedule(int64_t initial_subsidy) {
+    SubsidySchedule schedule{};
+    int64_t subsidy = initial_subsidy < 0 ? 0 : initial_subsidy;
+    for (size_t epoch = 0; epoch < SUBSIDY_EPOCHS; ++epoch) {
+        schedule[epoch] = subsidy;
+        subsidy >>= 1;
+    }
+    return schedule;
+}
+
+static_assert(MakeSubsidySchedule(std::numeric_limits<int64_t>::max())[SUBSIDY_EPOCHS - 1] == 0,
+              "the last epoch of every schedule must pay nothing");
+
+/** Mainnet activation heights */
+constexpr ActivationHeights MAINNET_ACTIVATION_HEIGHTS = {
+    1000,   // PODD
+    1,      // SMALL_MINER_BOOST: active from genesis
+    2000,   // SQUAD_MINING
+    500     // DEVICE_REGISTRY
+};
+
+/** Testnet activates every feature immediately */
+constexpr ActivationHeights TESTNET_ACTIVATION_HEIGHTS = {1, 1, 1, 1};
+
+/** Regtest keeps mainnet's heights, so activation can be exercised */
+constexpr ActivationHeights REGTEST_ACTIVATION_HEIGHTS = MAINNET_ACTIVATION_HEIGHTS;
+
+/**
+ * Initial block subsidy, in satoshis, that every subsidy so far has been
+ * derived from. 50 SYNC was intended, but the original initializer
+ * 50 * 100000000 was evaluated in int and wrapped to 705032704 (about 7.05
+ * SYNC). Paying the intended amount would be a consensus change of its own,
+ * so the wrapped value is kept, spelled out.
+ */
+constexpr int64_t LEGACY_INITIAL_SUBSIDY = 705032704;
+
 /**
  * Parameters that influence chain consensus.
  * Optimized for small-scale miners (Bitaxe, etc.)
@@ -24,8 +107,8 @@ struct Params {
         return 288; // 288 blocks = ~24 hours at 5 min/block
     }
     
-    /** Initial block subsidy (50 SYNC to support small miners) */
-    int64_t nInitialSubsidy = 50 * 100000000; // 50 SYNC in satoshis
+    /** Initial block subsidy (see LEGACY_INITIAL_SUBSIDY; not 50 SYNC) */
+    int64_t nInitialSubsidy = LEGACY_INITIAL_SUBSIDY;
     
     /** Subsidy halving interval */
     int32_t nSubsidyHalvingInterval = 210000;
@@ -103,12 +186,7 @@ struct Params {
     uint32_t nChainId = 0x53594E43; // "SYNC" in hex
     
     /** Activation heights for features */
-    std::map<std::string, int32_t> activationHeights = {
-        {"podd", 1000},           // PoDD activation
-        {"small_miner_boost", 1},  // Active from genesis
-        {"squad_mining", 2000},    // Squad mining activation
-        {"device_registry", 500}   // Device registration activation
-    };
+    ActivationHeights activationHeights = MAINNET_ACTIVATION_HEIGHTS;
     
     /**
      * Get reward multiplier based on hashrate
@@ -129,12 +207,21 @@ struct Params {
     /**
      * Check if a feature is active at given height
      */
-    bool IsFeatureActive(const std::string& feature, int32_t height) const {
-        auto it = activationHeights.find(feature);
-        if (it != activationHeights.end()) {
-            return height >= it->second;
+    constexpr bool IsFeatureActive(Feature feature, int32_t height) const {
+        return height >= activationHeights[static_cast<size_t>(feature)];
+    }
+    
+    /**
+     * Override a feature's activation height by configuration name
+     * @return False if no feature has that name
+     */
+    bool SetActivationHeight(std::string_view feature_name, int32_t height) {
+        Feature feature;
+        if (!ParseFeature(feature_name, feature)) {
+            return false;
         }
-        return false;
+        activationHeights[static_cast<size_t>(feature)] = height;
+        return true;
     }
 };
 
@@ -149,12 +236,7 @@ struct TestNetParams : public Params {
         nChainId = 0x54455354; // "TEST" in hex
         
         // Activate all features immediately on testnet
-        activationHeights = {
-            {"podd", 1},
-            {"small_miner_boost", 1},
-            {"squad_mining", 1},
-            {"device_registry", 1}
-        };
+        activationHeights = TESTNET_ACTIVATION_HEIGHTS;
     }
 };
 
@@ -167,6 +249,7 @@ struct RegTestParams : public Params {
         nPowTargetSpacing = 1; // 1 second blocks
         minerBoost.tier1_hashrate = 0.001; // 1 GH/s
         nChainId = 0x52454754; // "REGT" in hex
+        activationHeights = REGTEST_ACTIVATION_HEIGHTS;
     }
 };
 
@@ -0,0 +1,88 @@
+// Copyright (c) 2024 SyntheticCoin Developers
+// Distributed under the MIT software license
+
+#ifndef SYNC_MINING_INT128_H
+#define SYNC_MINING_INT128_H
+
+#include <cstdint>
+
+namespace Mining {
+
+/**
+ * Full 128-bit product of two unsigned 64-bit integers, as high and low
+ * halves. Built from 32-bit partial products, none of whose sums can carry
+ * out, so it needs no compiler extension.
+ */
+inline void MultiplyWide(uint64_t a, uint64_t b, uint64_t& high, uint64_t& low) {
+    const uint64_t a_lo = a & 0xffffffff, a_hi = a >> 32;
+    const uint64_t b_lo = b & 0xffffffff, b_hi = b >> 32;
+    const uint64_t lo_lo = a_lo * b_lo;
+    const uint64_t hi_lo = a_hi * b_lo;
+    const uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xffffffff) + a_lo * b_hi;
+    high = a_hi * b_hi + (hi_lo >> 32) + (cross >> 32);
+    low = (cross << 32) | (lo_lo & 0xffffffff);
+}
+
+/**
+ * Signed 128-bit accumulator in two's complement, held as two 64-bit halves.
+ *
+ * It only adds and subtracts exact products of 64-bit integers, which is all
+ * MinerDistribution's aggregates need, and converts to floating point for the
+ * metrics read from them. Wraps modulo 2^128 like the built-in unsigned
+ * types; the aggregates stay far inside the range.
+ */
+class Int128 {
+public:
+    Int128() = default;
+
+    static Int128 FromInt64(int64_t value) {
+        Int128 result;
+        result.m_low = static_cast<uint64_t>(value);
+        result.m_high = value < 0 ? ~uint64_t{0} : 0;
+        return result;
+    }
+
+    /** Exact product of two signed 64-bit integers */
+    static Int128 Multiply(int64_t a, int64_t b) {
+        // Multiply the magnitudes, then restore the sign; the magnitude of
+        // INT64_MIN still fits in a uint64_t
+        uint64_t a_abs = a < 0 ? 0 - static_cast<uint64_t>(a) : static_cast<uint64_t>(a);
+        uint64_t b_abs = b < 0 ? 0 - static_cast<uint64_t>(b) : static_cast<uint64_t>(b);
+        Int128 result;
+        MultiplyWide(a_abs, b_abs, result.m_high, result.m_low);
+        return (a < 0) != (b < 0) ? -result : result;
+    }
+
+    Int128 operator-() const {
+        Int128 result;
+        result.m_low = ~m_low + 1;
+        result.m_high = ~m_high + (result.m_low == 0 ? 1 : 0);
+        return result;
+    }
+
+    Int128& operator+=(const Int128& other) {
+        uint64_t low = m_low + other.m_low;
+        m_high += other.m_high + (low < m_low ? 1 : 0);
+        m_low = low;
+        return *this;
+    }
+
+    Int128& operator-=(const Int128& other) { return *this += -other; }
+
+    bool IsNegative() const { return (m_high >> 63) != 0; }
+
+    long double ToLongDouble() const {
+        if (IsNegative()) {
+            return -(-*this).ToLongDouble();
+        }
+        return static_cast<long double>(m_high) * 18446744073709551616.0L + static_cast<long double>(m_low);
+    }
+
+private:
+    uint64_t m_high = 0;
+    uint64_t m_low = 0;
+};
+
+} // namespace Mining
+
+#endif // SYNC_MINING_INT128_H
@@ -0,0 +1,246 @@
+// Copyright (c) 2024 SyntheticCoin Developers
+// Distributed under the MIT software license
+
+#include "miner_distribution.h"
+
+namespace Mining {
+
+MinerDistribution::MinerDistribution() = default;
+
+MinerDistribution::MinerId MinerDistribution::Add(const std::string& address, int64_t amount) {
+    auto [it, inserted] = m_by_address.try_emplace(address, Miner{NIL, 0});
+    Miner& miner = it->second;
+    if (inserted) {
+        uint32_t node;
+        if (!m_free.empty()) {
+            node = m_free.back();
+            m_free.pop_back();
+        } else {
+            node = static_cast<uint32_t>(m_nodes.size());
+            m_nodes.emplace_back();
+            m_addresses.emplace_back();
+        }
+        m_nodes[node] = Node{0, NextPriority(), NIL, NIL, 1, 0};
+        m_addresses[node] = &it->first;
+        miner.node = node;
+        Attach(node);
+    }
+    ++miner.rewards;
+    SetTotal(miner.node, m_nodes[miner.node].total + amount);
+    return miner.node;
+}
+
+void MinerDistribution::Remove(MinerId node, int64_t amount) {
+    auto it = m_by_address.find(*m_addresses[node]);
+    Miner& miner = it->second;
+    SetTotal(node, m_nodes[node].total - amount);
+    if (--miner.rewards == 0) {
+        Detach(node);
+        m_free.push_back(node);
+        m_addresses[node] = nullptr;
+        m_by_address.erase(it);
+    }
+}
+
+void MinerDistribution::Clear() {
+    m_nodes.clear();
+    m_addresses.clear();
+    m_free.clear();
+    m_by_address.clear();
+    m_root = NIL;
+    m_sum = 0;
+    m_sum_squares = Int128();
+    m_rank_weighted = Int128();
+}
+
+int64_t MinerDistribution::GetTotal(const std::string& address) const {
+    auto it = m_by_address.find(address);
+    return it == m_by_address.end() ? 0 : m_nodes[it->second.node].total;
+}
+
+double MinerDistribution::Gini() const {
+    if (m_by_address.empty() || m_sum <= 0) {
+        return 0.0;
+    }
+    // sum over ascending ranks of (2i - n - 1) * x_i = 2 * sum(i * x_i) - (n + 1) * sum(x_i)
+    int64_t n = static_cast<int64_t>(m_by_address.size());
+    Int128 differences = m_rank_weighted;
+    differences += m_rank_weighted;
+    differences -= Int128::Multiply(n + 1, m_sum);
+    return static_cast<double>(differences.ToLongDouble()) /
+           (static_cast<double>(n) * static_cast<double>(m_sum));
+}
+
+double MinerDistribution::Herfindahl() const {
+    if (m_sum <= 0) {
+        return 0.0;
+    }
+    long double total = m_sum;
+    return static_cast<double>(m_sum_squares.ToLongDouble() / (total * total));
+}
+
+uint32_t MinerDistribution::Nakamoto() const {
+    // Take the largest totals first: at each node, the right subtree is all
+    // larger, so either it alone crosses half or it is taken whole
+    int64_t half = m_sum / 2;
+    int64_t taken = 0;
+    uint32_t miners = 0;
+    uint32_t n = m_root;
+    while (n != NIL) {
+        const Node& node = m_nodes[n];
+        if (taken + Sum(node.right) > half) {
+            n = node.right;
+            continue;
+        }
+        taken += Sum(node.right) + node.total;
+        miners += Size(node.right) + 1;
+        if (taken > half) {
+            return miners;
+        }
+        n = node.left;
+    }
+    return miners;
+}
+
+void MinerDistribution::ForEachLargest(size_t count,
+                                       const std::function<void(const std::string&, int64_t)>& fn) const {
+    size_t remaining = count;
+    VisitLargest(m_root, remaining, fn);
+}
+
+bool MinerDistribution::VisitLargest(uint32_t n, size_t& remaining,
+                                     const std::function<void(const std::string&, int64_t)>& fn) const {
+    if (n == NIL || remaining == 0) {
+        return remaining > 0;
+    }
+    const Node& node = m_nodes[n];
+    if (!VisitLargest(node.right, remaining, fn)) {
+        return false;
+    }
+    fn(*m_addresses[n], node.total);
+    if (--remaining == 0) {
+        return false;
+    }
+    return VisitLargest(node.left, remaining, fn);
+}
+
+void MinerDistribution::Update(uint32_t n) {
+    Node& node = m_nodes[n];
+    node.size = 1 + Size(node.left) + Size(node.right);
+    node.sum = node.total + Sum(node.left) + Sum(node.right);
+}
+
+void MinerDistribution::Split(uint32_t root, uint32_t key, uint32_t& lower, uint32_t& upper) {
+    if (root == NIL) {
+        lower = upper = NIL;
+        return;
+    }
+    if (Less(root, key)) {
+        Split(m_nodes[root].right, key, m_nodes[root].right, upper);
+        lower = root;
+    } else {
+        Split(m_nodes[root].left, key, lower, m_nodes[root].left);
+        upper = root;
+    }
+    Update(root);
+}
+
+uint32_t MinerDistribution::Merge(uint32_t lower, uint32_t upper) {
+    if (lower == NIL) return upper;
+    if (upper == NIL) return lower;
+    if (m_nodes[lower].priority > m_nodes[upper].priority) {
+        m_nodes[lower].right = Merge(m_nodes[lower].right, upper);
+        Update(lower);
+        return lower;
+    }
+    m_nodes[upper].left = Merge(lower, m_nodes[upper].left);
+    Update(upper);
+    return upper;
+}
+
+void MinerDistribution::Insert(uint32_t node) {
+    uint32_t lower, upper;
+    Split(m_root, node, lower, upper);
+    m_root = Merge(Merge(lower, node), upper);
+}
+
+uint32_t MinerDistribution::Erase(uint32_t root, uint32_t node) {
+    if (root == node) {
+        uint32_t rest = Merge(m_nodes[node].left, m_nodes[node].right);
+        m_nodes[node].left = m_nodes[node].right = NIL;
+        m_nodes[node].size = 1;
+        m_nodes[node].sum = m_nodes[node].total;
+        return rest;
+    }
+    if (Less(node, root)) {
+        m_nodes[root].left = Erase(m_nodes[root].left, node);
+    } else {
+        m_nodes[root].right = Erase(m_nodes[root].right, node);
+    }
+    Update(root);
+    return root;
+}
+
+void MinerDistribution::RankOf(uint32_t node, uint32_t& below, int64_t& sum_above) const {
+    below = 0;
+    sum_above = 0;
+    uint32_t n = m_root;
+    while (n != NIL) {
+        const Node& current = m_nodes[n];
+        if (n == node) {
+            below += Size(current.left);
+            sum_above += Sum(current.right);
+            return;
+        }
+        if (Less(node, n)) {
+            sum_above += current.total + Sum(current.right);
+            n = current.left;
+        } else {
+            below += Size(current.left) + 1;
+            n = current.right;
+        }
+    }
+}
+
+void MinerDistribution::Detach(uint32_t node) {
+    // Every miner ranked above this one drops a rank
+    uint32_t below;
+    int64_t sum_above;
+    RankOf(node, below, sum_above);
+    int64_t total = m_nodes[node].total;
+    m_rank_weighted -= Int128::Multiply(static_cast<int64_t>(below) + 1, total);
+    m_rank_weighted -= Int128::FromInt64(sum_above);
+    m_sum -= total;
+    m_sum_squares -= Int128::Multiply(total, total);
+    m_root = Erase(m_root, node);
+}
+
+void MinerDistribution::Attach(uint32_t node) {
+    // Every miner ranked above this one rises a rank
+    uint32_t below;
+    int64_t sum_above;
+    RankOf(node, below, sum_above);
+    int64_t total = m_nodes[node].total;
+    m_rank_weighted += Int128::Multiply(static_cast<int64_t>(below) + 1, total);
+    m_rank_weighted += Int128::FromInt64(sum_above);
+    m_sum += total;
+    m_sum_squares += Int128::Multiply(total, total);
+    Insert(node);
+}
+
+void MinerDistribution::SetTotal(uint32_t node, int64_t total) {
+    Detach(node);
+    m_nodes[node].total = total;
+    m_nodes[node].sum = total;
+    Attach(node);
+}
+
+uint32_t MinerDistribution::NextPriority() {
+    // xorshift32; priorities only need to look random to the tree's shape
+    m_seed ^= m_seed << 13;
+    m_seed ^= m_seed >> 17;
+    m_seed ^= m_seed << 5;
+    return m_seed;
+}
+
+} // namespace Mining
@@ -0,0 +1,142 @@
+// Copyright (c) 2024 SyntheticCoin Developers
+// Distributed under the MIT software license
+
+#ifndef SYNC_MINING_MINER_DISTRIBUTION_H
+#define SYNC_MINING_MINER_DISTRIBUTION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "int128.h"
+
+namespace Mining {
+
+/**
+ * Reward totals per miner, with concentration metrics kept up to date.
+ *
+ * Miners sit in a treap ordered by total, augmented with subtree sizes and
+ * sums. Alongside it run three aggregates: the sum of totals, the sum of
+ * squared totals, and the sum of total * ascending rank. Changing a miner's
+ * total moves one node and adjusts the aggregates by what the move shifts,
+ * in O(log n). From the aggregates the Gini coefficient and Herfindahl index
+ * are O(1) reads. The Nakamoto coefficient is one O(log n) descent, and
+ * listing the k largest miners is O(log n + k). Nothing is ever sorted.
+ *
+ * A miner counts from its first reward until every reward it received has
+ * been removed again, so a reward of 0 still makes a miner.
+ *
+ * Not thread-safe; RewardStatistics serializes access.
+ */
+class MinerDistribution {
+public:
+    /** Names a miner for as long as it holds any reward */
+    using MinerId = uint32_t;
+
+    MinerDistribution();
+
+    /** Credit one reward to a miner */
+    MinerId Add(const std::string& address, int64_t amount);
+
+    /** Take back a reward previously credited to the miner by Add() */
+    void Remove(MinerId miner, int64_t amount);
+
+    void Clear();
+
+    /** Miners holding at least one reward */
+    size_t MinerCount() const { return m_by_address.size(); }
+
+    /** Sum of every miner's total */
+    int64_t Total() const { return m_sum; }
+
+    /** A miner's total; 0 if it holds no rewards */
+    int64_t GetTotal(const std::string& address) const;
+
+    const std::string& GetAddress(MinerId miner) const { return *m_addresses[miner]; }
+
+    /** Inequality of the totals, 0 (equal) to 1 - 1/n; 0 with no rewards */
+    double Gini() const;
+
+    /** Sum of squared shares of the total, 1/n to 1; 0 with no rewards */
+    double Herfindahl() const;
+
+    /**
+     * Fewest miners whose totals together exceed half of the total. Every
+     * miner is counted if no such set exists (the totals are all zero).
+     */
+    uint32_t Nakamoto() const;
+
+    /**
+     * Visit up to count miners from the largest total down; miners with
+     * equal totals come in no particular order
+     */
+    void ForEachLargest(size_t count,
+                        const std::function<void(const std::string&, int64_t)>& fn) const;
+
+private:
+    static constexpr uint32_t NIL = UINT32_MAX;
+
+    struct Node {
+        int64_t total;
+        uint32_t priority;
+        uint32_t left;
+        uint32_t right;
+        uint32_t size;                  // Nodes in this subtree
+        int64_t sum;                    // Totals in this subtree
+    };
+
+    struct Miner {
+        uint32_t node;                  // Also the miner's ID and tie-break in the order
+        uint32_t rewards;               // Rewards held; the miner goes at zero
+    };
+
+    // Order: by total, then by node index, so every key is distinct
+    bool Less(uint32_t a, uint32_t b) const {
+        const Node& x = m_nodes[a];
+        const Node& y = m_nodes[b];
+        return x.total < y.total || (x.total == y.total && a < b);
+    }
+
+    uint32_t Size(uint32_t n) const { return n == NIL ? 0 : m_nodes[n].size; }
+    int64_t Sum(uint32_t n) const { return n == NIL ? 0 : m_nodes[n].sum; }
+    void Update(uint32_t n);
+
+    // Split a subtree into the nodes ordered before key and the rest
+    void Split(uint32_t root, uint32_t key, uint32_t& lower, uint32_t& upper);
+    uint32_t Merge(uint32_t lower, uint32_t upper);
+
+    void Insert(uint32_t node);
+    uint32_t Erase(uint32_t root, uint32_t node);
+
+    // Move a node to a new total, keeping the aggregates in step
+    void SetTotal(uint32_t node, int64_t total);
+
+    // Take a node out of, or put it into, the tree and the aggregates
+    void Detach(uint32_t node);
+    void Attach(uint32_t node);
+
+    // Nodes ordered before the key, and the sum of those ordered after it
+    void RankOf(uint32_t node, uint32_t& below, int64_t& sum_above) const;
+
+    bool VisitLargest(uint32_t n, size_t& remaining,
+                      const std::function<void(const std::string&, int64_t)>& fn) const;
+
+    uint32_t NextPriority();
+
+    std::vector<Node> m_nodes;
+    std::vector<const std::string*> m_addresses;    // Indexed like m_nodes
+    std::vector<uint32_t> m_free;
+    std::unordered_map<std::string, Miner> m_by_address;
+    uint32_t m_root = NIL;
+    uint32_t m_seed = 0x9E3779B9;
+
+    int64_t m_sum = 0;
+    Int128 m_sum_squares;
+    Int128 m_rank_weighted;             // Sum of total * rank, ranks ascending from 1
+};
+
+} // namespace Mining
+
+#endif // SYNC_MINING_MINER_DISTRIBUTION_H
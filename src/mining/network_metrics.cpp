@@ -0,0 +1,142 @@
+// Copyright (c) 2024 SyntheticCoin Developers
+// Distributed under the MIT software license
+
+#include "network_metrics.h"
+#include <algorithm>
+
+namespace Mining {
+
+NetworkMetrics::NetworkMetrics(const Consensus::Params& params)
+    : m_tier1_ths(params.minerBoost.tier1_hashrate),
+      m_tier2_ths(params.minerBoost.tier2_hashrate),
+      m_tier3_ths(params.minerBoost.tier3_hashrate),
+      m_blocks(WINDOW),
+      m_producers_with(WINDOW + 1) {
+}
+
+void NetworkMetrics::OnBlockConnected(int32_t height, const MinerInfo& producer) {
+    Block& block = m_blocks[m_next];
+    if (m_count == WINDOW) {
+        Expire(block);
+    } else {
+        ++m_count;
+    }
+    m_next = (m_next + 1) % WINDOW;
+    m_tip = height;
+
+    // Elements of an unordered_map never move, so the block can point at
+    // its producer's entry until it expires
+    auto& entry = *m_producers.try_emplace(producer.address, 0).first;
+    block.producer = &entry;
+    AddProducerBlock(entry.second);
+
+    const double hashrate = producer.hashrate_ths;
+    block.tier = static_cast<uint8_t>((hashrate >= m_tier1_ths) + (hashrate >= m_tier2_ths) +
+                                      (hashrate >= m_tier3_ths));
+    block.small = hashrate < RewardHistory::SMALL_MINER_THS;
+    block.verified = producer.is_podd_verified;
+    ++m_tier_blocks[block.tier];
+    m_small_blocks += block.small;
+    m_verified_blocks += block.verified;
+
+    if (block.verified) {
+        // The ring's vectors keep their capacity, so this stops allocating
+        // once every slot has been used
+        block.devices.assign(producer.device_ids.begin(), producer.device_ids.end());
+        for (PoDD::InternedString device : block.devices) {
+            ++m_devices[device];
+        }
+    }
+}
+
+void NetworkMetrics::OnBlockDisconnected(int32_t height) {
+    if (m_count == 0) {
+        return;
+    }
+    m_next = (m_next + WINDOW - 1) % WINDOW;
+    Expire(m_blocks[m_next]);
+    --m_count;
+    m_tip = height - 1;
+}
+
+void NetworkMetrics::Expire(Block& block) {
+    RemoveProducerBlock(block.producer->second);
+    if (block.producer->second == 0) {
+        m_producers.erase(m_producers.find(block.producer->first));
+    }
+
+    --m_tier_blocks[block.tier];
+    m_small_blocks -= block.small;
+    m_verified_blocks -= block.verified;
+
+    for (PoDD::InternedString device : block.devices) {
+        auto it = m_devices.find(device);
+        if (--it->second == 0) {
+            m_devices.erase(it);
+        }
+    }
+    block.devices.clear();
+    block.producer = nullptr;
+}
+
+void NetworkMetrics::AddProducerBlock(uint32_t& count) {
+    if (count > 0) {
+        --m_producers_with[count];
+    }
+    m_sum_squares += 2 * static_cast<uint64_t>(count) + 1;
+    ++count;
+    ++m_producers_with[count];
+    m_max_blocks = std::max(m_max_blocks, count);
+}
+
+void NetworkMetrics::RemoveProducerBlock(uint32_t& count) {
+    --m_producers_with[count];
+    m_sum_squares -= 2 * static_cast<uint64_t>(count) - 1;
+    // The largest count only ever steps down by one, and the producer that
+    // just lost a block now holds the next count down
+    if (count == m_max_blocks && m_producers_with[count] == 0) {
+        --m_max_blocks;
+    }
+    --count;
+    if (count > 0) {
+        ++m_producers_with[count];
+    }
+}
+
+double NetworkMetrics::GetTopProducerShare() const {
+    if (m_count == 0) return 0.0;
+
+    return static_cast<double>(m_max_blocks) / m_count;
+}
+
+double NetworkMetrics::GetHerfindahlIndex() const {
+    if (m_count == 0) return 0.0;
+
+    return static_cast<double>(m_sum_squares) / (static_cast<double>(m_count) * m_count);
+}
+
+double NetworkMetrics::GetDecentralizationScore() const {
+    if (m_count == 0) return 1.0;
+
+    double producer_diversity = 1.0 - GetHerfindahlIndex();
+    double small_miner_share = static_cast<double>(m_small_blocks) / m_count;
+    double verified_share = static_cast<double>(m_verified_blocks) / m_count;
+    return PRODUCER_WEIGHT * producer_diversity + SMALL_MINER_WEIGHT * small_miner_share +
+           VERIFIED_WEIGHT * verified_share;
+}
+
+NetworkMetrics::Snapshot NetworkMetrics::GetSnapshot() const {
+    Snapshot snapshot = {};
+    snapshot.blocks = m_count;
+    snapshot.producers = GetProducerCount();
+    snapshot.top_producer_share = GetTopProducerShare();
+    snapshot.herfindahl_index = GetHerfindahlIndex();
+    snapshot.active_verified_devices = GetActiveVerifiedDevices();
+    snapshot.verified_blocks = m_verified_blocks;
+    snapshot.small_miner_blocks = m_small_blocks;
+    snapshot.tier_blocks = m_tier_blocks;
+    snapshot.decentralization_score = GetDecentralizationScore();
+    return snapshot;
+}
+
+} // namespace Mining
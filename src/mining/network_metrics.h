@@ -0,0 +1,138 @@
+// Copyright (c) 2024 SyntheticCoin Developers
+// Distributed under the MIT software license
+
+#ifndef SYNC_MINING_NETWORK_METRICS_H
+#define SYNC_MINING_NETWORK_METRICS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../consensus/params.h"
+#include "../podd/string_interner.h"
+#include "reward_calculator.h"
+
+namespace Mining {
+
+/**
+ * Decentralization of block production over the last WINDOW blocks.
+ *
+ * Each connected block adds its producer to a ring of the last WINDOW blocks.
+ * The block that leaves the ring is taken back out of the aggregates:
+ *  - blocks per producer, with the sum of their squares for the Herfindahl
+ *    index;
+ *  - producers per block count, so the largest producer's count can step
+ *    down without a search;
+ *  - blocks per miner tier, and blocks by PoDD-verified producers;
+ *  - reference counts of the devices behind verified blocks, whose number is
+ *    the count of active verified devices.
+ * Connecting a block costs O(1 + devices of its producer), expected; it only
+ * allocates for a producer or device new to the window. Every metric is then
+ * an O(1) read, so the reward adjuster can run each block without rescanning
+ * history.
+ *
+ * Blocks must be connected in order, once each, and disconnected from the
+ * tip down. Disconnecting takes the newest block back out of the ring in
+ * the same O(1 + devices); the block that left the window's far end when it
+ * connected does not return, so after a reorg the window is short by one
+ * block per disconnect until new blocks fill it.
+ *
+ * Not thread-safe; the caller serializes updates with reads.
+ */
+class NetworkMetrics {
+public:
+    /** One week of 5-minute blocks */
+    static constexpr uint32_t WINDOW = 2016;
+
+    // Weights of the decentralization score's components; they sum to 1
+    static constexpr double PRODUCER_WEIGHT = 0.5;
+    static constexpr double SMALL_MINER_WEIGHT = 0.25;
+    static constexpr double VERIFIED_WEIGHT = 0.25;
+
+    struct Snapshot {
+        uint32_t blocks;                        // Blocks in the window
+        uint32_t producers;                     // Distinct producers
+        double top_producer_share;              // Largest producer's share of the blocks
+        double herfindahl_index;                // Sum of squared producer shares
+        uint32_t active_verified_devices;       // Distinct devices behind verified blocks
+        uint32_t verified_blocks;               // Blocks by PoDD-verified producers
+        uint32_t small_miner_blocks;            // Blocks by producers under the small miner hashrate
+        std::array<uint32_t, 4> tier_blocks;    // Blocks by producer tier, tier 1 first
+        double decentralization_score;
+    };
+
+    explicit NetworkMetrics(const Consensus::Params& params);
+
+    /**
+     * Count a connected block
+     * @param producer Miner the block's reward was paid to
+     */
+    void OnBlockConnected(int32_t height, const MinerInfo& producer);
+    
+    /** Take the tip block back out; a no-op with no blocks */
+    void OnBlockDisconnected(int32_t height);
+
+    uint32_t GetBlockCount() const { return m_count; }
+    uint32_t GetProducerCount() const { return static_cast<uint32_t>(m_producers.size()); }
+    uint32_t GetActiveVerifiedDevices() const { return static_cast<uint32_t>(m_devices.size()); }
+    int32_t GetTipHeight() const { return m_tip; }
+
+    /** Largest producer's share of the window's blocks; 0 with no blocks */
+    double GetTopProducerShare() const;
+
+    /** Sum of squared producer shares, 1/producers to 1; 0 with no blocks */
+    double GetHerfindahlIndex() const;
+
+    /**
+     * Weighted sum of three fractions, each 0 to 1:
+     *  - producer diversity, 1 minus the Herfindahl index;
+     *  - share of blocks by small miners;
+     *  - share of blocks by PoDD-verified producers.
+     * 1.0 with no blocks, which asks the adjuster for no change.
+     */
+    double GetDecentralizationScore() const;
+
+    Snapshot GetSnapshot() const;
+
+private:
+    /** What a block added, kept so it can be taken out again */
+    struct Block {
+        std::pair<const std::string, uint32_t>* producer = nullptr;     // Entry in m_producers
+        uint8_t tier = 0;                       // 0-3
+        bool small = false;
+        bool verified = false;
+        std::vector<PoDD::InternedString> devices;      // Counted only if verified
+    };
+
+    void Expire(Block& block);
+
+    // Move a producer's block count by one, keeping the aggregates in step
+    void AddProducerBlock(uint32_t& count);
+    void RemoveProducerBlock(uint32_t& count);
+
+    const double m_tier1_ths;
+    const double m_tier2_ths;
+    const double m_tier3_ths;
+
+    std::vector<Block> m_blocks;                // Ring of WINDOW blocks
+    uint32_t m_next = 0;                        // Slot the next block goes to
+    uint32_t m_count = 0;                       // Blocks in the ring
+    int32_t m_tip = -1;
+
+    std::unordered_map<std::string, uint32_t> m_producers;     // Blocks per producer
+    std::vector<uint32_t> m_producers_with;     // Producers per block count, 0 to WINDOW
+    uint32_t m_max_blocks = 0;                  // Largest producer's block count
+    uint64_t m_sum_squares = 0;                 // Sum of squared block counts
+
+    std::unordered_map<PoDD::InternedString, uint32_t> m_devices;  // Verified blocks per device
+    std::array<uint32_t, 4> m_tier_blocks{};
+    uint32_t m_small_blocks = 0;
+    uint32_t m_verified_blocks = 0;
+};
+
+} // namespace Mining
+
+#endif // SYNC_MINING_NETWORK_METRICS_H
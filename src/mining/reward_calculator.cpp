@@ -2,36 +2,61 @@
 // Distributed under the MIT software license
 
 #include "reward_calculator.h"
+#include "int128.h"
+#include "network_metrics.h"
 #include <algorithm>
+#include <array>
 #include <cmath>
 #include <numeric>
 
 namespace Mining {
 
-RewardCalculator::RewardCalculator(const Consensus::Params& params) 
-    : m_params(params) {
+namespace {
+
+// a * b / d, with the remainder in remainder, through a 128-bit product held
+// as two 64-bit halves. The quotient must fit in 64 bits, as it does when
+// b <= d.
+uint64_t MulDiv(uint64_t a, uint64_t b, uint64_t d, uint64_t& remainder) {
+    uint64_t high, low;
+    MultiplyWide(a, b, high, low);
+    
+    // Shift-subtract division; high < d because the quotient fits. A bit
+    // shifted out of rem means it exceeds d, and the subtraction wraps back.
+    uint64_t quotient = 0;
+    uint64_t rem = high;
+    for (int bit = 63; bit >= 0; --bit) {
+        const bool overflow = rem >> 63;
+        rem = (rem << 1) | ((low >> bit) & 1);
+        quotient <<= 1;
+        if (overflow || rem >= d) {
+            rem -= d;
+            quotient |= 1;
+        }
+    }
+    remainder = rem;
+    return quotient;
+}
+
+} // namespace
+
+RewardCalculator::RewardCalculator(const Consensus::Params& params,
+                                   PoDD::DeviceVerifier* device_verifier,
+                                   const NetworkMetrics* network_metrics)
+    : m_params(params),
+      m_device_verifier(device_verifier),
+      m_network_metrics(network_metrics),
+      m_subsidy_schedule(Consensus::MakeSubsidySchedule(params.nInitialSubsidy)) {
 }
 
 int64_t RewardCalculator::GetBaseSubsidy(int32_t height) const {
-    // Check cache first
-    auto it = m_subsidy_cache.find(height);
-    if (it != m_subsidy_cache.end()) {
-        return it->second;
+    if (height < 0 || m_params.nSubsidyHalvingInterval <= 0) {
+        return 0;
     }
     
-    // Calculate halving epoch
-    int32_t halvings = height / m_params.nSubsidyHalvingInterval;
-    
-    // Subsidy is cut in half every halving interval
-    int64_t subsidy = m_params.nInitialSubsidy;
-    
-    // Shift right by number of halvings (equivalent to dividing by 2^halvings)
-    subsidy >>= halvings;
-    
-    // Cache the result
-    m_subsidy_cache[height] = subsidy;
-    
-    return subsidy;
+    // Subsidy is cut in half every halving interval; epochs past the end of
+    // the schedule pay nothing
+    size_t epoch = static_cast<size_t>(GetHalvingEpoch(height));
+    return m_subsidy_schedule[std::min(epoch, Consensus::SUBSIDY_EPOCHS - 1)];
 }
 
 RewardBreakdown RewardCalculator::CalculateReward(int32_t height,
@@ -43,13 +68,13 @@ RewardBreakdown RewardCalculator::CalculateReward(int32_t height,
     breakdown.base_reward = GetBaseSubsidy(height);
     
     // Calculate small miner bonus
-    if (IsFeatureActive("small_miner_boost", height)) {
+    if (IsFeatureActive(Consensus::Feature::SMALL_MINER_BOOST, height)) {
         breakdown.small_miner_bonus = CalculateSmallMinerBonus(
             miner.hashrate_ths, breakdown.base_reward);
     }
     
     // Calculate PoDD bonus
-    if (IsFeatureActive("podd", height) && miner.is_podd_verified) {
+    if (IsFeatureActive(Consensus::Feature::PODD, height) && miner.is_podd_verified) {
         breakdown.podd_bonus = CalculatePoDDBonus(
             miner.is_podd_verified, 
             miner.device_ids.size(),
@@ -61,11 +86,9 @@ RewardBreakdown RewardCalculator::CalculateReward(int32_t height,
         miner.efficiency_score, breakdown.base_reward);
     
     // Calculate squad bonus
-    if (IsFeatureActive("squad_mining", height) && miner.is_squad_member) {
-        // Get squad size (would need actual squad lookup)
-        size_t squad_size = 5; // Example
+    if (IsFeatureActive(Consensus::Feature::SQUAD_MINING, height) && miner.is_squad_member) {
         breakdown.squad_bonus = CalculateSquadBonus(
-            miner.is_squad_member, squad_size, breakdown.base_reward);
+            miner.is_squad_member, SquadSize(miner), breakdown.base_reward);
     }
     
     // Apply anti-whale penalty if needed
@@ -95,21 +118,72 @@ RewardBreakdown RewardCalculator::CalculateReward(int32_t height,
     return breakdown;
 }
 
-int64_t RewardCalculator::CalculateSmallMinerBonus(double hashrate_ths, 
-                                                  int64_t base_reward) const {
+void RewardCalculator::CalculateRewardBatch(int32_t height,
+                                            const MinerInfo* miners,
+                                            size_t count,
+                                            int64_t tx_fees,
+                                            RewardBreakdown* out) {
+    // Height-dependent state, once per batch
+    const int64_t base_reward = GetBaseSubsidy(height);
+    const bool small_miner_boost = IsFeatureActive(Consensus::Feature::SMALL_MINER_BOOST, height);
+    const bool podd = IsFeatureActive(Consensus::Feature::PODD, height);
+    const bool squad_mining = IsFeatureActive(Consensus::Feature::SQUAD_MINING, height);
+    
+    // A bonus that does not apply gets rate 0, which CalculateReward's
+    // skipped branch matches exactly
+    std::array<double, BATCH_CHUNK> small_rate, podd_rate, efficiency_rate, squad_rate, penalty;
+    
+    for (size_t begin = 0; begin < count; begin += BATCH_CHUNK) {
+        const size_t n = std::min(BATCH_CHUNK, count - begin);
+        const MinerInfo* chunk = miners + begin;
+        RewardBreakdown* result = out + begin;
+        
+        // Gather each miner's rates
+        for (size_t i = 0; i < n; ++i) {
+            const MinerInfo& miner = chunk[i];
+            small_rate[i] = small_miner_boost ? SmallMinerBonusRate(miner.hashrate_ths) : 0.0;
+            podd_rate[i] = podd && miner.is_podd_verified
+                ? PoDDBonusRate(true, miner.device_ids.size()) : 0.0;
+            efficiency_rate[i] = EfficiencyBonusRate(miner.efficiency_score);
+            squad_rate[i] = squad_mining ? SquadBonusRate(miner.is_squad_member, SquadSize(miner)) : 0.0;
+            penalty[i] = CalculateAntiWhalePenalty(miner.consecutive_blocks);
+        }
+        
+        // Amounts, with the same operations in the same order as
+        // CalculateReward
+        for (size_t i = 0; i < n; ++i) {
+            RewardBreakdown& breakdown = result[i];
+            breakdown.base_reward = base_reward;
+            breakdown.small_miner_bonus = static_cast<int64_t>(base_reward * small_rate[i]);
+            breakdown.podd_bonus = static_cast<int64_t>(base_reward * podd_rate[i]);
+            breakdown.efficiency_bonus = static_cast<int64_t>(base_reward * efficiency_rate[i]);
+            breakdown.squad_bonus = static_cast<int64_t>(base_reward * squad_rate[i]);
+            
+            int64_t total_before_penalty = breakdown.base_reward +
+                                           breakdown.small_miner_bonus +
+                                           breakdown.podd_bonus +
+                                           breakdown.efficiency_bonus +
+                                           breakdown.squad_bonus;
+            int64_t total = static_cast<int64_t>(total_before_penalty * penalty[i]) + tx_fees;
+            
+            breakdown.miner_fees = tx_fees;
+            breakdown.community_fund = total * 0.10;
+            breakdown.development_fund = total * 0.05;
+            breakdown.total_reward = total - (breakdown.community_fund + breakdown.development_fund);
+        }
+    }
+}
+
+double RewardCalculator::SmallMinerBonusRate(double hashrate_ths) const {
     double multiplier = m_params.GetMinerBoostMultiplier(hashrate_ths);
     
     // Bonus is the additional reward beyond base
-    double bonus_multiplier = multiplier - 1.0;
-    
-    return static_cast<int64_t>(base_reward * bonus_multiplier);
+    return multiplier - 1.0;
 }
 
-int64_t RewardCalculator::CalculatePoDDBonus(bool is_verified,
-                                            size_t device_count,
-                                            int64_t base_reward) const {
+double RewardCalculator::PoDDBonusRate(bool is_verified, size_t device_count) const {
     if (!is_verified || device_count == 0) {
-        return 0;
+        return 0.0;
     }
     
     // Base PoDD bonus (10%)
@@ -118,33 +192,89 @@ int64_t RewardCalculator::CalculatePoDDBonus(bool is_verified,
     // Additional bonus for multiple devices (1% per device, max 10%)
     double device_bonus = std::min(0.10, device_count * 0.01);
     
-    double total_bonus = bonus_percentage + device_bonus;
-    
-    return static_cast<int64_t>(base_reward * total_bonus);
+    return bonus_percentage + device_bonus;
 }
 
-int64_t RewardCalculator::CalculateEfficiencyBonus(double efficiency_score,
-                                                  int64_t base_reward) const {
+double RewardCalculator::EfficiencyBonusRate(double efficiency_score) {
     // Efficiency score should be between 0.0 and 1.0
     efficiency_score = std::max(0.0, std::min(1.0, efficiency_score));
     
     // Max 5% bonus for perfect efficiency
-    double bonus_percentage = efficiency_score * 0.05;
+    return efficiency_score * 0.05;
+}
+
+double RewardCalculator::SquadBonusRate(bool is_squad_member, size_t squad_size) {
+    if (!is_squad_member || squad_size < 2) {
+        return 0.0;
+    }
     
-    return static_cast<int64_t>(base_reward * bonus_percentage);
+    // 2% bonus per squad member, max 20% for full squad
+    return std::min(0.20, squad_size * 0.02);
+}
+
+int64_t RewardCalculator::CalculateSmallMinerBonus(double hashrate_ths, 
+                                                  int64_t base_reward) const {
+    return static_cast<int64_t>(base_reward * SmallMinerBonusRate(hashrate_ths));
+}
+
+int64_t RewardCalculator::CalculatePoDDBonus(bool is_verified,
+                                            size_t device_count,
+                                            int64_t base_reward) const {
+    return static_cast<int64_t>(base_reward * PoDDBonusRate(is_verified, device_count));
+}
+
+int64_t RewardCalculator::CalculateEfficiencyBonus(double efficiency_score,
+                                                  int64_t base_reward) const {
+    return static_cast<int64_t>(base_reward * EfficiencyBonusRate(efficiency_score));
 }
 
 int64_t RewardCalculator::CalculateSquadBonus(bool is_squad_member,
                                              size_t squad_size,
                                              int64_t base_reward) const {
-    if (!is_squad_member || squad_size < 2) {
-        return 0;
+    return static_cast<int64_t>(base_reward * SquadBonusRate(is_squad_member, squad_size));
+}
+
+std::vector<std::pair<std::string, int64_t>> RewardCalculator::DistributeSquadReward(
+    int64_t total_reward, const std::string& squad_id) {
+    std::vector<std::pair<std::string, uint64_t>> work;
+    if (!m_device_verifier || !m_device_verifier->TakeSquadWork(squad_id, work) || work.empty()) {
+        return {};
     }
     
-    // 2% bonus per squad member, max 20% for full squad
-    double bonus_percentage = std::min(0.20, squad_size * 0.02);
+    uint64_t total_work = 0;
+    for (const auto& member : work) {
+        total_work += member.second;
+    }
+    if (total_work == 0) {
+        for (auto& member : work) {
+            member.second = 1;
+        }
+        total_work = work.size();
+    }
     
-    return static_cast<int64_t>(base_reward * bonus_percentage);
+    // Each member's work is at most the total, so the floors fit in 64 bits
+    // and MulDiv makes them and the remainders exact
+    uint64_t reward = static_cast<uint64_t>(std::max<int64_t>(total_reward, 0));
+    std::vector<std::pair<std::string, int64_t>> payouts;
+    payouts.reserve(work.size());
+    std::array<uint64_t, PoDD::SquadMembers::CAPACITY> remainders{};
+    uint64_t paid = 0;
+    for (size_t i = 0; i < work.size(); ++i) {
+        uint64_t amount = MulDiv(reward, work[i].second, total_work, remainders[i]);
+        paid += amount;
+        payouts.emplace_back(std::move(work[i].first), static_cast<int64_t>(amount));
+    }
+    
+    // Fewer than one satoshi per member is left over
+    std::array<size_t, PoDD::SquadMembers::CAPACITY> order;
+    std::iota(order.begin(), order.begin() + payouts.size(), size_t(0));
+    std::stable_sort(order.begin(), order.begin() + payouts.size(),
+                     [&](size_t a, size_t b) { return remainders[a] > remainders[b]; });
+    for (size_t i = 0; paid < reward; ++i, ++paid) {
+        ++payouts[order[i]].second;
+    }
+    
+    return payouts;
 }
 
 uint32_t RewardCalculator::GetMinerTier(double hashrate_ths) const {
@@ -207,12 +337,13 @@ int64_t RewardCalculator::GetMaxPossibleReward(int32_t height) const {
 }
 
 double RewardCalculator::CalculateDecentralizationScore() const {
-    // This would need access to actual network data
-    // For now, return a placeholder
-    return 0.75; // Example: 75% decentralized
+    if (!m_network_metrics) {
+        return 1.0;
+    }
+    return m_network_metrics->GetDecentralizationScore();
 }
 
-bool RewardCalculator::IsFeatureActive(const std::string& feature, int32_t height) const {
+bool RewardCalculator::IsFeatureActive(Consensus::Feature feature, int32_t height) const {
     return m_params.IsFeatureActive(feature, height);
 }
 
@@ -221,108 +352,237 @@ int32_t RewardCalculator::GetHalvingEpoch(int32_t height) const {
 }
 
 // RewardStatistics implementation
-void RewardStatistics::RecordReward(const MinerInfo& miner, const RewardBreakdown& reward) {
-    RewardRecord record;
-    record.height = 0; // Would need actual height
-    record.miner_address = miner.address;
-    record.amount = reward.total_reward;
-    record.hashrate = miner.hashrate_ths;
-    record.is_small_miner = miner.hashrate_ths < 10.0;
-    record.is_podd_verified = miner.is_podd_verified;
-    record.timestamp = std::chrono::system_clock::now();
-    
-    m_records.push_back(record);
-    m_miner_totals[miner.address] += reward.total_reward;
+void RewardStatistics::Totals::Add(const Totals& other) {
+    paid += other.paid;
+    small_miner_paid += other.small_miner_paid;
+    large_miner_paid += other.large_miner_paid;
+    rewards += other.rewards;
+    small_miner_rewards += other.small_miner_rewards;
+    verified_rewards += other.verified_rewards;
 }
 
-RewardStatistics::Stats RewardStatistics::GetStatistics(uint32_t last_n_blocks) const {
-    Stats stats = {};
+void RewardStatistics::Totals::Subtract(const Totals& other) {
+    paid -= other.paid;
+    small_miner_paid -= other.small_miner_paid;
+    large_miner_paid -= other.large_miner_paid;
+    rewards -= other.rewards;
+    small_miner_rewards -= other.small_miner_rewards;
+    verified_rewards -= other.verified_rewards;
+}
+
+RewardStatistics::RewardStatistics(RewardHistory* history)
+    : m_blocks(WINDOW), m_history(history) {
+}
+
+bool RewardStatistics::RecordReward(int32_t height, const MinerInfo& miner,
+                                    const RewardBreakdown& reward) {
+    if (height < 0) {
+        return true;
+    }
+    bool recorded = true;
+    if (m_history) {
+        uint8_t flags = (miner.is_podd_verified ? RewardHistory::FLAG_PODD_VERIFIED : 0) |
+                        (miner.is_squad_member ? RewardHistory::FLAG_SQUAD_MEMBER : 0);
+        recorded = m_history->Append(height, miner.address, reward.total_reward,
+                                     miner.hashrate_ths, flags);
+    }
+    if (!m_started) {
+        m_started = true;
+        m_tip = height;
+    } else if (height > m_tip) {
+        Advance(height);
+    }
+    if (!InWindow(height)) {
+        return recorded;
+    }
     
-    // Calculate from records
-    for (const auto& record : m_records) {
-        stats.total_rewards_paid += record.amount;
-        
-        if (record.is_small_miner) {
-            stats.rewards_to_small_miners += record.amount;
-        } else {
-            stats.rewards_to_large_miners += record.amount;
-        }
-        
-        if (record.is_podd_verified) {
-            stats.verified_devices++;
-        }
+    Block& block = BlockAt(height);
+    if (block.height != height) {
+        // Never used since the window started; nothing to carry over
+        Expire(block);
+        block.height = height;
     }
     
-    // Calculate unique miners
-    std::set<std::string> unique_addresses;
-    for (const auto& record : m_records) {
-        unique_addresses.insert(record.miner_address);
+    Totals totals;
+    totals.paid = reward.total_reward;
+    totals.rewards = 1;
+    if (miner.hashrate_ths < RewardHistory::SMALL_MINER_THS) {
+        totals.small_miner_paid = reward.total_reward;
+        totals.small_miner_rewards = 1;
+    } else {
+        totals.large_miner_paid = reward.total_reward;
     }
-    stats.unique_miners = unique_addresses.size();
+    totals.verified_rewards = miner.is_podd_verified ? 1 : 0;
     
-    // Calculate Gini coefficient (income inequality)
-    if (!m_miner_totals.empty()) {
-        std::vector<int64_t> amounts;
-        for (const auto& [addr, amount] : m_miner_totals) {
-            amounts.push_back(amount);
-        }
-        std::sort(amounts.begin(), amounts.end());
-        
-        double sum_of_differences = 0;
-        double sum_of_values = 0;
-        
-        for (size_t i = 0; i < amounts.size(); ++i) {
-            sum_of_values += amounts[i];
-            sum_of_differences += (2 * (i + 1) - amounts.size() - 1) * amounts[i];
+    block.totals.Add(totals);
+    block.payouts.emplace_back(m_distribution.Add(miner.address, reward.total_reward),
+                               reward.total_reward);
+    m_totals.Add(totals);
+    return recorded;
+}
+
+bool RewardStatistics::DisconnectBlock(int32_t height) {
+    if (m_started && height <= m_tip) {
+        // Only the top WINDOW heights can hold blocks
+        int32_t lowest = std::max(height, m_tip - static_cast<int32_t>(WINDOW) + 1);
+        for (int32_t h = m_tip; h >= lowest; --h) {
+            Block& block = BlockAt(h);
+            if (block.height == h) {
+                Expire(block);
+            }
         }
-        
-        if (sum_of_values > 0) {
-            stats.gini_coefficient = sum_of_differences / (amounts.size() * sum_of_values);
+        m_tip = height - 1;
+        if (m_tip < 0) {
+            m_started = false;
+            m_tip = 0;
         }
     }
+    return !m_history || m_history->Rewind(height - 1);
+}
+
+RewardStatistics::Stats RewardStatistics::GetStatistics(uint32_t last_n_blocks) const {
+    Stats stats = {};
     
-    // Calculate Herfindahl index (market concentration)
-    if (stats.total_rewards_paid > 0) {
-        double hhi = 0;
-        for (const auto& [addr, amount] : m_miner_totals) {
-            double market_share = static_cast<double>(amount) / stats.total_rewards_paid;
-            hhi += market_share * market_share;
+    bool whole_window = last_n_blocks == 0 || last_n_blocks >= WINDOW;
+    Totals totals;
+    if (whole_window) {
+        totals = m_totals;
+    } else if (last_n_blocks <= WINDOW / 2) {
+        for (uint32_t i = 0; i < last_n_blocks && i <= static_cast<uint32_t>(m_tip); ++i) {
+            const Block& block = BlockAt(m_tip - i);
+            if (block.height == m_tip - static_cast<int32_t>(i)) {
+                totals.Add(block.totals);
+            }
+        }
+    } else {
+        // Cheaper to take the blocks beyond the last n out of the window
+        totals = m_totals;
+        for (uint32_t i = last_n_blocks; i < WINDOW && i <= static_cast<uint32_t>(m_tip); ++i) {
+            const Block& block = BlockAt(m_tip - i);
+            if (block.height == m_tip - static_cast<int32_t>(i)) {
+                totals.Subtract(block.totals);
+            }
         }
-        stats.herfindahl_index = hhi;
     }
     
-    // Calculate Nakamoto coefficient
-    if (!m_miner_totals.empty()) {
-        std::vector<std::pair<std::string, int64_t>> sorted_miners(
-            m_miner_totals.begin(), m_miner_totals.end());
-        
-        std::sort(sorted_miners.begin(), sorted_miners.end(),
-                 [](const auto& a, const auto& b) { return a.second > b.second; });
-        
-        int64_t cumulative = 0;
-        int64_t half_total = stats.total_rewards_paid / 2;
-        uint32_t nakamoto = 0;
-        
-        for (const auto& [addr, amount] : sorted_miners) {
-            cumulative += amount;
-            nakamoto++;
-            if (cumulative > half_total) {
-                break;
+    stats.total_rewards_paid = totals.paid;
+    stats.rewards_to_small_miners = totals.small_miner_paid;
+    stats.rewards_to_large_miners = totals.large_miner_paid;
+    stats.verified_devices = totals.verified_rewards;
+    
+    // The whole window's distribution is maintained as rewards come and go;
+    // a shorter window's is built from its blocks
+    const MinerDistribution* distribution = &m_distribution;
+    MinerDistribution recent;
+    if (!whole_window) {
+        for (uint32_t i = 0; i < last_n_blocks && i <= static_cast<uint32_t>(m_tip); ++i) {
+            const Block& block = BlockAt(m_tip - i);
+            if (block.height != m_tip - static_cast<int32_t>(i)) continue;
+            for (const auto& [miner, amount] : block.payouts) {
+                recent.Add(m_distribution.GetAddress(miner), amount);
             }
         }
-        stats.nakamoto_coefficient = nakamoto;
+        distribution = &recent;
     }
     
+    stats.unique_miners = distribution->MinerCount();
+    stats.gini_coefficient = distribution->Gini();
+    stats.herfindahl_index = distribution->Herfindahl();
+    stats.nakamoto_coefficient = distribution->Nakamoto();
+    
     return stats;
 }
 
+RewardStatistics::Stats RewardStatistics::GetHistoryStatistics(int32_t from_height,
+                                                               int32_t to_height) const {
+    Stats stats = {};
+    if (!m_history) {
+        return stats;
+    }
+    
+    RewardHistoryTotals totals = m_history->GetTotals(from_height, to_height);
+    stats.total_rewards_paid = totals.paid;
+    stats.rewards_to_small_miners = totals.small_miner_paid;
+    stats.rewards_to_large_miners = totals.paid - totals.small_miner_paid;
+    stats.verified_devices = totals.verified_rewards;
+    
+    MinerDistribution distribution;
+    m_history->ForEachMiner(from_height, to_height,
+                            [&distribution](const std::string& address, int64_t total, uint64_t) {
+        distribution.Add(address, total);
+    });
+    stats.unique_miners = distribution.MinerCount();
+    stats.gini_coefficient = distribution.Gini();
+    stats.herfindahl_index = distribution.Herfindahl();
+    stats.nakamoto_coefficient = distribution.Nakamoto();
+    
+    return stats;
+}
+
+void RewardStatistics::PruneOldData(int32_t current_height) {
+    if (m_started && current_height > m_tip) {
+        Advance(current_height);
+    }
+}
+
+std::vector<std::pair<std::string, int64_t>> RewardStatistics::GetTopMiners(size_t count) const {
+    std::vector<std::pair<std::string, int64_t>> top;
+    top.reserve(std::min(count, m_distribution.MinerCount()));
+    m_distribution.ForEachLargest(count, [&top](const std::string& address, int64_t total) {
+        top.emplace_back(address, total);
+    });
+    return top;
+}
+
+std::map<uint32_t, uint32_t> RewardStatistics::GetTierDistribution() const {
+    std::map<uint32_t, uint32_t> tiers;
+    if (!m_history) {
+        return tiers;
+    }
+    
+    const RewardHistoryTotals& totals = m_history->GetTotals();
+    for (uint32_t tier = 1; tier <= totals.tier_rewards.size(); ++tier) {
+        tiers[tier] = static_cast<uint32_t>(totals.tier_rewards[tier - 1]);
+    }
+    return tiers;
+}
+
 double RewardStatistics::GetSmallMinerPercentage() const {
-    if (m_records.empty()) return 0.0;
+    if (m_history) {
+        const RewardHistoryTotals& totals = m_history->GetTotals();
+        if (totals.rewards == 0) return 0.0;
+        
+        return static_cast<double>(totals.small_miner_rewards) / totals.rewards;
+    }
     
-    size_t small_miners = std::count_if(m_records.begin(), m_records.end(),
-                                       [](const auto& r) { return r.is_small_miner; });
+    if (m_totals.rewards == 0) return 0.0;
     
-    return static_cast<double>(small_miners) / m_records.size();
+    return static_cast<double>(m_totals.small_miner_rewards) / m_totals.rewards;
+}
+
+void RewardStatistics::Advance(int32_t tip) {
+    // Every height between the old and new tip takes over a block whose
+    // previous height has just left the window
+    uint32_t steps = std::min(static_cast<uint32_t>(tip - m_tip), WINDOW);
+    for (uint32_t i = steps; i > 0; --i) {
+        int32_t height = tip - static_cast<int32_t>(i - 1);
+        Block& block = BlockAt(height);
+        Expire(block);
+        block.height = height;
+    }
+    m_tip = tip;
+}
+
+void RewardStatistics::Expire(Block& block) {
+    for (const auto& [miner, amount] : block.payouts) {
+        m_distribution.Remove(miner, amount);
+    }
+    m_totals.Subtract(block.totals);
+    
+    // Keep the capacity: the block is reused for a later height
+    block.payouts.clear();
+    block.totals = Totals();
+    block.height = -1;
 }
 
 // DynamicRewardAdjuster implementation
@@ -350,4 +610,13 @@ double DynamicRewardAdjuster::GetEmergencyAdjustment(double top_miner_percentage
     return 1.0; // No emergency adjustment
 }
 
+double DynamicRewardAdjuster::GetDecentralizationAdjustment(const NetworkMetrics& metrics,
+                                                           double target_score) const {
+    return GetDecentralizationAdjustment(metrics.GetDecentralizationScore(), target_score);
+}
+
+double DynamicRewardAdjuster::GetEmergencyAdjustment(const NetworkMetrics& metrics) const {
+    return GetEmergencyAdjustment(metrics.GetTopProducerShare());
+}
+
 } // namespace Mining
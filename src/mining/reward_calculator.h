@@ -5,22 +5,28 @@
 #define SYNC_MINING_REWARD_CALCULATOR_H
 
 #include <stdint.h>
+#include <map>
 #include <string>
 #include <vector>
 #include "../consensus/params.h"
 #include "../podd/device_verifier.h"
+#include "miner_distribution.h"
+#include "reward_history.h"
 
 namespace Mining {
 
+class NetworkMetrics;
+
 /**
  * Miner information for reward calculation
  */
 struct MinerInfo {
     std::string address;              // SYNC address
     double hashrate_ths;              // Hashrate in TH/s
-    std::vector<std::string> device_ids; // Registered device IDs
+    std::vector<PoDD::InternedString> device_ids; // Registered device IDs
     bool is_squad_member;             // Part of a mining squad
     std::string squad_id;             // Squad ID if applicable
+    uint32_t squad_size = 0;          // Squad members as recorded with the block; 0 if not recorded
     bool is_podd_verified;            // Passed PoDD verification
     double efficiency_score;          // Power efficiency (0.0 to 1.0)
     uint32_t consecutive_blocks;      // Consecutive blocks mined
@@ -31,17 +37,17 @@ struct MinerInfo {
  * Block reward breakdown
  */
 struct RewardBreakdown {
-    int64_t base_reward;              // Base block reward
-    int64_t small_miner_bonus;        // Bonus for small miners
-    int64_t podd_bonus;               // PoDD verification bonus
-    int64_t efficiency_bonus;         // Efficiency bonus
-    int64_t squad_bonus;              // Squad participation bonus
-    int64_t total_reward;             // Total reward
+    int64_t base_reward = 0;          // Base block reward
+    int64_t small_miner_bonus = 0;    // Bonus for small miners
+    int64_t podd_bonus = 0;           // PoDD verification bonus
+    int64_t efficiency_bonus = 0;     // Efficiency bonus
+    int64_t squad_bonus = 0;          // Squad participation bonus
+    int64_t total_reward = 0;         // Total reward
     
     // Fee distribution
-    int64_t community_fund;           // To community fund
-    int64_t development_fund;         // To development fund
-    int64_t miner_fees;               // Transaction fees to miner
+    int64_t community_fund = 0;       // To community fund
+    int64_t development_fund = 0;     // To development fund
+    int64_t miner_fees = 0;           // Transaction fees to miner
     
     double GetMultiplier() const {
         if (base_reward == 0) return 1.0;
@@ -54,7 +60,17 @@ struct RewardBreakdown {
  */
 class RewardCalculator {
 public:
-    RewardCalculator(const Consensus::Params& params);
+    /**
+     * @param device_verifier Verifier holding the node's squads' work; without
+     *                        one squads cannot be distributed to. It does not
+     *                        affect reward amounts, which must not depend on
+     *                        node-local state.
+     * @param network_metrics Metrics of the recent blocks the
+     *                        decentralization score is read from
+     */
+    explicit RewardCalculator(const Consensus::Params& params,
+                              PoDD::DeviceVerifier* device_verifier = nullptr,
+                              const NetworkMetrics* network_metrics = nullptr);
     
     /**
      * Calculate total reward for a miner
@@ -68,9 +84,27 @@ public:
                                    int64_t tx_fees);
     
     /**
-     * Get base subsidy at given height
+     * Calculate rewards for many miners at one height, as CalculateReward
+     * would for each. The subsidy and feature activations are resolved once
+     * for the whole batch; each block of miners is then reduced to arrays of
+     * bonus rates and turned into amounts by a branch-free loop.
+     * @param height Block height
+     * @param miners Miners to calculate for
+     * @param count Number of miners
+     * @param tx_fees Transaction fees in block
+     * @param out Receives one breakdown per miner
+     */
+    void CalculateRewardBatch(int32_t height,
+                              const MinerInfo* miners,
+                              size_t count,
+                              int64_t tx_fees,
+                              RewardBreakdown* out);
+    
+    /**
+     * Get base subsidy at given height; a table lookup, safe to call
+     * concurrently
      * @param height Block height
-     * @return Base subsidy in satoshis
+     * @return Base subsidy in satoshis, 0 for a negative height
      */
     int64_t GetBaseSubsidy(int32_t height) const;
     
@@ -109,13 +143,21 @@ public:
     int64_t CalculateSquadBonus(bool is_squad_member, size_t squad_size, int64_t base_reward) const;
     
     /**
-     * Distribute reward among squad members
+     * Distribute reward among squad members in proportion to the
+     * difficulty-weighted work each submitted since the squad was last paid,
+     * and close that round. Amounts are whole satoshis summing exactly to
+     * total_reward: each member gets the floor of its share, and the
+     * leftover satoshis go one each to the largest fractional remainders
+     * (earlier members first on ties). If no work was recorded the reward is
+     * split equally the same way. O(members).
      * @param total_reward Total reward for squad
      * @param squad_id Squad identifier
-     * @return Vector of (address, amount) pairs
+     * @return Vector of (device ID, amount) pairs in join order, empty if the
+     *         squad does not exist; DeviceRegistry maps devices to owner
+     *         addresses
      */
     std::vector<std::pair<std::string, int64_t>> DistributeSquadReward(
-        int64_t total_reward, const std::string& squad_id) const;
+        int64_t total_reward, const std::string& squad_id);
     
     /**
      * Check if miner qualifies for small miner tier
@@ -146,28 +188,67 @@ public:
     int64_t GetMaxPossibleReward(int32_t height) const;
     
     /**
-     * Calculate network decentralization score
-     * @return Score from 0.0 (centralized) to 1.0 (perfectly decentralized)
+     * Calculate network decentralization score from the network metrics; O(1)
+     * @return Score from 0.0 (centralized) to 1.0 (perfectly decentralized);
+     *         1.0, which asks for no adjustment, without metrics or blocks
      */
     double CalculateDecentralizationScore() const;
     
 private:
     Consensus::Params m_params;
-    PoDD::DeviceVerifier m_device_verifier;
+    PoDD::DeviceVerifier* m_device_verifier;
+    const NetworkMetrics* m_network_metrics;
+    
+    // Miners per pass of CalculateRewardBatch
+    static constexpr size_t BATCH_CHUNK = 256;
+    
+    // Squad size the bonus assumes for a member whose MinerInfo does not
+    // record one, as every squad member was paid before sizes were recorded
+    static constexpr size_t UNRECORDED_SQUAD_SIZE = 5;
     
     // Helper functions
     int32_t GetHalvingEpoch(int32_t height) const;
-    bool IsFeatureActive(const std::string& feature, int32_t height) const;
     
-    // Caching for efficiency
-    mutable std::map<int32_t, int64_t> m_subsidy_cache;
+    // Bonus as a fraction of the base reward; the Calculate*Bonus methods
+    // and CalculateRewardBatch share these
+    double SmallMinerBonusRate(double hashrate_ths) const;
+    double PoDDBonusRate(bool is_verified, size_t device_count) const;
+    static double EfficiencyBonusRate(double efficiency_score);
+    static double SquadBonusRate(bool is_squad_member, size_t squad_size);
+    static size_t SquadSize(const MinerInfo& miner) {
+        return miner.squad_size != 0 ? miner.squad_size : UNRECORDED_SQUAD_SIZE;
+    }
+    bool IsFeatureActive(Consensus::Feature feature, int32_t height) const;
+    
+    // Subsidy of each halving epoch, fixed at construction so lookups are
+    // safe from any thread
+    const Consensus::SubsidySchedule m_subsidy_schedule;
 };
 
 /**
  * Statistics tracker for mining rewards
+ *
+ * Keeps the rewards of the last WINDOW blocks in a ring of per-block
+ * buckets indexed by height, so memory is bounded by the window rather than
+ * by the length of the chain. Running totals and the per-miner distribution
+ * cover the whole window. A reward is added to them when it is recorded and
+ * taken out again when its block leaves the window. Whole-window statistics
+ * therefore never rescan anything: the Gini and Herfindahl figures are O(1)
+ * and the Nakamoto coefficient O(log miners). The totals for a shorter
+ * window subtract the buckets that fall outside it, in
+ * O(min(n, WINDOW - n)) buckets.
+ *
+ * With a RewardHistory attached, every reward is also appended to it. The
+ * tier distribution, the small miner percentage and GetHistoryStatistics()
+ * then cover the whole chain rather than the window.
+ *
+ * Not thread-safe.
  */
 class RewardStatistics {
 public:
+    /** One week of 5-minute blocks */
+    static constexpr uint32_t WINDOW = 2016;
+    
     struct Stats {
         uint64_t total_rewards_paid;
         uint64_t total_bonuses_paid;
@@ -184,28 +265,109 @@ public:
         double nakamoto_coefficient;  // Minimum entities controlling 51%
     };
     
-    void RecordReward(const MinerInfo& miner, const RewardBreakdown& reward);
+    /**
+     * @param history On-disk history to append every reward to, already
+     *                open; may be null
+     */
+    explicit RewardStatistics(RewardHistory* history = nullptr);
+    
+    /**
+     * Record a reward paid at a height. A higher height than any seen so far
+     * moves the window up; rewards below the window are ignored, as are
+     * rewards below the history's tip by the history.
+     * @return False if the history did not take the reward; the window still
+     *         counts it
+     */
+    bool RecordReward(int32_t height, const MinerInfo& miner, const RewardBreakdown& reward);
+    
+    /**
+     * Take back every reward from a disconnected block's height up, in the
+     * window and the history. The window ends below that height until the
+     * next reward; blocks that left its bottom on the way up do not return.
+     * @return False if the history could not be rewound
+     */
+    bool DisconnectBlock(int32_t height);
+    
+    /**
+     * Statistics over the last n blocks up to the highest recorded height.
+     * 0, or anything from WINDOW up, means the whole window. The distribution
+     * metrics of a shorter window are built from its rewards, in
+     * O(rewards * log miners).
+     */
     Stats GetStatistics(uint32_t last_n_blocks = 0) const;
+    
+    /**
+     * Statistics over the rewards from from_height to to_height inclusive,
+     * read from the history; empty without one. Reads only the rows in
+     * range, in O(rewards in range + addresses + miners * log miners).
+     */
+    Stats GetHistoryStatistics(int32_t from_height, int32_t to_height) const;
+    
+    /** Move the window up to current_height, dropping the blocks that leave it */
     void PruneOldData(int32_t current_height);
     
-    // Analysis functions
+    /**
+     * Miners with the largest reward totals over the window, largest first.
+     * Read off the distribution RecordReward keeps ordered, in
+     * O(log miners + count); miners with equal totals come in no particular
+     * order.
+     * @param count Maximum number of miners to return
+     * @return Vector of (address, total) pairs
+     */
     std::vector<std::pair<std::string, int64_t>> GetTopMiners(size_t count) const;
+    
+    /**
+     * Rewards by miner tier (1-4) over the whole history; empty without a
+     * history. O(1).
+     */
     std::map<uint32_t, uint32_t> GetTierDistribution() const;
+    
+    /**
+     * Fraction of rewards that went to small miners, over the whole history
+     * if one is attached and over the window otherwise. O(1).
+     */
     double GetSmallMinerPercentage() const;
     
 private:
-    struct RewardRecord {
-        int32_t height;
-        std::string miner_address;
-        int64_t amount;
-        double hashrate;
-        bool is_small_miner;
-        bool is_podd_verified;
-        std::chrono::system_clock::time_point timestamp;
+    struct Totals {
+        uint64_t paid = 0;
+        uint64_t small_miner_paid = 0;
+        uint64_t large_miner_paid = 0;
+        uint32_t rewards = 0;
+        uint32_t small_miner_rewards = 0;
+        uint32_t verified_rewards = 0;
+        
+        void Add(const Totals& other);
+        void Subtract(const Totals& other);
     };
     
-    std::vector<RewardRecord> m_records;
-    std::map<std::string, int64_t> m_miner_totals;
+    /** Rewards of one block */
+    struct Block {
+        int32_t height = -1;
+        Totals totals;
+        // Kept so the payouts can be taken out of the distribution when the
+        // block leaves the window
+        std::vector<std::pair<MinerDistribution::MinerId, int64_t>> payouts;
+    };
+    
+    bool InWindow(int32_t height) const {
+        return height <= m_tip && static_cast<uint32_t>(m_tip - height) < WINDOW;
+    }
+    Block& BlockAt(int32_t height) { return m_blocks[static_cast<uint32_t>(height) % WINDOW]; }
+    const Block& BlockAt(int32_t height) const {
+        return m_blocks[static_cast<uint32_t>(height) % WINDOW];
+    }
+    void Advance(int32_t tip);
+    void Expire(Block& block);
+    
+    std::vector<Block> m_blocks;        // WINDOW blocks, by height % WINDOW
+    int32_t m_tip = 0;
+    bool m_started = false;
+    
+    Totals m_totals;                    // Over the whole window
+    MinerDistribution m_distribution;   // Totals by miner address, over the whole window
+    
+    RewardHistory* m_history;
 };
 
 /**
@@ -221,6 +383,14 @@ public:
      */
     double GetDecentralizationAdjustment(double current_score, double target_score) const;
     
+    /**
+     * Adjust rewards based on the decentralization of the recent blocks
+     * @param metrics Network metrics, updated as blocks connect
+     * @param target_score Target decentralization score
+     * @return Adjustment multiplier
+     */
+    double GetDecentralizationAdjustment(const NetworkMetrics& metrics, double target_score) const;
+    
     /**
      * Emergency adjustment for extreme centralization
      * @param top_miner_percentage Percentage of blocks by top miner
@@ -228,6 +398,13 @@ public:
      */
     double GetEmergencyAdjustment(double top_miner_percentage) const;
     
+    /**
+     * Emergency adjustment for the largest producer of the recent blocks
+     * @param metrics Network metrics, updated as blocks connect
+     * @return Emergency multiplier (can be < 1.0 for penalties)
+     */
+    double GetEmergencyAdjustment(const NetworkMetrics& metrics) const;
+    
     /**
      * Calculate optimal reward distribution
      * @param network_hashrate Total network hashrate
@@ -0,0 +1,660 @@
+// Copyright (c) 2024 SyntheticCoin Developers
+// Distributed under the MIT software license
+
+#include "reward_history.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <initializer_list>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SYNC_MINING_HAVE_AVX2_SCAN 1
+#endif
+
+namespace Mining {
+
+namespace {
+
+// Buffered rows that trigger a write
+constexpr size_t PENDING_ROWS = 1 << 16;
+
+// Smallest mapping of a column; larger ones double
+constexpr size_t MIN_MAP_BYTES = 1 << 20;
+
+constexpr char HISTORY_MAGIC[8] = {'S', 'Y', 'N', 'C', 'R', 'W', 'R', 'D'};
+constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+// On-disk layout. Native byte order; the header's byte-order mark rejects
+// files from a machine that differs.
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t column;                    // Column index; COLUMN_NAMES size for the address table
+    uint32_t width;                     // Bytes per row; 0 for the address table
+    uint64_t reserved;
+};
+static_assert(sizeof(FileHeader) == 32, "FileHeader layout changed; bump FORMAT_VERSION");
+
+// Indexed by RewardHistory::Column
+constexpr const char* COLUMN_NAMES[] = {"height.col", "address.col", "amount.col", "hashrate.col",
+                                        "flags.col"};
+constexpr uint32_t COLUMN_WIDTHS[] = {sizeof(int32_t), sizeof(uint32_t), sizeof(int64_t),
+                                      sizeof(double), sizeof(uint8_t)};
+constexpr uint32_t ADDRESS_TABLE = sizeof(COLUMN_NAMES) / sizeof(COLUMN_NAMES[0]);
+
+FileHeader MakeHeader(uint32_t column, uint32_t width) {
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, HISTORY_MAGIC, sizeof(header.magic));
+    header.version = RewardHistory::FORMAT_VERSION;
+    header.byte_order = BYTE_ORDER_MARK;
+    header.column = column;
+    header.width = width;
+    return header;
+}
+
+bool WriteAll(int fd, const void* data, size_t length) {
+    const char* p = static_cast<const char*>(data);
+    while (length > 0) {
+        ssize_t n = ::write(fd, p, length);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += n;
+        length -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool ReadAll(int fd, uint64_t offset, void* data, size_t length) {
+    char* p = static_cast<char*>(data);
+    while (length > 0) {
+        ssize_t n = ::pread(fd, p, length, static_cast<off_t>(offset));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (n == 0) {
+            errno = EIO;
+            return false;
+        }
+        p += n;
+        offset += static_cast<uint64_t>(n);
+        length -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+std::string ErrnoMessage(const std::string& what, const std::string& path) {
+    return what + " " + path + ": " + std::strerror(errno);
+}
+
+/**
+ * Open an append-only file and make sure it starts with the expected header.
+ * A file shorter than the header is a creation cut short and is started over.
+ * @return The descriptor, or -1 with error set
+ */
+int OpenFile(const std::string& path, const FileHeader& expected, uint64_t& size,
+             std::string& error) {
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        error = ErrnoMessage("Cannot open", path);
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        error = ErrnoMessage("Cannot read", path);
+        ::close(fd);
+        return -1;
+    }
+    size = static_cast<uint64_t>(st.st_size);
+
+    if (size < sizeof(FileHeader)) {
+        if (ftruncate(fd, 0) != 0 || !WriteAll(fd, &expected, sizeof(expected))) {
+            error = ErrnoMessage("Cannot write", path);
+            ::close(fd);
+            return -1;
+        }
+        size = sizeof(expected);
+        return fd;
+    }
+
+    FileHeader header;
+    if (!ReadAll(fd, 0, &header, sizeof(header))) {
+        error = ErrnoMessage("Cannot read", path);
+        ::close(fd);
+        return -1;
+    }
+    if (std::memcmp(&header, &expected, sizeof(header)) != 0) {
+        error = "Unsupported reward history file " + path;
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/** Sums over the amount and hashrate columns of a run of rows */
+struct RowSums {
+    uint64_t paid = 0;
+    uint64_t small_rewards = 0;
+    uint64_t small_paid = 0;
+    uint64_t above_tier[3] = {};
+};
+
+/**
+ * The scan loop, branch-free so it vectorizes. Inlined into one copy per
+ * instruction set: SSE2 has no packed 64-bit compare, so only the AVX2 copy
+ * is vectorized on x86-64.
+ */
+inline __attribute__((always_inline)) void SumRowsInline(const int64_t* amounts, const double* hashrates,
+                                                         size_t count, const double (&tiers)[3],
+                                                         RowSums& sums) {
+    const double tier1 = tiers[0];
+    const double tier2 = tiers[1];
+    const double tier3 = tiers[2];
+    uint64_t paid = 0;
+    uint64_t small_rewards = 0;
+    uint64_t small_paid = 0;
+    uint64_t above_tier1 = 0;
+    uint64_t above_tier2 = 0;
+    uint64_t above_tier3 = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const double hashrate = hashrates[i];
+        const uint64_t amount = static_cast<uint64_t>(amounts[i]);
+        const uint64_t small = hashrate < RewardHistory::SMALL_MINER_THS;
+        paid += amount;
+        small_rewards += small;
+        small_paid += amount & (0 - small);
+        above_tier1 += hashrate >= tier1;
+        above_tier2 += hashrate >= tier2;
+        above_tier3 += hashrate >= tier3;
+    }
+    sums.paid += paid;
+    sums.small_rewards += small_rewards;
+    sums.small_paid += small_paid;
+    sums.above_tier[0] += above_tier1;
+    sums.above_tier[1] += above_tier2;
+    sums.above_tier[2] += above_tier3;
+}
+
+void SumRowsGeneric(const int64_t* amounts, const double* hashrates, size_t count,
+                    const double (&tiers)[3], RowSums& sums) {
+    SumRowsInline(amounts, hashrates, count, tiers, sums);
+}
+
+#ifdef SYNC_MINING_HAVE_AVX2_SCAN
+__attribute__((target("avx2")))
+void SumRowsAvx2(const int64_t* amounts, const double* hashrates, size_t count,
+                 const double (&tiers)[3], RowSums& sums) {
+    SumRowsInline(amounts, hashrates, count, tiers, sums);
+}
+#endif
+
+void SumRows(const int64_t* amounts, const double* hashrates, size_t count,
+             const double (&tiers)[3], RowSums& sums) {
+#ifdef SYNC_MINING_HAVE_AVX2_SCAN
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    if (avx2) {
+        SumRowsAvx2(amounts, hashrates, count, tiers, sums);
+        return;
+    }
+#endif
+    SumRowsGeneric(amounts, hashrates, count, tiers, sums);
+}
+
+} // namespace
+
+// RewardHistoryTotals implementation
+void RewardHistoryTotals::Add(const RewardHistoryTotals& other) {
+    rewards += other.rewards;
+    paid += other.paid;
+    small_miner_rewards += other.small_miner_rewards;
+    small_miner_paid += other.small_miner_paid;
+    verified_rewards += other.verified_rewards;
+    squad_rewards += other.squad_rewards;
+    for (size_t i = 0; i < tier_rewards.size(); ++i) {
+        tier_rewards[i] += other.tier_rewards[i];
+    }
+}
+
+void RewardHistoryTotals::Subtract(const RewardHistoryTotals& other) {
+    rewards -= other.rewards;
+    paid -= other.paid;
+    small_miner_rewards -= other.small_miner_rewards;
+    small_miner_paid -= other.small_miner_paid;
+    verified_rewards -= other.verified_rewards;
+    squad_rewards -= other.squad_rewards;
+    for (size_t i = 0; i < tier_rewards.size(); ++i) {
+        tier_rewards[i] -= other.tier_rewards[i];
+    }
+}
+
+// RewardHistory implementation
+RewardHistory::RewardHistory(std::string directory, const Consensus::Params& params)
+    : m_directory(std::move(directory)),
+      m_tier1_ths(params.minerBoost.tier1_hashrate),
+      m_tier2_ths(params.minerBoost.tier2_hashrate),
+      m_tier3_ths(params.minerBoost.tier3_hashrate) {
+}
+
+RewardHistory::~RewardHistory() {
+    Close();
+}
+
+std::string RewardHistory::PathOf(const char* name) const {
+    return m_directory + "/" + name;
+}
+
+bool RewardHistory::Open(std::string& error) {
+    if (m_open) {
+        return true;
+    }
+    if (::mkdir(m_directory.c_str(), 0700) != 0 && errno != EEXIST) {
+        error = ErrnoMessage("Cannot create", m_directory);
+        return false;
+    }
+
+    bool ok = OpenAddresses(error);
+    for (size_t column = 0; ok && column < COLUMN_COUNT; ++column) {
+        ok = OpenColumn(static_cast<Column>(column), error);
+    }
+    if (!ok) {
+        Close();
+        return false;
+    }
+
+    // Only rows that every column holds in full are complete
+    m_rows = UINT64_MAX;
+    for (size_t column = 0; column < COLUMN_COUNT; ++column) {
+        m_rows = std::min(m_rows, (m_columns[column].size - sizeof(FileHeader)) / COLUMN_WIDTHS[column]);
+    }
+
+    // A row naming an address whose entry never reached the disk, or out of
+    // height order, ends the history
+    const Columns rows = Mapped();
+    for (size_t i = 0; i < rows.count; ++i) {
+        if (rows.address[i] >= m_addresses.size() || (i > 0 && rows.height[i] < rows.height[i - 1])) {
+            m_rows = i;
+            break;
+        }
+    }
+
+    // Cut every column back to the complete rows so new rows line up
+    for (size_t column = 0; column < COLUMN_COUNT; ++column) {
+        ColumnFile& file = m_columns[column];
+        uint64_t size = sizeof(FileHeader) + m_rows * COLUMN_WIDTHS[column];
+        if (file.size != size) {
+            if (ftruncate(file.fd, static_cast<off_t>(size)) != 0) {
+                error = ErrnoMessage("Cannot truncate", PathOf(COLUMN_NAMES[column]));
+                Close();
+                return false;
+            }
+            file.size = size;
+        }
+    }
+
+    Accumulate(Mapped(), m_totals);
+    m_tip = m_rows > 0 ? Mapped().height[m_rows - 1] : -1;
+    m_open = true;
+    return true;
+}
+
+bool RewardHistory::OpenColumn(Column column, std::string& error) {
+    ColumnFile& file = m_columns[column];
+    const std::string path = PathOf(COLUMN_NAMES[column]);
+    file.fd = OpenFile(path, MakeHeader(column, COLUMN_WIDTHS[column]), file.size, error);
+    if (file.fd < 0) {
+        return false;
+    }
+    if (!MapColumn(file)) {
+        error = ErrnoMessage("Cannot map", path);
+        return false;
+    }
+    return true;
+}
+
+bool RewardHistory::OpenAddresses(std::string& error) {
+    const std::string path = PathOf("addresses.dat");
+    uint64_t size = 0;
+    m_addresses_fd = OpenFile(path, MakeHeader(ADDRESS_TABLE, 0), size, error);
+    if (m_addresses_fd < 0) {
+        return false;
+    }
+
+    // Entries are [length][bytes]; a torn entry at the end is dropped
+    std::string data(size - sizeof(FileHeader), '\0');
+    if (!ReadAll(m_addresses_fd, sizeof(FileHeader), &data[0], data.size())) {
+        error = ErrnoMessage("Cannot read", path);
+        return false;
+    }
+    size_t pos = 0;
+    while (data.size() - pos >= sizeof(uint32_t)) {
+        uint32_t length;
+        std::memcpy(&length, data.data() + pos, sizeof(length));
+        if (data.size() - pos - sizeof(length) < length) {
+            break;
+        }
+        std::string address = data.substr(pos + sizeof(length), length);
+        m_address_ids.emplace(address, static_cast<uint32_t>(m_addresses.size()));
+        m_addresses.push_back(std::move(address));
+        pos += sizeof(length) + length;
+    }
+    if (pos != data.size() &&
+        ftruncate(m_addresses_fd, static_cast<off_t>(sizeof(FileHeader) + pos)) != 0) {
+        error = ErrnoMessage("Cannot truncate", path);
+        return false;
+    }
+    return true;
+}
+
+void RewardHistory::Close() {
+    if (m_open) {
+        Flush(true);
+    }
+    for (ColumnFile& file : m_columns) {
+        if (file.map) munmap(const_cast<char*>(file.map), file.mapped);
+        if (file.fd >= 0) ::close(file.fd);
+        file = ColumnFile();
+    }
+    if (m_addresses_fd >= 0) {
+        ::close(m_addresses_fd);
+        m_addresses_fd = -1;
+    }
+
+    m_rows = 0;
+    m_pending.Clear();
+    m_tip = -1;
+    m_open = false;
+    m_failed = false;
+    m_addresses.clear();
+    m_address_ids.clear();
+    m_pending_addresses.clear();
+    m_totals = RewardHistoryTotals();
+}
+
+bool RewardHistory::Append(int32_t height, const std::string& address, int64_t amount,
+                           double hashrate_ths, uint8_t flags) {
+    if (!m_open || m_failed || height < m_tip) {
+        return false;
+    }
+
+    m_pending.height.push_back(height);
+    m_pending.address.push_back(AddressId(address));
+    m_pending.amount.push_back(amount);
+    m_pending.hashrate.push_back(hashrate_ths);
+    m_pending.flags.push_back(flags);
+    m_tip = height;
+
+    size_t count = m_pending.Size();
+    Accumulate(m_pending.View().Slice(count - 1, count), m_totals);
+    if (count >= PENDING_ROWS) {
+        Flush();
+    }
+    return true;
+}
+
+bool RewardHistory::Rewind(int32_t height) {
+    if (!m_open || m_failed) {
+        return false;
+    }
+    if (height >= m_tip) {
+        return true;
+    }
+
+    // Heights are sorted across the written rows and then the buffered ones
+    const Columns mapped = Mapped();
+    const Columns pending = m_pending.View();
+    const size_t keep_mapped = std::upper_bound(mapped.height, mapped.height + mapped.count, height) -
+                               mapped.height;
+    const size_t keep_pending = std::upper_bound(pending.height, pending.height + pending.count, height) -
+                                pending.height;
+
+    RewardHistoryTotals dropped;
+    Accumulate(mapped.Slice(keep_mapped, mapped.count), dropped);
+    Accumulate(pending.Slice(keep_pending, pending.count), dropped);
+
+    if (keep_mapped < m_rows) {
+        // Columns are cut one after another; if that stops part way, Open()
+        // evens them out to the shortest
+        for (size_t column = 0; column < COLUMN_COUNT; ++column) {
+            ColumnFile& file = m_columns[column];
+            uint64_t size = sizeof(FileHeader) + keep_mapped * COLUMN_WIDTHS[column];
+            if (ftruncate(file.fd, static_cast<off_t>(size)) != 0) {
+                m_failed = true;
+                return false;
+            }
+            file.size = size;
+        }
+        m_rows = keep_mapped;
+    }
+    m_pending.Resize(keep_pending);
+
+    m_totals.Subtract(dropped);
+    if (m_pending.Size() > 0) {
+        m_tip = m_pending.height.back();
+    } else {
+        m_tip = m_rows > 0 ? Mapped().height[m_rows - 1] : -1;
+    }
+    return true;
+}
+
+uint32_t RewardHistory::AddressId(const std::string& address) {
+    auto [it, inserted] = m_address_ids.try_emplace(address, static_cast<uint32_t>(m_addresses.size()));
+    if (inserted) {
+        m_addresses.push_back(address);
+        uint32_t length = static_cast<uint32_t>(address.size());
+        m_pending_addresses.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        m_pending_addresses.append(address);
+    }
+    return it->second;
+}
+
+bool RewardHistory::Flush(bool sync) {
+    if (!m_open || m_failed) {
+        return !m_failed;
+    }
+
+    // Addresses go out before the rows naming them, so a crash never leaves
+    // a row without its address
+    if (!m_pending_addresses.empty()) {
+        if (!WriteAll(m_addresses_fd, m_pending_addresses.data(), m_pending_addresses.size())) {
+            m_failed = true;
+            return false;
+        }
+        m_pending_addresses.clear();
+    }
+
+    size_t count = m_pending.Size();
+    if (count > 0) {
+        if (sync && fdatasync(m_addresses_fd) != 0) {
+            m_failed = true;
+            return false;
+        }
+        bool ok = WriteColumn(HEIGHT, m_pending.height.data(), count * sizeof(int32_t)) &&
+                  WriteColumn(ADDRESS, m_pending.address.data(), count * sizeof(uint32_t)) &&
+                  WriteColumn(AMOUNT, m_pending.amount.data(), count * sizeof(int64_t)) &&
+                  WriteColumn(HASHRATE, m_pending.hashrate.data(), count * sizeof(double)) &&
+                  WriteColumn(FLAGS, m_pending.flags.data(), count * sizeof(uint8_t));
+        for (ColumnFile& file : m_columns) {
+            ok = ok && MapColumn(file);
+        }
+        if (!ok) {
+            // The rows stay buffered; on disk, Open() will drop whatever
+            // part of them was written
+            m_failed = true;
+            return false;
+        }
+        m_rows += count;
+        m_pending.Clear();
+    }
+
+    if (sync) {
+        bool ok = fdatasync(m_addresses_fd) == 0;
+        for (const ColumnFile& file : m_columns) {
+            ok = ok && fdatasync(file.fd) == 0;
+        }
+        if (!ok) {
+            m_failed = true;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool RewardHistory::WriteColumn(Column column, const void* data, size_t length) {
+    ColumnFile& file = m_columns[column];
+    if (!WriteAll(file.fd, data, length)) {
+        return false;
+    }
+    file.size += length;
+    return true;
+}
+
+bool RewardHistory::MapColumn(ColumnFile& file) {
+    if (file.mapped >= file.size) {
+        return true;
+    }
+
+    // Pages past the end of the file are never read, and fill in as the
+    // file grows, so one mapping serves many appends
+    size_t length = std::max(file.mapped * 2, MIN_MAP_BYTES);
+    while (length < file.size) {
+        length *= 2;
+    }
+    void* map = mmap(nullptr, length, PROT_READ, MAP_SHARED, file.fd, 0);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    if (file.map) {
+        munmap(const_cast<char*>(file.map), file.mapped);
+    }
+    file.map = static_cast<const char*>(map);
+    file.mapped = length;
+    return true;
+}
+
+RewardHistory::Columns RewardHistory::Mapped() const {
+    Columns rows;
+    if (m_rows == 0) {
+        return rows;
+    }
+    rows.height = reinterpret_cast<const int32_t*>(m_columns[HEIGHT].map + sizeof(FileHeader));
+    rows.address = reinterpret_cast<const uint32_t*>(m_columns[ADDRESS].map + sizeof(FileHeader));
+    rows.amount = reinterpret_cast<const int64_t*>(m_columns[AMOUNT].map + sizeof(FileHeader));
+    rows.hashrate = reinterpret_cast<const double*>(m_columns[HASHRATE].map + sizeof(FileHeader));
+    rows.flags = reinterpret_cast<const uint8_t*>(m_columns[FLAGS].map + sizeof(FileHeader));
+    rows.count = m_rows;
+    return rows;
+}
+
+RewardHistory::Columns RewardHistory::Pending::View() const {
+    Columns rows;
+    rows.height = height.data();
+    rows.address = address.data();
+    rows.amount = amount.data();
+    rows.hashrate = hashrate.data();
+    rows.flags = flags.data();
+    rows.count = Size();
+    return rows;
+}
+
+void RewardHistory::Pending::Clear() {
+    height.clear();
+    address.clear();
+    amount.clear();
+    hashrate.clear();
+    flags.clear();
+}
+
+void RewardHistory::Pending::Resize(size_t count) {
+    height.resize(count);
+    address.resize(count);
+    amount.resize(count);
+    hashrate.resize(count);
+    flags.resize(count);
+}
+
+RewardHistory::Columns RewardHistory::Columns::Slice(size_t begin, size_t end) const {
+    Columns rows;
+    if (begin >= end) {
+        return rows;
+    }
+    rows.height = height + begin;
+    rows.address = address + begin;
+    rows.amount = amount + begin;
+    rows.hashrate = hashrate + begin;
+    rows.flags = flags + begin;
+    rows.count = end - begin;
+    return rows;
+}
+
+RewardHistory::Columns RewardHistory::Columns::Range(int32_t from_height, int32_t to_height) const {
+    if (count == 0 || from_height > to_height) {
+        return Columns();
+    }
+    const int32_t* begin = std::lower_bound(height, height + count, from_height);
+    const int32_t* end = std::upper_bound(begin, height + count, to_height);
+    return Slice(begin - height, end - height);
+}
+
+RewardHistoryTotals RewardHistory::GetTotals(int32_t from_height, int32_t to_height) const {
+    RewardHistoryTotals totals;
+    Accumulate(Mapped().Range(from_height, to_height), totals);
+    Accumulate(m_pending.View().Range(from_height, to_height), totals);
+    return totals;
+}
+
+void RewardHistory::Accumulate(const Columns& rows, RewardHistoryTotals& totals) const {
+    const double tiers[3] = {m_tier1_ths, m_tier2_ths, m_tier3_ths};
+    RowSums sums;
+    SumRows(rows.amount, rows.hashrate, rows.count, tiers, sums);
+
+    // Flags get a pass of their own: mixed with the 8-byte columns the loop
+    // would not vectorize
+    uint64_t verified = 0;
+    uint64_t squad = 0;
+    for (size_t i = 0; i < rows.count; ++i) {
+        verified += rows.flags[i] & FLAG_PODD_VERIFIED;
+        squad += (rows.flags[i] & FLAG_SQUAD_MEMBER) >> 1;
+    }
+
+    totals.rewards += rows.count;
+    totals.paid += sums.paid;
+    totals.small_miner_rewards += sums.small_rewards;
+    totals.small_miner_paid += sums.small_paid;
+    totals.verified_rewards += verified;
+    totals.squad_rewards += squad;
+    totals.tier_rewards[0] += rows.count - sums.above_tier[0];
+    totals.tier_rewards[1] += sums.above_tier[0] - sums.above_tier[1];
+    totals.tier_rewards[2] += sums.above_tier[1] - sums.above_tier[2];
+    totals.tier_rewards[3] += sums.above_tier[2];
+}
+
+void RewardHistory::ForEachMiner(int32_t from_height, int32_t to_height,
+                                 const std::function<void(const std::string&, int64_t, uint64_t)>& fn) const {
+    std::vector<int64_t> totals(m_addresses.size());
+    std::vector<uint64_t> rewards(m_addresses.size());
+    for (const Columns& rows : {Mapped().Range(from_height, to_height),
+                                m_pending.View().Range(from_height, to_height)}) {
+        for (size_t i = 0; i < rows.count; ++i) {
+            totals[rows.address[i]] += rows.amount[i];
+            ++rewards[rows.address[i]];
+        }
+    }
+    for (size_t id = 0; id < m_addresses.size(); ++id) {
+        if (rewards[id] > 0) {
+            fn(m_addresses[id], totals[id], rewards[id]);
+        }
+    }
+}
+
+} // namespace Mining
@@ -0,0 +1,222 @@
+// Copyright (c) 2024 SyntheticCoin Developers
+// Distributed under the MIT software license
+
+#ifndef SYNC_MINING_REWARD_HISTORY_H
+#define SYNC_MINING_REWARD_HISTORY_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../consensus/params.h"
+
+namespace Mining {
+
+/**
+ * Totals over a run of recorded rewards
+ */
+struct RewardHistoryTotals {
+    uint64_t rewards = 0;
+    uint64_t paid = 0;
+    uint64_t small_miner_rewards = 0;
+    uint64_t small_miner_paid = 0;
+    uint64_t verified_rewards = 0;
+    uint64_t squad_rewards = 0;
+    std::array<uint64_t, 4> tier_rewards{};     // Rewards by miner tier, tier 1 first
+
+    void Add(const RewardHistoryTotals& other);
+    void Subtract(const RewardHistoryTotals& other);
+};
+
+/**
+ * Every reward the node has recorded, kept on disk column by column.
+ *
+ * The directory holds one append-only file per field: height.col,
+ * address.col, amount.col, hashrate.col and flags.col. Each is a fixed
+ * header followed by one fixed-width value per reward, so row i of every
+ * column describes the same reward. Addresses are stored as dense IDs into
+ * addresses.dat, a length-prefixed list of the distinct addresses in order of
+ * first appearance.
+ *
+ * Columns are mapped read-only, with the mapping grown in doubling steps as
+ * the files grow. Appended rows are buffered in memory, column by column, and
+ * written out when the buffer fills or on Flush(). Range queries find their
+ * rows by binary search on the height column and then read only the columns
+ * they need, front to back, in branch-free loops; nothing is loaded into
+ * memory beyond the address table.
+ *
+ * A crash can leave the columns with different lengths, or rows naming an
+ * address whose entry was never written. Open() cuts every column back to the
+ * rows that are complete, so the history is always a prefix of what was
+ * appended. Heights never decrease. Rows are never rewritten, only cut off:
+ * Rewind() drops the rewards of disconnected blocks, and a crash part way
+ * through leaves a prefix that Open() evens out.
+ *
+ * Not thread-safe; RewardStatistics serializes access.
+ */
+class RewardHistory {
+public:
+    static constexpr uint32_t FORMAT_VERSION = 1;
+
+    /** Hashrate below which a miner counts as small, in TH/s */
+    static constexpr double SMALL_MINER_THS = 10.0;
+
+    enum Flag : uint8_t {
+        FLAG_PODD_VERIFIED = 1 << 0,
+        FLAG_SQUAD_MEMBER = 1 << 1,
+    };
+
+    /**
+     * @param directory Directory holding the column files
+     * @param params Consensus parameters; the miner tier thresholds are taken
+     *               from them
+     */
+    RewardHistory(std::string directory, const Consensus::Params& params);
+    ~RewardHistory();
+
+    RewardHistory(const RewardHistory&) = delete;
+    RewardHistory& operator=(const RewardHistory&) = delete;
+
+    /**
+     * Open the history, creating it if the directory holds none. Drops any
+     * incomplete rows left by a crash and sums the rest in one pass over the
+     * columns.
+     */
+    bool Open(std::string& error);
+
+    /** Write out and sync buffered rows, then unmap and close the columns */
+    void Close();
+
+    /**
+     * Record a reward
+     * @param height Block height; must not be below GetTipHeight()
+     * @param flags Flag bits
+     * @return False if the height is below the tip or the history is not open
+     */
+    bool Append(int32_t height, const std::string& address, int64_t amount,
+                double hashrate_ths, uint8_t flags);
+
+    /**
+     * Drop every reward above a height, for blocks disconnected from the
+     * chain. Written rows are truncated from the columns; addresses stay in
+     * the table. O(log rewards + rewards dropped).
+     * @return False if the history is not open or a write or truncation has
+     *         failed
+     */
+    bool Rewind(int32_t height);
+
+    /**
+     * Write out buffered rows
+     * @param sync Also fsync the files
+     * @return False if a write has failed since the history was opened
+     */
+    bool Flush(bool sync = false);
+
+    /** Rewards recorded, buffered ones included */
+    uint64_t Size() const { return m_rows + m_pending.Size(); }
+
+    /** Height of the last reward; -1 if there is none */
+    int32_t GetTipHeight() const { return m_tip; }
+
+    /** Distinct addresses recorded */
+    size_t GetAddressCount() const { return m_addresses.size(); }
+
+    /** Totals over every reward, kept up to date by Append() */
+    const RewardHistoryTotals& GetTotals() const { return m_totals; }
+
+    /** Totals over the rewards from from_height to to_height inclusive */
+    RewardHistoryTotals GetTotals(int32_t from_height, int32_t to_height) const;
+
+    /**
+     * Visit each miner rewarded from from_height to to_height inclusive, in
+     * order of first appearance in the history, with the sum and number of
+     * its rewards in that range. O(rewards in range + addresses).
+     */
+    void ForEachMiner(int32_t from_height, int32_t to_height,
+                      const std::function<void(const std::string&, int64_t, uint64_t)>& fn) const;
+
+private:
+    enum Column { HEIGHT, ADDRESS, AMOUNT, HASHRATE, FLAGS, COLUMN_COUNT };
+
+    /** Rows as one array per field */
+    struct Columns {
+        const int32_t* height = nullptr;
+        const uint32_t* address = nullptr;
+        const int64_t* amount = nullptr;
+        const double* hashrate = nullptr;
+        const uint8_t* flags = nullptr;
+        size_t count = 0;
+
+        Columns Slice(size_t begin, size_t end) const;
+
+        /** Rows from the first at or above from_height to the last at or below to_height */
+        Columns Range(int32_t from_height, int32_t to_height) const;
+    };
+
+    /** Rows appended but not yet written out */
+    struct Pending {
+        std::vector<int32_t> height;
+        std::vector<uint32_t> address;
+        std::vector<int64_t> amount;
+        std::vector<double> hashrate;
+        std::vector<uint8_t> flags;
+
+        size_t Size() const { return height.size(); }
+        Columns View() const;
+        void Clear();
+        // Keep only the first count rows
+        void Resize(size_t count);
+    };
+
+    /** An append-only column file and its read-only mapping */
+    struct ColumnFile {
+        int fd = -1;
+        const char* map = nullptr;
+        size_t mapped = 0;              // Bytes mapped; may run past the end of the file
+        uint64_t size = 0;              // Bytes in the file
+    };
+
+    std::string PathOf(const char* name) const;
+
+    bool OpenColumn(Column column, std::string& error);
+    bool OpenAddresses(std::string& error);
+
+    // Map at least the file's current size
+    bool MapColumn(ColumnFile& file);
+    bool WriteColumn(Column column, const void* data, size_t length);
+
+    /** Rows already written out, read through the mappings */
+    Columns Mapped() const;
+
+    // Sum one run of rows; the loop has no branches so it vectorizes
+    void Accumulate(const Columns& rows, RewardHistoryTotals& totals) const;
+
+    uint32_t AddressId(const std::string& address);
+
+    const std::string m_directory;
+    const double m_tier1_ths;
+    const double m_tier2_ths;
+    const double m_tier3_ths;
+
+    std::array<ColumnFile, COLUMN_COUNT> m_columns;
+    uint64_t m_rows = 0;                // Rows written out
+    Pending m_pending;
+    int32_t m_tip = -1;
+    bool m_open = false;
+    bool m_failed = false;
+
+    int m_addresses_fd = -1;
+    std::vector<std::string> m_addresses;                   // By ID
+    std::unordered_map<std::string, uint32_t> m_address_ids;
+    std::string m_pending_addresses;    // Encoded entries not yet written out
+
+    RewardHistoryTotals m_totals;
+};
+
+} // namespace Mining
+
+#endif // SYNC_MINING_REWARD_HISTORY_H
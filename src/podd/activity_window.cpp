@@ -0,0 +1,109 @@
+// Copyright (c) 2024 SyntheticCoin Developers
+// Distributed under the MIT software license
+
+#include "activity_window.h"
+#include <algorithm>
+
+namespace PoDD {
+
+void ActivityWindow::Record(InternedString device_id, uint32_t height, double hashrate) {
+    if (!m_started) {
+        m_started = true;
+        m_tip = height;
+        BucketAt(height).height = height;
+    } else if (height > m_tip) {
+        Advance(height);
+    }
+    if (!InWindow(height)) {
+        return;
+    }
+
+    auto [it, inserted] = m_devices.try_emplace(device_id, DeviceActivity{height, hashrate});
+    if (!inserted) {
+        DeviceActivity& activity = it->second;
+        if (height < activity.height) {
+            return; // Only the latest activity counts
+        }
+        if (InWindow(activity.height)) {
+            Remove(activity.height, activity.hashrate);
+        }
+        activity = DeviceActivity{height, hashrate};
+    }
+    Add(height, hashrate);
+}
+
+uint32_t ActivityWindow::ActiveDevices(uint32_t last_n_blocks) const {
+    if (!m_started || last_n_blocks == 0) return 0;
+    if (last_n_blocks >= WINDOW) return m_total_devices;
+
+    uint32_t count = 0;
+    uint32_t blocks = std::min(last_n_blocks, m_tip + 1);
+    for (uint32_t i = 0; i < blocks; ++i) {
+        uint32_t height = m_tip - i;
+        const Bucket& bucket = m_buckets[height % WINDOW];
+        if (bucket.height == height) {
+            count += bucket.devices;
+        }
+    }
+    return count;
+}
+
+double ActivityWindow::HashrateDistribution() const {
+    if (m_total_hashrate <= 0.0) return 0.0;
+    double concentration = m_total_hashrate_squared / (m_total_hashrate * m_total_hashrate);
+    return std::clamp(1.0 - concentration, 0.0, 1.0);
+}
+
+void ActivityWindow::Advance(uint32_t tip) {
+    // Every height between the old and new tip takes over a bucket whose
+    // previous height has just left the window
+    uint32_t steps = std::min(tip - m_tip, WINDOW);
+    for (uint32_t i = steps; i > 0; --i) {
+        uint32_t height = tip - (i - 1);
+        Bucket& bucket = BucketAt(height);
+        bucket = Bucket();
+        bucket.height = height;
+    }
+    m_tip = tip;
+
+    m_total_devices = 0;
+    m_total_hashrate = 0.0;
+    m_total_hashrate_squared = 0.0;
+    for (const Bucket& bucket : m_buckets) {
+        m_total_devices += bucket.devices;
+        m_total_hashrate += bucket.hashrate;
+        m_total_hashrate_squared += bucket.hashrate_squared;
+    }
+}
+
+void ActivityWindow::Add(uint32_t height, double hashrate) {
+    Bucket& bucket = BucketAt(height);
+    if (bucket.height != height) {
+        // Never used since the window started; nothing to carry over
+        bucket = Bucket();
+        bucket.height = height;
+    }
+    ++bucket.devices;
+    bucket.hashrate += hashrate;
+    bucket.hashrate_squared += hashrate * hashrate;
+
+    ++m_total_devices;
+    m_total_hashrate += hashrate;
+    m_total_hashrate_squared += hashrate * hashrate;
+}
+
+void ActivityWindow::Remove(uint32_t height, double hashrate) {
+    Bucket& bucket = BucketAt(height);
+    if (bucket.height != height || bucket.devices == 0) {
+        return;
+    }
+    --bucket.devices;
+    bucket.hashrate -= hashrate;
+    bucket.hashrate_squared -= hashrate * hashrate;
+
+    --m_total_devices;
+    m_total_hashrate -= hashrate;
+    m_total_hashrate_squared -= hashrate * hashrate;
+}
+
+} // namespace PoDD
@@ -0,0 +1,87 @@
+// Copyright (c) 2024 SyntheticCoin Developers
+// Distributed under the MIT software license
+
+#ifndef SYNC_PODD_ACTIVITY_WINDOW_H
+#define SYNC_PODD_ACTIVITY_WINDOW_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+#include "string_interner.h"
+
+namespace PoDD {
+
+/**
+ * Devices seen over the last WINDOW blocks, with their hashrates.
+ *
+ * Each device sits in the bucket of the last height it was active at. The
+ * buckets form a ring indexed by height, each holding its device count and
+ * the sum and sum of squares of those devices' hashrates. Running totals
+ * over the whole ring make the hashrate distribution O(1). Counting the
+ * devices active in the last n blocks is O(n). Moving a device between
+ * buckets is O(1). When the tip advances, the buckets that fall out of the
+ * window are cleared and the totals are recomputed from the ring, so
+ * floating point drift never outlives one block.
+ *
+ * Not thread-safe; DeviceRegistry serializes access.
+ */
+class ActivityWindow {
+public:
+    /** One week of 5-minute blocks */
+    static constexpr uint32_t WINDOW = 2016;
+
+    /**
+     * Record that a device was active at a height. Heights that are older
+     * than the window or older than the device's last activity are ignored.
+     * Reporting a device again at the same height replaces its hashrate.
+     */
+    void Record(InternedString device_id, uint32_t height, double hashrate);
+
+    /** Devices active in the last n blocks up to the tip (n is capped at WINDOW) */
+    uint32_t ActiveDevices(uint32_t last_n_blocks) const;
+
+    /**
+     * Spread of hashrate across the devices active in the window:
+     * 1 - sum(h^2) / (sum h)^2. This is 0 when a single device has all the
+     * hashrate and approaches 1 as it is spread evenly over more devices.
+     * Returns 0 with no hashrate in the window.
+     */
+    double HashrateDistribution() const;
+
+    uint32_t Tip() const { return m_tip; }
+    size_t TrackedDevices() const { return m_devices.size(); }
+
+private:
+    struct Bucket {
+        uint32_t height = 0;
+        uint32_t devices = 0;
+        double hashrate = 0.0;
+        double hashrate_squared = 0.0;
+    };
+
+    struct DeviceActivity {
+        uint32_t height;
+        double hashrate;
+    };
+
+    bool InWindow(uint32_t height) const { return height <= m_tip && m_tip - height < WINDOW; }
+    Bucket& BucketAt(uint32_t height) { return m_buckets[height % WINDOW]; }
+    void Advance(uint32_t tip);
+    void Add(uint32_t height, double hashrate);
+    void Remove(uint32_t height, double hashrate);
+
+    std::array<Bucket, WINDOW> m_buckets{};
+    std::unordered_map<InternedString, DeviceActivity> m_devices;
+    uint32_t m_tip = 0;
+    bool m_started = false;
+
+    uint32_t m_total_devices = 0;
+    double m_total_hashrate = 0.0;
+    double m_total_hashrate_squared = 0.0;
+};
+
+} // namespace PoDD
+
+#endif // SYNC_PODD_ACTIVITY_WINDOW_H
@@ -0,0 +1,265 @@
+// Copyright (c) 2024 SyntheticCoin Developers
+// Distributed under the MIT software license
+
+#ifndef SYNC_PODD_DEVICE_STORE_H
+#define SYNC_PODD_DEVICE_STORE_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "string_interner.h"
+
+namespace PoDD {
+
+/**
+ * Hash-sharded, lock-striped store keyed by interned device ID.
+ *
+ * Records are spread over a fixed number of shards by hashing the device ID,
+ * and every shard has its own reader/writer lock. Share updates for devices
+ * living in different shards never contend, and readers of one shard never
+ * block readers of another. Operations touching several devices lock all the
+ * shards involved in ascending index order, which gives a consistent view of
+ * the whole set without risking lock-order inversion between threads.
+ */
+template <typename Record>
+class ShardedDeviceStore {
+public:
+    static constexpr size_t SHARD_COUNT = 64;
+
+    /**
+     * Insert a new record
+     * @return False if the device is already present
+     */
+    bool Insert(InternedString device_id, Record record) {
+        Shard& shard = m_shards[ShardOf(device_id)];
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        bool inserted = shard.records.emplace(device_id, std::move(record)).second;
+        if (inserted) {
+            m_size.fetch_add(1, std::memory_order_relaxed);
+        }
+        return inserted;
+    }
+
+    /**
+     * Insert a default-constructed record and run init(Record&) on it while
+     * the shard is still locked, so no other thread sees it half built
+     * @return False (and init is not run) if the device is already present
+     */
+    template <typename Fn>
+    bool Emplace(InternedString device_id, Fn&& init) {
+        Shard& shard = m_shards[ShardOf(device_id)];
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        auto [it, inserted] = shard.records.try_emplace(device_id);
+        if (inserted) {
+            init(it->second);
+            m_size.fetch_add(1, std::memory_order_relaxed);
+        }
+        return inserted;
+    }
+
+    /**
+     * Emplace a batch: init(i, Record&) runs on the new record of each
+     * device_ids[i] that is not present yet. Shards are filled in turn, each
+     * locked once, so every table is warm in cache while it grows; within a
+     * shard, earlier IDs go first.
+     * @return Records inserted
+     */
+    template <typename Fn>
+    size_t EmplaceMany(const InternedString* device_ids, size_t count, Fn&& init) {
+        std::array<size_t, SHARD_COUNT + 1> starts{};
+        for (size_t i = 0; i < count; ++i) {
+            ++starts[ShardOf(device_ids[i]) + 1];
+        }
+        for (size_t shard = 0; shard < SHARD_COUNT; ++shard) {
+            starts[shard + 1] += starts[shard];
+        }
+        std::vector<size_t> order(count);
+        std::array<size_t, SHARD_COUNT> next;
+        std::copy(starts.begin(), starts.end() - 1, next.begin());
+        for (size_t i = 0; i < count; ++i) {
+            order[next[ShardOf(device_ids[i])]++] = i;
+        }
+
+        size_t inserted = 0;
+        for (size_t index = 0; index < SHARD_COUNT; ++index) {
+            if (starts[index] == starts[index + 1]) continue;
+
+            Shard& shard = m_shards[index];
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+            for (size_t k = starts[index]; k < starts[index + 1]; ++k) {
+                size_t i = order[k];
+                auto [it, added] = shard.records.try_emplace(device_ids[i]);
+                if (added) {
+                    init(i, it->second);
+                    ++inserted;
+                }
+            }
+        }
+        m_size.fetch_add(inserted, std::memory_order_relaxed);
+        return inserted;
+    }
+
+    /** Size every shard's table for about count records in total */
+    void Reserve(size_t count) {
+        size_t per_shard = count / SHARD_COUNT + count / (SHARD_COUNT * 8) + 1;
+        for (Shard& shard : m_shards) {
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+            shard.records.reserve(per_shard);
+        }
+    }
+
+    bool Contains(InternedString device_id) const {
+        const Shard& shard = m_shards[ShardOf(device_id)];
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        return shard.records.count(device_id) != 0;
+    }
+
+    /**
+     * Run fn(Record&) under the shard's exclusive lock
+     * @return False if the device is not present
+     */
+    template <typename Fn>
+    bool Modify(InternedString device_id, Fn&& fn) {
+        Shard& shard = m_shards[ShardOf(device_id)];
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.records.find(device_id);
+        if (it == shard.records.end()) {
+            return false;
+        }
+        fn(it->second);
+        return true;
+    }
+
+    /**
+     * Run fn(const Record&) under the shard's shared lock
+     * @return False if the device is not present
+     */
+    template <typename Fn>
+    bool Read(InternedString device_id, Fn&& fn) const {
+        const Shard& shard = m_shards[ShardOf(device_id)];
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.records.find(device_id);
+        if (it == shard.records.end()) {
+            return false;
+        }
+        fn(static_cast<const Record&>(it->second));
+        return true;
+    }
+
+    /**
+     * Shared lock over every shard holding one of a set of devices, taken in
+     * ascending shard order. Records returned by FindLocked for those devices
+     * stay valid and unchanged for as long as the lock is held.
+     */
+    class SetReadLock {
+    public:
+        SetReadLock(const ShardedDeviceStore* store, std::bitset<SHARD_COUNT> shards)
+            : m_store(store), m_shards(shards) {
+            for (size_t i = 0; i < SHARD_COUNT; ++i) {
+                if (m_shards.test(i)) m_store->m_shards[i].mutex.lock_shared();
+            }
+        }
+        SetReadLock(SetReadLock&& other) noexcept
+            : m_store(other.m_store), m_shards(other.m_shards) {
+            other.m_shards.reset();
+        }
+        SetReadLock(const SetReadLock&) = delete;
+        SetReadLock& operator=(const SetReadLock&) = delete;
+        SetReadLock& operator=(SetReadLock&&) = delete;
+        ~SetReadLock() {
+            for (size_t i = SHARD_COUNT; i-- > 0;) {
+                if (m_shards.test(i)) m_store->m_shards[i].mutex.unlock_shared();
+            }
+        }
+
+    private:
+        const ShardedDeviceStore* m_store;
+        std::bitset<SHARD_COUNT> m_shards;
+    };
+
+    /**
+     * Share-lock the shards of a set of devices
+     * @param device_ids Container of InternedString
+     */
+    template <typename Ids>
+    SetReadLock LockShared(const Ids& device_ids) const {
+        std::bitset<SHARD_COUNT> involved;
+        for (const auto& id : device_ids) {
+            involved.set(ShardOf(id));
+        }
+        return SetReadLock(this, involved);
+    }
+
+    /**
+     * Look up a record whose shard the caller holds locked through LockShared
+     * @return Null for unknown devices
+     */
+    const Record* FindLocked(InternedString device_id) const {
+        const Shard& shard = m_shards[ShardOf(device_id)];
+        auto it = shard.records.find(device_id);
+        return it != shard.records.end() ? &it->second : nullptr;
+    }
+
+    /**
+     * Consistent read over a set of devices.
+     * Every shard holding one of device_ids is share-locked for the duration
+     * of the call, then fn(device_id, const Record*) is invoked in input
+     * order; the pointer is null for unknown devices.
+     */
+    template <typename Ids, typename Fn>
+    void ReadMany(const Ids& device_ids, Fn&& fn) const {
+        SetReadLock lock = LockShared(device_ids);
+        for (const auto& id : device_ids) {
+            fn(id, FindLocked(id));
+        }
+    }
+
+    /**
+     * Visit every record of one shard under its shared lock
+     */
+    template <typename Fn>
+    void ForEachInShard(size_t shard_index, Fn&& fn) const {
+        const Shard& shard = m_shards[shard_index];
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        for (const auto& [id, record] : shard.records) {
+            fn(id, record);
+        }
+    }
+
+    size_t Size() const {
+        return m_size.load(std::memory_order_relaxed);
+    }
+
+    static size_t ShardOf(InternedString device_id) {
+        // Fold the high bits in; we only keep the low bits for the shard
+        // index.
+        size_t h = std::hash<InternedString>{}(device_id);
+        h ^= h >> 29;
+        return h % SHARD_COUNT;
+    }
+
+private:
+
+    // Keep shards on separate cache lines so lock traffic on one shard does
+    // not false-share with its neighbours.
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<InternedString, Record> records;
+    };
+
+    std::array<Shard, SHARD_COUNT> m_shards;
+    std::atomic<size_t> m_size{0};
+};
+
+} // namespace PoDD
+
+#endif // SYNC_PODD_DEVICE_STORE_H
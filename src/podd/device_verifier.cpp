@@ -2,13 +2,24 @@
 // Distributed under the MIT software license
 
 #include "device_verifier.h"
+#include "registry_store.h"
+#include "similarity_index.h"
+#include "thread_pool.h"
+#include <arpa/inet.h>
 #include <algorithm>
+#include <bitset>
 #include <cmath>
+#include <condition_variable>
+#include <cstring>
 #include <numeric>
 #include <random>
+#include <openssl/err.h>
+#include <openssl/evp.h>
 #include <openssl/sha.h>
+#include <openssl/x509.h>
 #include <sstream>
 #include <iomanip>
+#include <limits>
 
 namespace PoDD {
 
@@ -24,42 +35,50 @@ std::string BytesToHex(const uint8_t* data, size_t len) {
 
 // DeviceFingerprint implementation
 double DeviceFingerprint::CalculateSimilarity(const DeviceFingerprint& other) const {
+    using namespace Similarity;
+    
     double similarity = 0.0;
     double weight_sum = 0.0;
     
+    // Differences are taken in floating point: subtracting the unsigned
+    // fields directly wraps around whenever other's value is larger.
+    
     // Timing similarity (most important - 40% weight)
-    double timing_diff = std::abs(static_cast<double>(avg_nonce_time_us - other.avg_nonce_time_us));
-    double timing_similarity = std::exp(-timing_diff / 10000.0); // Exponential decay
-    similarity += timing_similarity * 0.4;
-    weight_sum += 0.4;
+    double timing_diff = std::abs(static_cast<double>(avg_nonce_time_us) -
+                                  static_cast<double>(other.avg_nonce_time_us));
+    double timing_similarity = std::exp(-timing_diff / TIMING_SCALE_US); // Exponential decay
+    similarity += timing_similarity * TIMING_WEIGHT;
+    weight_sum += TIMING_WEIGHT;
     
     // Variance similarity (20% weight)
-    double variance_diff = std::abs(static_cast<double>(timing_variance_us - other.timing_variance_us));
-    double variance_similarity = std::exp(-variance_diff / 5000.0);
-    similarity += variance_similarity * 0.2;
-    weight_sum += 0.2;
+    double variance_diff = std::abs(static_cast<double>(timing_variance_us) -
+                                    static_cast<double>(other.timing_variance_us));
+    double variance_similarity = std::exp(-variance_diff / VARIANCE_SCALE_US);
+    similarity += variance_similarity * VARIANCE_WEIGHT;
+    weight_sum += VARIANCE_WEIGHT;
     
     // Network similarity (20% weight)
     if (ip_address == other.ip_address) {
         // Same IP is suspicious but not conclusive
-        similarity += 0.15;
+        similarity += SAME_IP_BONUS;
     }
-    double latency_diff = std::abs(static_cast<double>(avg_latency_ms - other.avg_latency_ms));
-    double latency_similarity = std::exp(-latency_diff / 50.0);
-    similarity += latency_similarity * 0.05;
-    weight_sum += 0.2;
+    double latency_diff = std::abs(static_cast<double>(avg_latency_ms) -
+                                   static_cast<double>(other.avg_latency_ms));
+    double latency_similarity = std::exp(-latency_diff / LATENCY_SCALE_MS);
+    similarity += latency_similarity * LATENCY_WEIGHT;
+    weight_sum += CATEGORY_WEIGHT;
     
     // Hardware similarity (20% weight)
     if (firmware_version == other.firmware_version) {
-        similarity += 0.05; // Same firmware is common
+        similarity += SAME_FIRMWARE_BONUS; // Same firmware is common
     }
     if (chip_count == other.chip_count) {
-        similarity += 0.05; // Same chip count could be same model
+        similarity += SAME_CHIP_COUNT_BONUS; // Same chip count could be same model
     }
     double power_diff = std::abs(power_consumption_watts - other.power_consumption_watts);
-    double power_similarity = std::exp(-power_diff / 10.0);
-    similarity += power_similarity * 0.1;
-    weight_sum += 0.2;
+    double power_similarity = std::exp(-power_diff / POWER_SCALE_W);
+    similarity += power_similarity * POWER_WEIGHT;
+    weight_sum += CATEGORY_WEIGHT;
     
     return similarity / weight_sum;
 }
@@ -67,10 +86,10 @@ double DeviceFingerprint::CalculateSimilarity(const DeviceFingerprint& other) co
 std::string DeviceFingerprint::GetFingerprintHash() const {
     // Create a unique hash from device characteristics
     std::stringstream data;
-    data << device_id << "|"
+    data << device_id.Str() << "|"
          << avg_nonce_time_us << "|"
          << timing_variance_us << "|"
-         << firmware_version << "|"
+         << firmware_version.Str() << "|"
          << chip_count << "|"
          << memory_size_mb;
     
@@ -84,151 +103,339 @@ std::string DeviceFingerprint::GetFingerprintHash() const {
 
 // MiningSquad implementation
 bool MiningSquad::AddDevice(const std::string& device_id) {
-    if (member_devices.size() >= 10) {
+    if (member_devices.Full()) {
         return false; // Max squad size
     }
-    
-    if (std::find(member_devices.begin(), member_devices.end(), device_id) 
-        != member_devices.end()) {
-        return false; // Already in squad
-    }
-    
-    member_devices.push_back(device_id);
-    return true;
+    return member_devices.Add(InternedString::Intern(device_id));
 }
 
 bool MiningSquad::RemoveDevice(const std::string& device_id) {
-    auto it = std::find(member_devices.begin(), member_devices.end(), device_id);
-    if (it != member_devices.end()) {
-        member_devices.erase(it);
-        return true;
+    InternedString id;
+    if (!InternedString::Find(device_id, id)) {
+        return false; // Never a member of anything
     }
-    return false;
+    return member_devices.Remove(id);
 }
 
 double MiningSquad::GetRewardShare(const std::string& device_id) const {
-    if (member_devices.empty()) return 0.0;
+    if (member_devices.Empty()) return 0.0;
     
-    auto it = std::find(member_devices.begin(), member_devices.end(), device_id);
-    if (it == member_devices.end()) {
+    InternedString id;
+    if (!InternedString::Find(device_id, id)) {
+        return 0.0;
+    }
+    size_t slot = member_devices.IndexOf(id);
+    if (slot == SquadMembers::NPOS) {
         return 0.0;
     }
     
-    // Equal share for now, could be weighted by contribution later
-    return 1.0 / member_devices.size();
+    // Weighted by the work each member has submitted this round
+    uint64_t own = 0;
+    uint64_t total = 0;
+    if (shares) {
+        for (size_t i = 0; i < member_devices.Size(); ++i) {
+            uint64_t work = shares->work[i].load(std::memory_order_relaxed);
+            total += work;
+            if (i == slot) own = work;
+        }
+    }
+    if (total == 0) {
+        return 1.0 / member_devices.Size();
+    }
+    return static_cast<double>(own) / static_cast<double>(total);
 }
 
-// DeviceVerifier implementation
-struct DeviceVerifier::Impl {
-    // Timing entropy calculation
-    double CalculateTimingEntropy(const std::vector<uint64_t>& timings) {
-        if (timings.size() < 2) return 0.0;
-        
-        // Calculate probability distribution
-        std::map<uint64_t, int> histogram;
-        for (auto t : timings) {
-            histogram[t / 1000]++; // Group by millisecond
-        }
-        
-        double entropy = 0.0;
-        double n = timings.size();
-        for (const auto& [bucket, count] : histogram) {
-            double p = count / n;
-            if (p > 0) {
-                entropy -= p * std::log2(p);
-            }
-        }
+namespace {
+
+// Working buffers for VerifyDeviceDistribution. They live per thread and keep
+// their capacity, so once warmed up a verification allocates nothing beyond
+// what its result carries (reason text and suspicious pairs).
+struct VerificationScratch {
+    std::vector<InternedString> interned;
+    std::vector<uint64_t> generations;
+    std::vector<InternedString> ids;
+    std::vector<DeviceFingerprint> copies;      // Analyzed fields only
+    std::vector<const DeviceFingerprint*> fingerprints;
+    std::vector<std::pair<size_t, size_t>> pairs;
+    std::vector<InternedString> ips;
+    std::vector<const std::string*> ip_strings;
+    std::vector<uint64_t> timings;
+    TimingEntropyTracker entropy;
+    std::vector<double> samples1;
+    std::vector<double> samples2;
+    std::string key;
+};
+
+VerificationScratch& GetVerificationScratch() {
+    thread_local VerificationScratch scratch;
+    return scratch;
+}
+
+bool LessByValue(const std::string* a, const std::string* b) { return *a < *b; }
+
+// Copy the fields the set analysis reads. The nonce and traceroute buffers
+// are left alone, so copying into a scratch fingerprint does not allocate.
+void CopyAnalyzedFields(const DeviceFingerprint& from, DeviceFingerprint& to) {
+    to.avg_nonce_time_us = from.avg_nonce_time_us;
+    to.timing_variance_us = from.timing_variance_us;
+    to.timing_samples = from.timing_samples;
+    to.ip_address = from.ip_address;
+    to.avg_latency_ms = from.avg_latency_ms;
+    to.firmware_version = from.firmware_version;
+    to.chip_count = from.chip_count;
+    to.power_consumption_watts = from.power_consumption_watts;
+}
+
+// Fewer samples than this are not enough evidence either way
+constexpr size_t MIN_TIMING_SAMPLES = 16;
+constexpr uint64_t MIN_NONCE_PAIRS = 16;
+
+// Found nonces are uniform over the nonce space; a hardware search should
+// spread them over (nearly) all bins with no memory between shares
+constexpr double MIN_NONCE_ENTROPY_BITS = 1.5;
+constexpr double MAX_NONCE_MUTUAL_INFORMATION_BITS = 0.5;
+
+// Light covers about 100 km of fibre per millisecond of round trip
+constexpr double KM_PER_MS_RTT = 100.0;
+
+// Timing entropy below this many bits suggests artificial generation
+constexpr double MIN_TIMING_ENTROPY_BITS = 2.0;
+
+// The count form of the entropy can land a rounding error below an exact
+// boundary value (four equally filled buckets give exactly 2 bits)
+constexpr double ENTROPY_EPSILON = 1e-9;
+
+// The per-share check waits for this many samples; fewer than five can
+// never reach 2 bits
+constexpr uint64_t MIN_ENTROPY_SAMPLES = 8;
+
+bool LowTimingEntropy(double entropy) {
+    return entropy < MIN_TIMING_ENTROPY_BITS - ENTROPY_EPSILON;
+}
+
+bool LowTimingEntropy(const TimingEntropyTracker& tracker) {
+    return tracker.Count() >= MIN_ENTROPY_SAMPLES && LowTimingEntropy(tracker.Entropy());
+}
+
+/**
+ * Timing statistics of several devices pooled from their window moments
+ * (parallel Welford combination) rather than by gathering every sample
+ */
+struct PooledTiming {
+    double n = 0.0;
+    double mean = 0.0;
+    double m2 = 0.0;
+    
+    void Add(const RingBuffer<uint64_t, 10>& samples) {
+        if (samples.Empty()) return;
         
-        return entropy;
+        double nb = samples.Size();
+        double delta = samples.Mean() - mean;
+        double total = n + nb;
+        mean += delta * nb / total;
+        m2 += samples.SumSquaredDeviations() + delta * delta * n * nb / total;
+        n = total;
+    }
+    
+    // Low coefficient of variation suggests synchronized source
+    bool Synchronized() const {
+        if (n == 0.0) return false;
+        double cv = std::sqrt(m2 / n) / mean;
+        return cv < 0.1; // Less than 10% variation is suspicious
+    }
+};
+
+using NonceHistogram = MutualInformationHistogram<ShareStatistics::NONCE_BINS>;
+
+template <typename Nonces>
+void AddNoncePairs(const Nonces& nonces, NonceHistogram& histogram) {
+    bool first = true;
+    size_t previous = 0;
+    for (uint64_t nonce : nonces) {
+        size_t bin = ShareStatistics::NonceBin(nonce);
+        if (!first) histogram.Add(previous, bin);
+        previous = bin;
+        first = false;
+    }
+}
+
+/**
+ * Derive share statistics from a fingerprint's windows, for records that
+ * arrive with samples already in them. The statistics must still be
+ * default-constructed.
+ */
+void BuildStatistics(const DeviceFingerprint& fp, ShareStatistics& stats) {
+    for (auto t : fp.timing_samples) {
+        stats.nonce_times.Push(t);
+        stats.timing_entropy.Add(t);
+    }
+    stats.low_timing_entropy = LowTimingEntropy(stats.timing_entropy);
+    AddNoncePairs(fp.recent_nonces, stats.nonce_pairs);
+}
+
+/** A record's share statistics, built on first use */
+ShareStatistics& StatisticsOf(DeviceRecord& record) {
+    if (!record.statistics) {
+        record.statistics = std::make_unique<ShareStatistics>();
+        BuildStatistics(record.fingerprint, *record.statistics);
     }
+    return *record.statistics;
+}
+
+bool NoncesLookArtificial(const NonceHistogram& histogram) {
+    if (histogram.Count() < MIN_NONCE_PAIRS) return false;
+    return histogram.EntropyY() < MIN_NONCE_ENTROPY_BITS ||
+           histogram.MutualInformation() > MAX_NONCE_MUTUAL_INFORMATION_BITS;
+}
+
+} // namespace
+
+// DeviceVerifier implementation
+struct DeviceVerifier::Impl {
+    SimilarityIndex similarity_index;
     
     // Check if timings are too synchronized (indicates single source)
-    bool DetectSynchronizedTiming(const std::vector<DeviceFingerprint>& devices) {
+    bool DetectSynchronizedTiming(const std::vector<const DeviceFingerprint*>& devices) {
         if (devices.size() < 2) return false;
         
-        // Collect all timing samples
-        std::vector<uint64_t> all_timings;
-        for (const auto& device : devices) {
-            for (auto timing : device.timing_samples) {
-                if (timing > 0) all_timings.push_back(timing);
-            }
+        PooledTiming pooled;
+        for (const DeviceFingerprint* device : devices) {
+            pooled.Add(device->timing_samples);
         }
-        
-        if (all_timings.empty()) return false;
-        
-        // Calculate coefficient of variation
-        double mean = std::accumulate(all_timings.begin(), all_timings.end(), 0.0) / all_timings.size();
-        double sq_sum = 0.0;
-        for (auto timing : all_timings) {
-            sq_sum += std::pow(timing - mean, 2);
-        }
-        double stdev = std::sqrt(sq_sum / all_timings.size());
-        double cv = stdev / mean;
-        
-        // Low coefficient of variation suggests synchronized source
-        return cv < 0.1; // Less than 10% variation is suspicious
+        return pooled.Synchronized();
     }
 };
 
-DeviceVerifier::DeviceVerifier() : pImpl(std::make_unique<Impl>()) {}
+namespace {
+
+// Cached results older than this are recomputed (about one block)
+constexpr auto DEFAULT_CACHE_TTL = std::chrono::minutes(5);
+
+// Beyond this many entries expired results are swept out on insert
+constexpr size_t MAX_CACHE_ENTRIES = 10000;
+
+// Generation recorded for set members that are not registered
+constexpr uint64_t UNREGISTERED_GENERATION = std::numeric_limits<uint64_t>::max();
+
+void MakeCacheKey(const std::vector<InternedString>& ids, std::string& key) {
+    // Fixed-width handles, so no separator is needed
+    key.clear();
+    for (InternedString id : ids) {
+        StringInterner::Handle handle = id.GetHandle();
+        key.append(reinterpret_cast<const char*>(&handle), sizeof(handle));
+    }
+}
+
+// Interned strings are never freed, so a share's address is only interned
+// if it is a well-formed IPv4 or IPv6 address
+bool IsIpAddress(const std::string& address) {
+    unsigned char parsed[sizeof(in6_addr)];
+    return inet_pton(AF_INET, address.c_str(), parsed) == 1 ||
+           inet_pton(AF_INET6, address.c_str(), parsed) == 1;
+}
+
+} // namespace
+
+DeviceVerifier::DeviceVerifier()
+    : pImpl(std::make_unique<Impl>()),
+      m_cache_ttl(DEFAULT_CACHE_TTL) {}
 DeviceVerifier::~DeviceVerifier() = default;
 
 bool DeviceVerifier::RegisterDevice(const std::string& device_id, 
                                    const DeviceFingerprint& initial_fingerprint) {
-    // Check if device already registered
-    if (m_devices.find(device_id) != m_devices.end()) {
-        return false;
-    }
-    
-    // Store device fingerprint
-    m_devices[device_id] = initial_fingerprint;
-    m_registration_times[device_id] = std::chrono::steady_clock::now();
-    
-    return true;
+    // Store device fingerprint (fails if device already registered)
+    auto now = std::chrono::steady_clock::now();
+    return m_devices.Emplace(InternedString::Intern(device_id), [&](DeviceRecord& record) {
+        record.fingerprint = initial_fingerprint;
+        record.registered_at = now;
+        
+        // Journaled under the shard lock, so it precedes the device's shares
+        if (RegistryJournal* journal = m_journal.load(std::memory_order_acquire)) {
+            journal->AppendDeviceRegistered(device_id, record);
+        }
+    });
 }
 
 void DeviceVerifier::UpdateDeviceFingerprint(const std::string& device_id,
                                             const ShareData& share_data) {
-    auto it = m_devices.find(device_id);
-    if (it == m_devices.end()) {
-        return; // Device not registered
+    // Only the device's own shard is locked, so shares from different
+    // devices are applied in parallel
+    InternedString id;
+    if (!InternedString::Find(device_id, id)) {
+        return; // Not registered
     }
+    auto now = std::chrono::steady_clock::now();
+    m_devices.Modify(id, [&](DeviceRecord& record) {
+        ApplyShare(record, share_data, now);
+        
+        if (RegistryJournal* journal = m_journal.load(std::memory_order_acquire)) {
+            journal->AppendShare(device_id, record.generation, share_data, now);
+        }
+    });
+}
+
+void DeviceVerifier::ApplyShare(DeviceRecord& record, const ShareData& share_data,
+                                std::chrono::steady_clock::time_point seen_at) {
+    DeviceFingerprint& fp = record.fingerprint;
+    ShareStatistics& stats = StatisticsOf(record);
     
-    DeviceFingerprint& fp = it->second;
-    
-    // Update timing samples (rolling window)
-    for (int i = 9; i > 0; --i) {
-        fp.timing_samples[i] = fp.timing_samples[i-1];
+    // Update timing samples (rolling window, O(1) per share), sliding
+    // the entropy of the device and of every squad it belongs to along
+    // with them
+    if (share_data.timestamp_us > 0) {
+        bool evicts = fp.timing_samples.Full();
+        uint64_t evicted = evicts ? fp.timing_samples.Oldest() : 0;
+        auto slide = [&](TimingEntropyTracker& tracker) {
+            if (evicts) tracker.Remove(evicted);
+            tracker.Add(share_data.timestamp_us);
+        };
+        
+        slide(stats.timing_entropy);
+        stats.low_timing_entropy = LowTimingEntropy(stats.timing_entropy);
+        for (const auto& set : record.timing_sets) {
+            std::lock_guard<std::mutex> lock(set->mutex);
+            slide(set->tracker);
+            set->low_entropy = LowTimingEntropy(set->tracker);
+        }
+        
+        fp.timing_samples.Push(share_data.timestamp_us);
+        stats.nonce_times.Push(share_data.timestamp_us);
     }
-    fp.timing_samples[0] = share_data.timestamp_us;
     
-    // Update average timing
-    uint64_t sum = 0;
-    int count = 0;
-    for (auto sample : fp.timing_samples) {
-        if (sample > 0) {
-            sum += sample;
-            count++;
-        }
+    // Credit the share's difficulty to each of the device's squads
+    for (const SquadShareSlot& squad : record.squad_shares) {
+        squad.account->work[squad.slot].fetch_add(share_data.difficulty, std::memory_order_relaxed);
     }
-    if (count > 0) {
-        fp.avg_nonce_time_us = sum / count;
+    
+    // Update average timing from the window's running sum
+    if (!fp.timing_samples.Empty()) {
+        fp.avg_nonce_time_us = fp.timing_samples.Sum() / fp.timing_samples.Size();
     }
     
-    // Update other metrics
-    fp.recent_nonces.push_back(share_data.nonce);
-    if (fp.recent_nonces.size() > 100) {
-        fp.recent_nonces.erase(fp.recent_nonces.begin());
+    // Update other metrics. The nonce window slides the histogram of
+    // consecutive nonce pairs: the pair leaving the window is removed
+    // before the new one is added.
+    if (fp.recent_nonces.Full()) {
+        stats.nonce_pairs.Remove(ShareStatistics::NonceBin(fp.recent_nonces[0]),
+                                 ShareStatistics::NonceBin(fp.recent_nonces[1]));
+    }
+    if (!fp.recent_nonces.Empty()) {
+        stats.nonce_pairs.Add(ShareStatistics::NonceBin(fp.recent_nonces.Newest()),
+                              ShareStatistics::NonceBin(share_data.nonce));
     }
+    fp.recent_nonces.Push(share_data.nonce);
     
     fp.temperature_celsius = share_data.temperature;
     fp.power_consumption_watts = share_data.power_watts;
     fp.average_hashrate = share_data.hashrate;
-    fp.last_seen = std::chrono::steady_clock::now();
+    fp.last_seen = seen_at;
+    ++record.generation; // Invalidates cached verifications of this device
     
-    // Update network info if changed
-    if (!share_data.ip_address.empty()) {
-        fp.ip_address = share_data.ip_address;
+    // Update network info if changed (an unchanged address is compared,
+    // not interned again; a malformed one is ignored)
+    if (!share_data.ip_address.empty() && fp.ip_address != share_data.ip_address &&
+        IsIpAddress(share_data.ip_address)) {
+        fp.ip_address = InternedString::Intern(share_data.ip_address);
     }
     if (share_data.latency_ms > 0) {
         // Rolling average for latency
@@ -239,23 +446,76 @@ void DeviceVerifier::UpdateDeviceFingerprint(const std::string& device_id,
 DeviceVerifier::VerificationResult DeviceVerifier::VerifyDeviceDistribution(
     const std::vector<std::string>& device_ids) {
     
-    VerificationResult result;
-    result.is_valid = true;
-    result.confidence = 1.0;
-    
     if (device_ids.size() < 2) {
+        VerificationResult result;
+        result.is_valid = true;
+        result.confidence = 1.0;
         result.reason = "Single device, no distribution to verify";
         return result;
     }
     
-    // Collect fingerprints
-    std::vector<DeviceFingerprint> fingerprints;
-    for (const auto& id : device_ids) {
-        auto it = m_devices.find(id);
-        if (it != m_devices.end()) {
-            fingerprints.push_back(it->second);
+    VerificationScratch& scratch = GetVerificationScratch();
+    
+    // Squad formation and reward calculation keep verifying the same sets,
+    // so results are cached per device list. The list keeps the caller's
+    // order and any repeated IDs, since both show in the result: pairs are
+    // reported in scan order, and a repeated device matches itself. IDs that
+    // were never interned cannot be registered and add nothing to the
+    // analysis.
+    auto& interned = scratch.interned;
+    interned.clear();
+    for (const auto& device_id : device_ids) {
+        InternedString id;
+        if (InternedString::Find(device_id, id)) {
+            interned.push_back(id);
         }
     }
+    MakeCacheKey(interned, scratch.key);
+    
+    // The set's shards are share-locked only while the generations and the
+    // analyzed fields are copied out, so the analysis sees one consistent
+    // snapshot without holding up shares for the devices
+    scratch.generations.clear();
+    scratch.ids.clear();
+    scratch.fingerprints.clear();
+    if (scratch.copies.size() < interned.size()) {
+        scratch.copies.resize(interned.size());
+    }
+    {
+        auto lock = m_devices.LockShared(interned);
+        for (InternedString id : interned) {
+            const DeviceRecord* record = m_devices.FindLocked(id);
+            scratch.generations.push_back(record ? record->generation : UNREGISTERED_GENERATION);
+            if (record) {
+                CopyAnalyzedFields(record->fingerprint, scratch.copies[scratch.ids.size()]);
+                scratch.ids.push_back(id);
+            }
+        }
+    }
+    for (size_t i = 0; i < scratch.ids.size(); ++i) {
+        scratch.fingerprints.push_back(&scratch.copies[i]);
+    }
+    
+    VerificationResult result;
+    if (LookupVerificationCache(scratch.key, scratch.generations, result)) {
+        return result;
+    }
+    
+    result = AnalyzeDeviceSet(scratch.ids, scratch.fingerprints);
+    StoreVerificationCache(scratch.key, scratch.generations, result);
+    
+    return result;
+}
+
+DeviceVerifier::VerificationResult DeviceVerifier::AnalyzeDeviceSet(
+    const std::vector<InternedString>& ids,
+    const std::vector<const DeviceFingerprint*>& fingerprints) {
+    
+    VerificationScratch& scratch = GetVerificationScratch();
+    
+    VerificationResult result;
+    result.is_valid = true;
+    result.confidence = 1.0;
     
     if (fingerprints.size() < 2) {
         result.is_valid = false;
@@ -271,26 +531,26 @@ DeviceVerifier::VerificationResult DeviceVerifier::VerifyDeviceDistribution(
         result.reason = "Timing patterns too synchronized";
     }
     
-    // Check 2: Similarity between devices
-    for (size_t i = 0; i < fingerprints.size(); ++i) {
-        for (size_t j = i + 1; j < fingerprints.size(); ++j) {
-            double similarity = fingerprints[i].CalculateSimilarity(fingerprints[j]);
-            if (similarity > 0.9) {
-                result.is_valid = false;
-                result.confidence -= 0.3;
-                result.suspicious_pairs.push_back({device_ids[i], device_ids[j]});
-                result.reason = "Devices too similar (likely same hardware)";
-            }
-        }
+    // Check 2: Similarity between devices (index-pruned; finds the same
+    // pairs as scoring every pair, in the same order)
+    pImpl->similarity_index.FindSimilarPairs(fingerprints, scratch.pairs);
+    for (const auto& [i, j] : scratch.pairs) {
+        result.is_valid = false;
+        result.confidence -= 0.3;
+        result.suspicious_pairs.push_back({ids[i].Str(), ids[j].Str()});
+        result.reason = "Devices too similar (likely same hardware)";
     }
     
     // Check 3: Network diversity
-    std::set<std::string> unique_ips;
-    for (const auto& fp : fingerprints) {
-        unique_ips.insert(fp.ip_address);
+    auto& ips = scratch.ips;
+    ips.clear();
+    for (const DeviceFingerprint* fp : fingerprints) {
+        ips.push_back(fp->ip_address);
     }
+    std::sort(ips.begin(), ips.end());
+    size_t unique_ips = std::unique(ips.begin(), ips.end()) - ips.begin();
     
-    double ip_diversity = static_cast<double>(unique_ips.size()) / fingerprints.size();
+    double ip_diversity = static_cast<double>(unique_ips) / fingerprints.size();
     if (ip_diversity < 0.5) {
         result.confidence -= 0.2;
         if (result.confidence < 0.5) {
@@ -300,15 +560,16 @@ DeviceVerifier::VerificationResult DeviceVerifier::VerifyDeviceDistribution(
     }
     
     // Check 4: Timing entropy
-    std::vector<uint64_t> all_timings;
-    for (const auto& fp : fingerprints) {
-        for (auto t : fp.timing_samples) {
-            if (t > 0) all_timings.push_back(t);
+    auto& entropy_tracker = scratch.entropy;
+    entropy_tracker.Clear();
+    for (const DeviceFingerprint* fp : fingerprints) {
+        for (auto t : fp->timing_samples) {
+            if (t > 0) entropy_tracker.Add(t);
         }
     }
     
-    double entropy = pImpl->CalculateTimingEntropy(all_timings);
-    if (entropy < 2.0) { // Low entropy suggests artificial generation
+    double entropy = entropy_tracker.Entropy();
+    if (LowTimingEntropy(entropy)) { // Low entropy suggests artificial generation
         result.confidence -= 0.2;
         if (result.confidence < 0.5) {
             result.is_valid = false;
@@ -322,61 +583,131 @@ DeviceVerifier::VerificationResult DeviceVerifier::VerifyDeviceDistribution(
     return result;
 }
 
+bool DeviceVerifier::LookupVerificationCache(const std::string& key,
+                                             const std::vector<uint64_t>& generations,
+                                             VerificationResult& result) const {
+    std::lock_guard<std::mutex> lock(m_cache_mutex);
+    
+    auto it = m_verification_cache.find(key);
+    if (it == m_verification_cache.end() ||
+        std::chrono::steady_clock::now() - it->second.timestamp >= m_cache_ttl ||
+        it->second.generations != generations) {
+        m_cache_misses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    
+    m_cache_hits.fetch_add(1, std::memory_order_relaxed);
+    result = it->second.result;
+    return true;
+}
+
+void DeviceVerifier::StoreVerificationCache(const std::string& key,
+                                            const std::vector<uint64_t>& generations,
+                                            const VerificationResult& result) {
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(m_cache_mutex);
+    
+    if (m_verification_cache.size() >= MAX_CACHE_ENTRIES) {
+        for (auto it = m_verification_cache.begin(); it != m_verification_cache.end();) {
+            if (now - it->second.timestamp >= m_cache_ttl) {
+                it = m_verification_cache.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        // Still full of live entries: start over rather than grow unbounded
+        if (m_verification_cache.size() >= MAX_CACHE_ENTRIES) {
+            m_verification_cache.clear();
+        }
+    }
+    
+    // Assign into the existing entry so refreshing a known set reuses its
+    // buffers instead of allocating new ones
+    auto it = m_verification_cache.find(key);
+    if (it == m_verification_cache.end()) {
+        it = m_verification_cache.emplace(key, VerificationCache()).first;
+    }
+    VerificationCache& entry = it->second;
+    entry.timestamp = now;
+    entry.generations = generations;
+    entry.result = result;
+}
+
+DeviceVerifier::VerificationCacheStats DeviceVerifier::GetVerificationCacheStats() const {
+    VerificationCacheStats stats;
+    stats.hits = m_cache_hits.load(std::memory_order_relaxed);
+    stats.misses = m_cache_misses.load(std::memory_order_relaxed);
+    
+    std::lock_guard<std::mutex> lock(m_cache_mutex);
+    stats.entries = m_verification_cache.size();
+    return stats;
+}
+
+void DeviceVerifier::SetVerificationCacheTTL(std::chrono::seconds ttl) {
+    std::lock_guard<std::mutex> lock(m_cache_mutex);
+    m_cache_ttl = ttl;
+}
+
 bool DeviceVerifier::DetectSpoofing(const std::vector<std::string>& device_ids) {
     auto verification = VerifyDeviceDistribution(device_ids);
     return !verification.is_valid && verification.confidence < 0.3;
 }
 
 double DeviceVerifier::GetDeviceRewardMultiplier(const std::string& device_id) const {
-    auto it = m_devices.find(device_id);
-    if (it == m_devices.end()) {
-        return 1.0; // No bonus for unregistered devices
-    }
+    double multiplier = 1.0; // No bonus for unregistered devices
     
-    // Check device registration age (anti-gaming)
-    auto reg_it = m_registration_times.find(device_id);
-    if (reg_it != m_registration_times.end()) {
-        auto age = std::chrono::steady_clock::now() - reg_it->second;
+    InternedString id;
+    if (!InternedString::Find(device_id, id)) {
+        return multiplier;
+    }
+    m_devices.Read(id, [&](const DeviceRecord& record) {
+        // Check device registration age (anti-gaming)
+        auto age = std::chrono::steady_clock::now() - record.registered_at;
         auto hours = std::chrono::duration_cast<std::chrono::hours>(age).count();
         
         if (hours < 24) {
-            return 1.0; // No bonus for very new devices
+            return; // No bonus for very new devices
         }
-    }
-    
-    // Base multiplier for verified device
-    double multiplier = 1.1; // 10% bonus
-    
-    // Additional bonus for consistent mining
-    const auto& fp = it->second;
-    auto time_since_last = std::chrono::steady_clock::now() - fp.last_seen;
-    auto minutes = std::chrono::duration_cast<std::chrono::minutes>(time_since_last).count();
-    
-    if (minutes < 10) {
-        multiplier += 0.05; // 5% bonus for active mining
-    }
-    
-    // Efficiency bonus (hashes per watt)
-    if (fp.power_consumption_watts > 0 && fp.average_hashrate > 0) {
-        double efficiency = fp.average_hashrate / fp.power_consumption_watts;
-        if (efficiency > 100) { // GH/s per watt
-            multiplier += 0.05; // 5% efficiency bonus
+        
+        // Base multiplier for verified device
+        multiplier = 1.1; // 10% bonus
+        
+        // Additional bonus for consistent mining
+        const auto& fp = record.fingerprint;
+        auto time_since_last = std::chrono::steady_clock::now() - fp.last_seen;
+        auto minutes = std::chrono::duration_cast<std::chrono::minutes>(time_since_last).count();
+        
+        if (minutes < 10) {
+            multiplier += 0.05; // 5% bonus for active mining
         }
-    }
+        
+        // Efficiency bonus (hashes per watt)
+        if (fp.power_consumption_watts > 0 && fp.average_hashrate > 0) {
+            double efficiency = fp.average_hashrate / fp.power_consumption_watts;
+            if (efficiency > 100) { // GH/s per watt
+                multiplier += 0.05; // 5% efficiency bonus
+            }
+        }
+    });
     
     return multiplier;
 }
 
 std::string DeviceVerifier::FormMiningSquad(const std::vector<std::string>& device_ids) {
-    if (device_ids.size() < 2 || device_ids.size() > 10) {
+    if (device_ids.size() < 2 || device_ids.size() > SquadMembers::CAPACITY) {
         return ""; // Invalid squad size
     }
     
     // Verify all devices are registered
-    for (const auto& id : device_ids) {
-        if (m_devices.find(id) == m_devices.end()) {
+    MiningSquad squad;
+    for (const auto& device_id : device_ids) {
+        InternedString id;
+        if (!InternedString::Find(device_id, id) || !m_devices.Contains(id)) {
             return ""; // Unregistered device
         }
+        if (!squad.member_devices.Add(id)) {
+            return ""; // Listed twice
+        }
     }
     
     // Verify devices are genuinely different
@@ -384,15 +715,7 @@ std::string DeviceVerifier::FormMiningSquad(const std::vector<std::string>& devi
         return ""; // Spoofing detected
     }
     
-    // Generate squad ID
-    std::stringstream squad_id_stream;
-    squad_id_stream << "SQUAD_" << std::chrono::steady_clock::now().time_since_epoch().count();
-    std::string squad_id = squad_id_stream.str();
-    
     // Create squad
-    MiningSquad squad;
-    squad.squad_id = squad_id;
-    squad.member_devices = device_ids;
     squad.created_at = std::chrono::steady_clock::now();
     squad.total_hashrate = 0;
     squad.blocks_found = 0;
@@ -402,66 +725,844 @@ std::string DeviceVerifier::FormMiningSquad(const std::vector<std::string>& devi
         squad.total_hashrate += GetDeviceHashrate(id);
     }
     
-    m_squads[squad_id] = squad;
+    std::lock_guard<std::mutex> lock(m_squads_mutex);
+    
+    // Generate squad ID
+    std::stringstream squad_id_stream;
+    squad_id_stream << "SQUAD_" << std::chrono::steady_clock::now().time_since_epoch().count();
+    std::string squad_id = squad_id_stream.str();
+    while (m_squads.count(squad_id)) {
+        squad_id += "_";
+    }
+    squad.squad_id = squad_id;
+    
+    // Each member starts crediting its work to the squad and feeding the
+    // squad's timing entropy at once; the entropy is seeded with the
+    // member's window at that moment, so no share falls between the two
+    squad.timing_entropy = std::make_shared<SetTimingEntropy>();
+    squad.shares = std::make_shared<SquadShareAccount>();
+    for (size_t slot = 0; slot < squad.member_devices.Size(); ++slot) {
+        m_devices.Modify(squad.member_devices[slot], [&](DeviceRecord& record) {
+            record.squad_shares.push_back({squad.shares, static_cast<uint8_t>(slot)});
+            std::lock_guard<std::mutex> set_lock(squad.timing_entropy->mutex);
+            for (auto t : record.fingerprint.timing_samples) {
+                squad.timing_entropy->tracker.Add(t);
+            }
+            squad.timing_entropy->low_entropy = LowTimingEntropy(squad.timing_entropy->tracker);
+            record.timing_sets.push_back(squad.timing_entropy);
+        });
+    }
+    
+    const MiningSquad& stored = m_squads.emplace(squad_id, std::move(squad)).first->second;
+    for (InternedString id : stored.member_devices) {
+        m_device_squads.emplace(id, &stored);
+    }
     
     return squad_id;
 }
 
+std::vector<std::string> DeviceVerifier::GetDeviceSquads(const std::string& device_id) const {
+    std::vector<std::string> squads;
+    InternedString id;
+    if (!InternedString::Find(device_id, id)) {
+        return squads;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_squads_mutex);
+        auto range = m_device_squads.equal_range(id);
+        for (auto it = range.first; it != range.second; ++it) {
+            squads.push_back(it->second->squad_id);
+        }
+    }
+    std::sort(squads.begin(), squads.end());
+    return squads;
+}
+
+size_t DeviceVerifier::GetSquadSize(const std::string& squad_id) const {
+    std::lock_guard<std::mutex> lock(m_squads_mutex);
+    auto it = m_squads.find(squad_id);
+    return it == m_squads.end() ? 0 : it->second.member_devices.Size();
+}
+
+bool DeviceVerifier::GetSquadWork(const std::string& squad_id,
+                                  std::vector<std::pair<std::string, uint64_t>>& work) const {
+    return CollectSquadWork(squad_id, work, false);
+}
+
+bool DeviceVerifier::TakeSquadWork(const std::string& squad_id,
+                                   std::vector<std::pair<std::string, uint64_t>>& work) {
+    return CollectSquadWork(squad_id, work, true);
+}
+
+bool DeviceVerifier::CollectSquadWork(const std::string& squad_id,
+                                      std::vector<std::pair<std::string, uint64_t>>& work,
+                                      bool take) const {
+    std::lock_guard<std::mutex> lock(m_squads_mutex);
+    auto it = m_squads.find(squad_id);
+    if (it == m_squads.end()) {
+        return false;
+    }
+    
+    const MiningSquad& squad = it->second;
+    work.clear();
+    work.reserve(squad.member_devices.Size());
+    for (size_t i = 0; i < squad.member_devices.Size(); ++i) {
+        std::atomic<uint64_t>& counter = squad.shares->work[i];
+        uint64_t value = take ? counter.exchange(0, std::memory_order_relaxed)
+                              : counter.load(std::memory_order_relaxed);
+        work.emplace_back(squad.member_devices[i].Str(), value);
+    }
+    return true;
+}
+
 double DeviceVerifier::GetDeviceHashrate(const std::string& device_id) const {
-    auto it = m_devices.find(device_id);
-    if (it != m_devices.end()) {
-        return it->second.average_hashrate;
+    double hashrate = 0.0;
+    InternedString id;
+    if (!InternedString::Find(device_id, id)) {
+        return hashrate;
+    }
+    m_devices.Read(id, [&](const DeviceRecord& record) {
+        hashrate = record.fingerprint.average_hashrate;
+    });
+    return hashrate;
+}
+
+void DeviceVerifier::SnapshotShard(size_t shard,
+                                   std::vector<std::pair<std::string, DeviceFingerprint>>& out) const {
+    m_devices.ForEachInShard(shard, [&](InternedString id, const DeviceRecord& record) {
+        out.emplace_back(id.Str(), record.fingerprint);
+    });
+}
+
+std::vector<std::pair<std::string, std::vector<std::string>>> DeviceVerifier::GetSquads() const {
+    std::lock_guard<std::mutex> lock(m_squads_mutex);
+    std::vector<std::pair<std::string, std::vector<std::string>>> squads;
+    squads.reserve(m_squads.size());
+    for (const auto& [squad_id, squad] : m_squads) {
+        squads.emplace_back(squad_id, std::vector<std::string>(squad.member_devices.begin(),
+                                                               squad.member_devices.end()));
+    }
+    return squads;
+}
+
+size_t DeviceVerifier::GetDeviceCount() const {
+    return m_devices.Size();
+}
+
+bool DeviceVerifier::GetDeviceStatistics(const std::string& device_id,
+                                         DeviceStatistics& stats) const {
+    InternedString id;
+    if (!InternedString::Find(device_id, id)) {
+        return false;
+    }
+    return m_devices.Read(id, [&](const DeviceRecord& record) {
+        // A device with no share since it was registered or restored has
+        // no statistics yet; derive them without keeping them
+        ShareStatistics derived;
+        const ShareStatistics* statistics = record.statistics.get();
+        if (!statistics) {
+            BuildStatistics(record.fingerprint, derived);
+            statistics = &derived;
+        }
+        const auto& times = statistics->nonce_times;
+        const auto& pairs = statistics->nonce_pairs;
+        
+        stats.timing_samples = times.Size();
+        stats.timing_ks_distance = ExponentialKSDistance(times.Sorted(), times.Size(), times.Mean());
+        stats.timing_consistent = CheckTimingConsistency(*statistics);
+        stats.nonce_pairs = pairs.Count();
+        stats.nonce_entropy = pairs.EntropyY();
+        stats.nonce_mutual_information = pairs.MutualInformation();
+        stats.nonce_artificial = NoncesLookArtificial(pairs);
+        stats.timing_entropy = statistics->timing_entropy.Entropy();
+        stats.low_timing_entropy = statistics->low_timing_entropy;
+        stats.network_consistent = CheckNetworkConsistency(record);
+        stats.hardware_consistent = CheckHardwareConsistency(record);
+    });
+}
+
+bool DeviceVerifier::GetSquadTimingEntropy(const std::string& squad_id, double& entropy,
+                                           bool& low_entropy) const {
+    std::shared_ptr<SetTimingEntropy> set;
+    {
+        std::lock_guard<std::mutex> lock(m_squads_mutex);
+        auto it = m_squads.find(squad_id);
+        if (it == m_squads.end() || !it->second.timing_entropy) {
+            return false;
+        }
+        set = it->second.timing_entropy;
+    }
+    
+    std::lock_guard<std::mutex> lock(set->mutex);
+    entropy = set->tracker.Entropy();
+    low_entropy = set->low_entropy;
+    return true;
+}
+
+void DeviceVerifier::SetJournal(RegistryJournal* journal) {
+    m_journal.store(journal, std::memory_order_release);
+}
+
+void DeviceVerifier::VisitShard(size_t shard,
+                                const std::function<void(std::string_view, const DeviceRecord&)>& fn) const {
+    m_devices.ForEachInShard(shard, [&](InternedString id, const DeviceRecord& record) {
+        fn(id.View(), record);
+    });
+}
+
+void DeviceVerifier::ReserveDevices(size_t count) {
+    m_devices.Reserve(count);
+}
+
+bool DeviceVerifier::RestoreDevice(InternedString device_id,
+                                   const std::function<void(DeviceRecord&)>& init) {
+    return m_devices.Emplace(device_id, init);
+}
+
+size_t DeviceVerifier::RestoreDevices(const InternedString* device_ids, size_t count,
+                                      const std::function<void(size_t, DeviceRecord&)>& init) {
+    return m_devices.EmplaceMany(device_ids, count, init);
+}
+
+bool DeviceVerifier::ReplayShare(const std::string& device_id, const ShareData& share_data,
+                                 std::chrono::steady_clock::time_point seen_at, uint64_t generation) {
+    bool applied = false;
+    InternedString id;
+    if (!InternedString::Find(device_id, id)) {
+        return applied;
+    }
+    m_devices.Modify(id, [&](DeviceRecord& record) {
+        if (record.generation >= generation) {
+            return; // Already part of the snapshot
+        }
+        ApplyShare(record, share_data, seen_at);
+        record.generation = generation;
+        applied = true;
+    });
+    return applied;
+}
+
+bool DeviceVerifier::CheckTimingConsistency(const ShareStatistics& statistics) const {
+    // Shares arrive as a Poisson process, so time to find a nonce is
+    // exponentially distributed; replayed or scripted timings are not
+    const auto& times = statistics.nonce_times;
+    if (times.Size() < MIN_TIMING_SAMPLES) {
+        return true;
+    }
+    double distance = ExponentialKSDistance(times.Sorted(), times.Size(), times.Mean());
+    return !ExponentialFitRejected(distance, times.Size());
+}
+
+bool DeviceVerifier::CheckNetworkConsistency(const DeviceRecord& record) const {
+    const DeviceFingerprint& fp = record.fingerprint;
+    if (fp.ip_address.Empty()) {
+        return false;
+    }
+    // A device that has submitted shares from a real network link cannot
+    // report a zero round trip
+    return fp.recent_nonces.Empty() || fp.avg_latency_ms > 0;
+}
+
+bool DeviceVerifier::CheckHardwareConsistency(const DeviceRecord& record) const {
+    const DeviceFingerprint& fp = record.fingerprint;
+    if (fp.chip_count == 0) {
+        return false;
+    }
+    // Hashing without drawing power is not possible
+    return !(fp.average_hashrate > 0 && fp.power_consumption_watts <= 0);
+}
+
+double DeviceVerifier::CalculateKolmogorovSmirnovStatistic(const std::vector<double>& sample1,
+                                                           const std::vector<double>& sample2) const {
+    VerificationScratch& scratch = GetVerificationScratch();
+    scratch.samples1.assign(sample1.begin(), sample1.end());
+    scratch.samples2.assign(sample2.begin(), sample2.end());
+    std::sort(scratch.samples1.begin(), scratch.samples1.end());
+    std::sort(scratch.samples2.begin(), scratch.samples2.end());
+    
+    return KolmogorovSmirnovDistance(scratch.samples1.data(), scratch.samples1.size(),
+                                     scratch.samples2.data(), scratch.samples2.size());
+}
+
+double DeviceVerifier::CalculateMutualInformation(const std::vector<uint64_t>& data1,
+                                                  const std::vector<uint64_t>& data2) const {
+    // Values are binned like nonces; extra values in the longer input are ignored
+    NonceHistogram histogram;
+    size_t count = std::min(data1.size(), data2.size());
+    for (size_t i = 0; i < count; ++i) {
+        histogram.Add(ShareStatistics::NonceBin(data1[i]), ShareStatistics::NonceBin(data2[i]));
+    }
+    return histogram.MutualInformation();
+}
+
+// TimingAnalysis implementation
+bool DeviceVerifier::TimingAnalysis::AnalyzeTimingPatterns(const std::vector<uint64_t>& timestamps) {
+    if (timestamps.size() < MIN_TIMING_SAMPLES) {
+        return true; // Not enough evidence
+    }
+    
+    auto& sorted = GetVerificationScratch().timings;
+    sorted.assign(timestamps.begin(), timestamps.end());
+    std::sort(sorted.begin(), sorted.end());
+    
+    double mean = std::accumulate(sorted.begin(), sorted.end(), 0.0) / sorted.size();
+    double distance = ExponentialKSDistance(sorted.data(), sorted.size(), mean);
+    return !ExponentialFitRejected(distance, sorted.size());
+}
+
+double DeviceVerifier::TimingAnalysis::CalculateTimingEntropy(const DeviceFingerprint& fp) {
+    auto& tracker = GetVerificationScratch().entropy;
+    tracker.Clear();
+    for (auto t : fp.timing_samples) {
+        if (t > 0) tracker.Add(t);
+    }
+    return tracker.Entropy();
+}
+
+bool DeviceVerifier::TimingAnalysis::DetectSynchronizedTiming(const std::vector<DeviceFingerprint>& devices) {
+    if (devices.size() < 2) return false;
+    
+    PooledTiming pooled;
+    for (const auto& device : devices) {
+        pooled.Add(device.timing_samples);
+    }
+    return pooled.Synchronized();
+}
+
+// NetworkAnalysis implementation
+bool DeviceVerifier::NetworkAnalysis::VerifyNetworkDiversity(const std::vector<DeviceFingerprint>& devices) {
+    if (devices.empty()) return true;
+    
+    auto& ips = GetVerificationScratch().ips;
+    ips.clear();
+    for (const auto& fp : devices) {
+        ips.push_back(fp.ip_address);
+    }
+    std::sort(ips.begin(), ips.end());
+    size_t unique_ips = std::unique(ips.begin(), ips.end()) - ips.begin();
+    
+    return static_cast<double>(unique_ips) / devices.size() >= 0.5;
+}
+
+double DeviceVerifier::NetworkAnalysis::EstimateGeographicDistance(const DeviceFingerprint& d1,
+                                                                  const DeviceFingerprint& d2) {
+    if (d1.ip_address == d2.ip_address) {
+        return 0.0;
     }
-    return 0.0;
+    // Lower bound in km: two devices whose round trips to the pool differ by
+    // dt ms cannot be closer than the distance light covers in that time
+    double rtt_diff = std::abs(static_cast<double>(d1.avg_latency_ms) -
+                               static_cast<double>(d2.avg_latency_ms));
+    return rtt_diff * KM_PER_MS_RTT;
+}
+
+bool DeviceVerifier::NetworkAnalysis::DetectNATSpoofing(const std::vector<std::string>& ip_addresses) {
+    if (ip_addresses.size() < 2) return false;
+    
+    auto& ips = GetVerificationScratch().ip_strings;
+    ips.clear();
+    for (const auto& ip : ip_addresses) {
+        ips.push_back(&ip);
+    }
+    std::sort(ips.begin(), ips.end(), LessByValue);
+    
+    // Most "devices" behind one address means one operator behind a NAT
+    size_t largest = 0;
+    for (size_t begin = 0; begin < ips.size();) {
+        size_t end = begin + 1;
+        while (end < ips.size() && *ips[end] == *ips[begin]) {
+            ++end;
+        }
+        largest = std::max(largest, end - begin);
+        begin = end;
+    }
+    return largest > 1 && largest * 2 > ips.size();
+}
+
+// NonceAnalysis implementation
+bool DeviceVerifier::NonceAnalysis::AnalyzeNoncePatterns(const std::vector<uint64_t>& nonces) {
+    NonceHistogram histogram;
+    AddNoncePairs(nonces, histogram);
+    return !NoncesLookArtificial(histogram);
+}
+
+double DeviceVerifier::NonceAnalysis::CalculateNonceEntropy(const std::vector<uint64_t>& nonces) {
+    NonceHistogram histogram;
+    for (uint64_t nonce : nonces) {
+        histogram.Add(ShareStatistics::NonceBin(nonce), 0);
+    }
+    return histogram.EntropyX();
+}
+
+bool DeviceVerifier::NonceAnalysis::DetectArtificialNonceGeneration(const DeviceFingerprint& fp) {
+    NonceHistogram histogram;
+    AddNoncePairs(fp.recent_nonces, histogram);
+    return NoncesLookArtificial(histogram);
 }
 
 // DeviceRegistry implementation
+namespace {
+
+// DER SubjectPublicKeyInfo header for a secp256k1 key (id-ecPublicKey,
+// secp256k1), up to the BIT STRING holding the SEC1 point
+constexpr unsigned char SPKI_COMPRESSED[] = {
+    0x30, 0x36, 0x30, 0x10, 0x06, 0x07, 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x02, 0x01,
+    0x06, 0x05, 0x2b, 0x81, 0x04, 0x00, 0x0a, 0x03, 0x22, 0x00,
+};
+constexpr unsigned char SPKI_UNCOMPRESSED[] = {
+    0x30, 0x56, 0x30, 0x10, 0x06, 0x07, 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x02, 0x01,
+    0x06, 0x05, 0x2b, 0x81, 0x04, 0x00, 0x0a, 0x03, 0x42, 0x00,
+};
+static_assert(sizeof(SPKI_COMPRESSED) == sizeof(SPKI_UNCOMPRESSED), "Same header layout");
+
+constexpr char REGISTRATION_DOMAIN[] = "SYNC device registration v1";
+
+void PutLittleEndian(std::string& out, uint64_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; ++i) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+void PutBytes(std::string& out, const void* data, size_t size) {
+    PutLittleEndian(out, size, 4);
+    out.append(static_cast<const char*>(data), size);
+}
+
+void PutBytes(std::string& out, std::string_view s) {
+    PutBytes(out, s.data(), s.size());
+}
+
+/** Wait for a fixed number of tasks */
+class Latch {
+public:
+    explicit Latch(size_t count) : m_count(count) {}
+    
+    void CountDown() {
+        // Notify under the lock: the waiter may destroy the latch as soon as
+        // it sees zero
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_count == 0) {
+            m_cv.notify_all();
+        }
+    }
+    
+    void Wait() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [this] { return m_count == 0; });
+    }
+    
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    size_t m_count;
+};
+
+} // namespace
+
+// DeviceRegistration implementation
+std::string DeviceRegistration::GetSigningMessage() const {
+    std::string message;
+    PutBytes(message, REGISTRATION_DOMAIN, sizeof(REGISTRATION_DOMAIN) - 1);
+    PutBytes(message, device_id);
+    PutBytes(message, manufacturer);
+    PutBytes(message, model);
+    PutBytes(message, serial_number);
+    PutBytes(message, firmware_version);
+    PutLittleEndian(message, chip_count, 4);
+    
+    uint64_t hashrate_bits;
+    std::memcpy(&hashrate_bits, &max_hashrate_ghs, sizeof(hashrate_bits));
+    PutLittleEndian(message, hashrate_bits, 8);
+    
+    auto manufactured = std::chrono::duration_cast<std::chrono::seconds>(
+        manufacture_date.time_since_epoch()).count();
+    PutLittleEndian(message, static_cast<uint64_t>(manufactured), 8);
+    
+    PutBytes(message, owner_address);
+    PutBytes(message, owner_pubkey.data(), owner_pubkey.size());
+    return message;
+}
+
+bool DeviceRegistration::VerifySignature() const {
+    const unsigned char* header;
+    if (owner_pubkey.size() == 33 && (owner_pubkey[0] == 0x02 || owner_pubkey[0] == 0x03)) {
+        header = SPKI_COMPRESSED;
+    } else if (owner_pubkey.size() == 65 && owner_pubkey[0] == 0x04) {
+        header = SPKI_UNCOMPRESSED;
+    } else {
+        return false;
+    }
+    if (signature.empty()) {
+        return false;
+    }
+    
+    unsigned char spki[sizeof(SPKI_COMPRESSED) + 65];
+    std::memcpy(spki, header, sizeof(SPKI_COMPRESSED));
+    std::memcpy(spki + sizeof(SPKI_COMPRESSED), owner_pubkey.data(), owner_pubkey.size());
+    const unsigned char* cursor = spki;
+    
+    // Decoding rejects points that are not on the curve
+    std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> key(
+        d2i_PUBKEY(nullptr, &cursor, static_cast<long>(sizeof(SPKI_COMPRESSED) + owner_pubkey.size())),
+        EVP_PKEY_free);
+    std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> context(EVP_MD_CTX_new(), EVP_MD_CTX_free);
+    
+    std::string message = GetSigningMessage();
+    bool valid = key && context &&
+                 EVP_DigestVerifyInit(context.get(), nullptr, EVP_sha256(), nullptr, key.get()) == 1 &&
+                 EVP_DigestVerify(context.get(), signature.data(), signature.size(),
+                                  reinterpret_cast<const unsigned char*>(message.data()),
+                                  message.size()) == 1;
+    if (!valid) {
+        ERR_clear_error(); // Don't leave the failure on this thread's error queue
+    }
+    return valid;
+}
+
+/**
+ * Copy-on-write edit of a registry snapshot. The root is copied up front;
+ * a shard, and the group holding it, are copied the first time the shard is
+ * modified, and later edits in the same transaction go to that copy.
+ */
+class DeviceRegistry::Transaction {
+public:
+    explicit Transaction(const Snapshot& base)
+        : m_next(std::make_shared<Snapshot>(base)) {}
+    
+    bool Register(DeviceRegistration registration) {
+        // Looked up first, so a rejected ID is never interned
+        InternedString device_id;
+        if (InternedString::Find(registration.device_id, device_id) &&
+            m_next->devices.Get(ShardOf(device_id)).count(device_id)) {
+            return false; // Already registered
+        }
+        device_id = InternedString::Intern(registration.device_id);
+        size_t shard = ShardOf(device_id);
+        Owners(registration.owner_address)[registration.owner_address].push_back(device_id);
+        m_devices.Mutable(m_next->devices, shard)
+            .emplace(device_id, std::make_shared<const DeviceRegistration>(std::move(registration)));
+        ++m_next->device_count;
+        return true;
+    }
+    
+    bool Transfer(InternedString device_id, const std::string& from_address,
+                  const std::string& to_address) {
+        size_t shard = ShardOf(device_id);
+        const DeviceShard& devices = m_next->devices.Get(shard);
+        auto it = devices.find(device_id);
+        if (it == devices.end() || it->second->owner_address != from_address) {
+            return false;
+        }
+        
+        auto updated = std::make_shared<DeviceRegistration>(*it->second);
+        updated->owner_address = to_address;
+        m_devices.Mutable(m_next->devices, shard)[device_id] = std::move(updated);
+        
+        OwnerShard& from_shard = Owners(from_address);
+        auto owner = from_shard.find(from_address);
+        auto& owned = owner->second;
+        *std::find(owned.begin(), owned.end(), device_id) = std::move(owned.back());
+        owned.pop_back();
+        if (owned.empty()) {
+            from_shard.erase(owner);
+        }
+        Owners(to_address)[to_address].push_back(device_id);
+        return true;
+    }
+    
+    /** @return The new change sequence */
+    uint64_t Advance() { return ++m_next->sequence; }
+    void SetSequence(uint64_t sequence) { m_next->sequence = sequence; }
+    
+    std::shared_ptr<const Snapshot> Finish() { return std::move(m_next); }
+    
+private:
+    /** Tracks which groups and shards of one table are private copies */
+    template <typename Shard>
+    class Copies {
+    public:
+        Shard& Mutable(ShardTable<Shard>& table, size_t shard) {
+            using Group = typename ShardTable<Shard>::Group;
+            size_t group = shard / SHARDS_PER_GROUP;
+            size_t slot = shard % SHARDS_PER_GROUP;
+            
+            if (!m_groups[group]) {
+                auto copy = std::make_shared<Group>(*table.groups[group]);
+                m_groups[group] = copy.get();
+                table.groups[group] = std::move(copy);
+            }
+            auto& entry = (*m_groups[group])[slot];
+            if (!m_shards.test(shard)) {
+                entry = std::make_shared<Shard>(*entry);
+                m_shards.set(shard);
+            }
+            // Created non-const just above and not yet published
+            return const_cast<Shard&>(*entry);
+        }
+        
+    private:
+        std::array<typename ShardTable<Shard>::Group*, GROUP_COUNT> m_groups{};
+        std::bitset<SHARD_COUNT> m_shards;
+    };
+    
+    OwnerShard& Owners(const std::string& owner_address) {
+        return m_owners.Mutable(m_next->owners, ShardOf(owner_address));
+    }
+    
+    std::shared_ptr<Snapshot> m_next;
+    Copies<DeviceShard> m_devices;
+    Copies<OwnerShard> m_owners;
+};
+
+DeviceRegistry::DeviceRegistry()
+    : m_snapshot(EmptySnapshot()) {}
+
 DeviceRegistry& DeviceRegistry::GetInstance() {
     static DeviceRegistry instance;
     return instance;
 }
 
+std::shared_ptr<const DeviceRegistry::Snapshot> DeviceRegistry::EmptySnapshot() {
+    // Every shard starts out as the same empty map, in the same group
+    auto devices = std::make_shared<ShardTable<DeviceShard>::Group>();
+    devices->fill(std::make_shared<const DeviceShard>());
+    auto owners = std::make_shared<ShardTable<OwnerShard>::Group>();
+    owners->fill(std::make_shared<const OwnerShard>());
+    
+    auto snapshot = std::make_shared<Snapshot>();
+    snapshot->devices.groups.fill(devices);
+    snapshot->owners.groups.fill(owners);
+    return snapshot;
+}
+
+size_t DeviceRegistry::ShardOf(const std::string& key) {
+    size_t h = std::hash<std::string>{}(key);
+    h ^= h >> 29;
+    return h % SHARD_COUNT;
+}
+
+size_t DeviceRegistry::ShardOf(InternedString key) {
+    size_t h = std::hash<InternedString>{}(key);
+    h ^= h >> 29;
+    return h % SHARD_COUNT;
+}
+
+const DeviceRegistry::Snapshot& DeviceRegistry::AcquireSnapshot() const {
+    // Each thread holds on to the last snapshot it loaded and only goes back
+    // to the shared pointer (whose atomic load takes a lock inside the
+    // standard library) after a writer has published
+    struct Cached {
+        const DeviceRegistry* registry = nullptr;
+        uint64_t version = 0;
+        std::shared_ptr<const Snapshot> snapshot;
+    };
+    thread_local Cached cached;
+    
+    uint64_t version = m_version.load(std::memory_order_acquire);
+    if (cached.registry != this || cached.version != version || !cached.snapshot) {
+        cached.snapshot = std::atomic_load(&m_snapshot);
+        cached.registry = this;
+        cached.version = version;
+    }
+    return *cached.snapshot;
+}
+
+void DeviceRegistry::Publish(std::shared_ptr<const Snapshot> snapshot) {
+    std::atomic_store(&m_snapshot, std::move(snapshot));
+    m_version.fetch_add(1, std::memory_order_release);
+}
+
 bool DeviceRegistry::RegisterDevice(const DeviceRegistration& registration) {
-    if (m_registrations.find(registration.device_id) != m_registrations.end()) {
-        return false; // Already registered
+    return registration.VerifySignature() && Commit(&registration, 1).committed;
+}
+
+DeviceRegistry::BatchRegistrationResult
+DeviceRegistry::RegisterDevices(const std::vector<DeviceRegistration>& registrations,
+                                WorkStealingPool* pool) {
+    const size_t count = registrations.size();
+    if (count == 0) {
+        return {true, 0, ""};
     }
     
-    m_registrations[registration.device_id] = registration;
-    return true;
+    std::vector<char> valid(count, 0);
+    auto verify = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            valid[i] = registrations[i].VerifySignature();
+        }
+    };
+    
+    if (pool && count > 1) {
+        // A few tasks per worker, so stealing evens out slow chunks
+        size_t tasks = std::min(count, pool->GetThreadCount() * 4);
+        size_t chunk = (count + tasks - 1) / tasks;
+        tasks = (count + chunk - 1) / chunk;
+        Latch done(tasks);
+        for (size_t begin = 0; begin < count; begin += chunk) {
+            size_t end = std::min(count, begin + chunk);
+            pool->Submit([&verify, &valid, &done, begin, end] {
+                // The pool swallows exceptions, so count down whatever happens
+                // or Wait() below never returns. A chunk that could not be
+                // checked (bad_alloc inside OpenSSL, say) is rejected whole.
+                try {
+                    verify(begin, end);
+                } catch (...) {
+                    std::fill(valid.begin() + begin, valid.begin() + end, 0);
+                }
+                done.CountDown();
+            });
+        }
+        done.Wait();
+    } else {
+        verify(0, count);
+    }
+    
+    auto invalid = std::find(valid.begin(), valid.end(), 0);
+    if (invalid != valid.end()) {
+        size_t index = invalid - valid.begin();
+        return {false, index, "Invalid signature for device " + registrations[index].device_id};
+    }
+    return Commit(registrations.data(), count);
+}
+
+DeviceRegistry::BatchRegistrationResult
+DeviceRegistry::Commit(const DeviceRegistration* registrations, size_t count) {
+    std::lock_guard<std::mutex> lock(m_write_mutex);
+    Transaction transaction(*std::atomic_load(&m_snapshot));
+    for (size_t i = 0; i < count; ++i) {
+        if (!transaction.Register(registrations[i])) {
+            return {false, i, "Device " + registrations[i].device_id +
+                              " already registered or listed twice"};
+        }
+    }
+    
+    uint64_t first_sequence = transaction.Advance();
+    transaction.SetSequence(first_sequence + count - 1);
+    Publish(transaction.Finish());
+    if (m_journal) {
+        m_journal->AppendRegistrations(registrations, count, first_sequence);
+    }
+    return {true, count, ""};
 }
 
 bool DeviceRegistry::VerifyDeviceOwnership(const std::string& device_id, 
                                            const std::string& owner_address) {
-    auto it = m_registrations.find(device_id);
-    if (it != m_registrations.end()) {
-        return it->second.owner_address == owner_address;
+    InternedString id;
+    if (!InternedString::Find(device_id, id)) {
+        return false;
+    }
+    const DeviceShard& devices = AcquireSnapshot().devices.Get(ShardOf(id));
+    auto it = devices.find(id);
+    if (it != devices.end()) {
+        return it->second->owner_address == owner_address;
     }
     return false;
 }
 
 std::vector<std::string> DeviceRegistry::GetOwnerDevices(const std::string& owner_address) {
-    std::vector<std::string> devices;
-    for (const auto& [device_id, registration] : m_registrations) {
-        if (registration.owner_address == owner_address) {
-            devices.push_back(device_id);
-        }
+    const OwnerShard& owners = AcquireSnapshot().owners.Get(ShardOf(owner_address));
+    auto it = owners.find(owner_address);
+    if (it != owners.end()) {
+        return std::vector<std::string>(it->second.begin(), it->second.end());
     }
-    return devices;
+    return {};
 }
 
 bool DeviceRegistry::TransferDevice(const std::string& device_id,
                                    const std::string& from_address,
                                    const std::string& to_address) {
-    auto it = m_registrations.find(device_id);
-    if (it != m_registrations.end() && it->second.owner_address == from_address) {
-        it->second.owner_address = to_address;
-        return true;
+    InternedString id;
+    if (!InternedString::Find(device_id, id)) {
+        return false;
     }
-    return false;
+    std::lock_guard<std::mutex> lock(m_write_mutex);
+    Transaction transaction(*std::atomic_load(&m_snapshot));
+    if (!transaction.Transfer(id, from_address, to_address)) {
+        return false;
+    }
+    
+    uint64_t sequence = transaction.Advance();
+    Publish(transaction.Finish());
+    if (m_journal) {
+        m_journal->AppendTransfer(device_id, from_address, to_address, sequence);
+    }
+    return true;
+}
+
+void DeviceRegistry::RecordDeviceActivity(const std::string& device_id, uint32_t height,
+                                          double hashrate) {
+    InternedString id;
+    if (!InternedString::Find(device_id, id) || !AcquireSnapshot().devices.Get(ShardOf(id)).count(id)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_activity_mutex);
+    m_activity.Record(id, height, hashrate);
 }
 
 uint32_t DeviceRegistry::GetTotalRegisteredDevices() const {
-    return m_registrations.size();
+    return AcquireSnapshot().device_count;
+}
+
+uint32_t DeviceRegistry::GetActiveDevices(uint32_t last_n_blocks) const {
+    std::lock_guard<std::mutex> lock(m_activity_mutex);
+    return m_activity.ActiveDevices(last_n_blocks);
+}
+
+double DeviceRegistry::GetNetworkHashrateDistribution() const {
+    std::lock_guard<std::mutex> lock(m_activity_mutex);
+    return m_activity.HashrateDistribution();
+}
+
+void DeviceRegistry::SetJournal(RegistryJournal* journal) {
+    std::lock_guard<std::mutex> lock(m_write_mutex);
+    m_journal = journal;
+}
+
+uint64_t DeviceRegistry::CopyRegistrations(std::vector<DeviceRegistration>& out) const {
+    // A private reference, so the copy is consistent however long it takes
+    std::shared_ptr<const Snapshot> snapshot = std::atomic_load(&m_snapshot);
+    out.reserve(out.size() + snapshot->device_count);
+    for (size_t shard = 0; shard < SHARD_COUNT; ++shard) {
+        for (const auto& [device_id, registration] : snapshot->devices.Get(shard)) {
+            out.push_back(*registration);
+        }
+    }
+    return snapshot->sequence;
+}
+
+void DeviceRegistry::Restore(std::vector<DeviceRegistration> registrations, uint64_t sequence) {
+    std::lock_guard<std::mutex> lock(m_write_mutex);
+    Transaction transaction(*EmptySnapshot());
+    for (auto& registration : registrations) {
+        transaction.Register(std::move(registration));
+    }
+    transaction.SetSequence(sequence);
+    Publish(transaction.Finish());
+}
+
+size_t DeviceRegistry::ReplayRegistrations(const std::vector<DeviceRegistration>& registrations,
+                                           uint64_t first_sequence) {
+    std::lock_guard<std::mutex> lock(m_write_mutex);
+    std::shared_ptr<const Snapshot> base = std::atomic_load(&m_snapshot);
+    Transaction transaction(*base);
+    uint64_t current = base->sequence;
+    
+    size_t applied = 0;
+    for (size_t i = 0; i < registrations.size(); ++i) {
+        uint64_t sequence = first_sequence + i;
+        if (sequence <= current) {
+            continue;
+        }
+        applied += transaction.Register(registrations[i]);
+        transaction.SetSequence(sequence);
+    }
+    if (applied > 0) {
+        Publish(transaction.Finish());
+    }
+    return applied;
+}
+
+uint64_t DeviceRegistry::GetSequence() const {
+    return AcquireSnapshot().sequence;
 }
 
 } // namespace PoDD
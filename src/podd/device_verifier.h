@@ -8,11 +8,50 @@
 #include <map>
 #include <chrono>
 #include <string>
+#include <string_view>
 #include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "activity_window.h"
+#include "device_store.h"
+#include "ring_buffer.h"
+#include "share_statistics.h"
+#include "string_interner.h"
 
 namespace PoDD {
 
+class RegistryJournal;
+class WorkStealingPool;
+
+/**
+ * Weights and decay scales used by DeviceFingerprint::CalculateSimilarity.
+ * The similarity index derives its pruning radii from the same constants.
+ */
+namespace Similarity {
+    constexpr double TIMING_WEIGHT = 0.4;        // Timing (most important)
+    constexpr double TIMING_SCALE_US = 10000.0;
+    constexpr double VARIANCE_WEIGHT = 0.2;
+    constexpr double VARIANCE_SCALE_US = 5000.0;
+    constexpr double SAME_IP_BONUS = 0.15;       // Same IP is suspicious but not conclusive
+    constexpr double LATENCY_WEIGHT = 0.05;
+    constexpr double LATENCY_SCALE_MS = 50.0;
+    constexpr double SAME_FIRMWARE_BONUS = 0.05; // Same firmware is common
+    constexpr double SAME_CHIP_COUNT_BONUS = 0.05;
+    constexpr double POWER_WEIGHT = 0.1;
+    constexpr double POWER_SCALE_W = 10.0;
+    
+    /** Network and hardware categories each carry 20% of the score */
+    constexpr double CATEGORY_WEIGHT = 0.2;
+    
+    /** Default score above which two devices are considered the same hardware */
+    constexpr double SUSPICIOUS_THRESHOLD = 0.9;
+}
+
 /**
  * Device fingerprint containing unique hardware characteristics
  */
@@ -20,17 +59,17 @@ struct DeviceFingerprint {
     // Timing characteristics
     uint64_t avg_nonce_time_us;        // Average time to find nonce (microseconds)
     uint64_t timing_variance_us;       // Variance in timing
-    std::array<uint64_t, 10> timing_samples; // Recent timing samples
+    RingBuffer<uint64_t, 10> timing_samples; // Recent timing samples
     
     // Network characteristics  
-    std::string ip_address;
+    InternedString ip_address;
     uint32_t avg_latency_ms;
     uint32_t latency_variance_ms;
     std::vector<uint32_t> traceroute_hops;
     
     // Hardware characteristics
-    std::string device_id;              // Unique device identifier
-    std::string firmware_version;
+    InternedString device_id;           // Unique device identifier
+    InternedString firmware_version;
     uint32_t memory_size_mb;
     uint32_t chip_count;                // Number of mining chips
     double power_consumption_watts;
@@ -39,7 +78,7 @@ struct DeviceFingerprint {
     // Nonce pattern characteristics
     uint64_t nonce_search_space;        // How device searches nonce space
     uint32_t nonce_increment_pattern;   // Pattern in nonce increments
-    std::vector<uint64_t> recent_nonces; // Recent nonces found
+    LazyRingBuffer<uint64_t, 100> recent_nonces; // Recent nonces found
     
     // Behavioral characteristics
     std::chrono::steady_clock::time_point last_seen;
@@ -59,23 +98,167 @@ struct DeviceFingerprint {
     std::string GetFingerprintHash() const;
 };
 
+/**
+ * Timing entropy over the union of a device set's sample windows, kept up to
+ * date by its members' shares
+ */
+struct SetTimingEntropy {
+    std::mutex mutex;
+    TimingEntropyTracker tracker;
+    bool low_entropy = false;           // Result of the check at the last share
+};
+
+/**
+ * Member list of a squad, stored inline.
+ *
+ * Squads are capped at Consensus::Params::nMaxSquadSize devices, so the IDs
+ * live in a fixed array of interned handles: membership tests are a scan of
+ * at most ten integers and nothing is ever allocated. Members keep the order
+ * they joined in.
+ */
+class SquadMembers {
+public:
+    static constexpr size_t CAPACITY = 10;   // Consensus::Params::nMaxSquadSize
+    static constexpr size_t NPOS = CAPACITY;
+
+    /** @return False if the squad is full or the device is already a member */
+    bool Add(InternedString id) {
+        if (m_size == CAPACITY || Contains(id)) return false;
+        m_ids[m_size++] = id;
+        return true;
+    }
+
+    /** @return False if the device is not a member */
+    bool Remove(InternedString id) {
+        size_t i = IndexOf(id);
+        if (i == NPOS) return false;
+        for (; i + 1 < m_size; ++i) {
+            m_ids[i] = m_ids[i + 1];
+        }
+        m_ids[--m_size] = InternedString();
+        return true;
+    }
+
+    /** Position of a member in join order, or NPOS */
+    size_t IndexOf(InternedString id) const {
+        for (size_t i = 0; i < m_size; ++i) {
+            if (m_ids[i] == id) return i;
+        }
+        return NPOS;
+    }
+
+    bool Contains(InternedString id) const { return IndexOf(id) != NPOS; }
+
+    size_t Size() const { return m_size; }
+    bool Empty() const { return m_size == 0; }
+    bool Full() const { return m_size == CAPACITY; }
+
+    InternedString operator[](size_t i) const { return m_ids[i]; }
+    const InternedString* begin() const { return m_ids.data(); }
+    const InternedString* end() const { return m_ids.data() + m_size; }
+
+private:
+    std::array<InternedString, CAPACITY> m_ids{};
+    uint8_t m_size = 0;
+};
+
+/**
+ * Difficulty-weighted work each member of a squad has submitted since the
+ * squad was last paid, one counter per member slot.
+ *
+ * Members add to their own counter from the share path without taking any
+ * lock. A payout swaps each counter to zero, so every share is counted in
+ * exactly one round. Each squad's counters fill a cache line of their own,
+ * so squads mining in parallel never contend.
+ */
+struct alignas(64) SquadShareAccount {
+    std::array<std::atomic<uint64_t>, SquadMembers::CAPACITY> work{};
+};
+
+/**
+ * A device's counter in one squad's SquadShareAccount
+ */
+struct SquadShareSlot {
+    std::shared_ptr<SquadShareAccount> account;
+    uint8_t slot = 0;
+};
+
 /**
  * Mining squad - group of small miners working together
  */
 struct MiningSquad {
     std::string squad_id;
-    std::vector<std::string> member_devices;
+    SquadMembers member_devices;
+    std::shared_ptr<SetTimingEntropy> timing_entropy;
+    std::shared_ptr<SquadShareAccount> shares;  // Indexed like member_devices
     std::chrono::steady_clock::time_point created_at;
     uint64_t total_hashrate;
     uint64_t blocks_found;
     
     bool AddDevice(const std::string& device_id);
     bool RemoveDevice(const std::string& device_id);
+    
+    /**
+     * Member's fraction of the work submitted in the current round; an
+     * equal split until any work has been recorded
+     */
     double GetRewardShare(const std::string& device_id) const;
 };
 
+/**
+ * Share data from mining operation
+ */
+struct ShareData {
+    std::string device_id;
+    uint64_t nonce;
+    uint64_t timestamp_us;
+    uint32_t difficulty;
+    std::string block_hash;
+    double hashrate;
+    double temperature;
+    double power_watts;
+    std::string ip_address;
+    uint32_t latency_ms;
+};
+
+/**
+ * Streaming statistics over a device's shares, updated as each share arrives
+ */
+struct ShareStatistics {
+    static constexpr size_t TIMING_WINDOW = 64;
+    static constexpr size_t NONCE_BINS = 8;
+    
+    /** Bin of a nonce: the top three bits of the 32-bit header nonce */
+    static size_t NonceBin(uint64_t nonce) { return (nonce >> 29) & (NONCE_BINS - 1); }
+    
+    SortedWindow<uint64_t, TIMING_WINDOW> nonce_times;   // Recent nonce times, kept sorted
+    MutualInformationHistogram<NONCE_BINS> nonce_pairs;  // (previous, next) nonce bins over recent_nonces
+    TimingEntropyTracker timing_entropy;                 // Over the fingerprint's timing_samples
+    bool low_timing_entropy = false;                     // Result of the check at the last share
+};
+
+/**
+ * Per-device state held by the verifier
+ */
+struct DeviceRecord {
+    DeviceFingerprint fingerprint;
+    // Built from the fingerprint at the device's first share. Most of a
+    // record's size, so devices that have not mined since they were
+    // registered or restored do without.
+    std::unique_ptr<ShareStatistics> statistics;
+    std::vector<std::shared_ptr<SetTimingEntropy>> timing_sets; // Squads fed by this device
+    std::vector<SquadShareSlot> squad_shares; // Squads credited with this device's work
+    std::chrono::steady_clock::time_point registered_at;
+    uint64_t generation = 0;            // Bumped on every fingerprint update
+};
+
 /**
  * Main device verification system for Proof-of-Device-Distribution
+ *
+ * All public methods may be called concurrently; share updates for
+ * different devices only contend when they hash to the same shard.
+ * Records are keyed by interned device ID; looking up an ID that was never
+ * registered does not intern it.
  */
 class DeviceVerifier {
 public:
@@ -120,6 +303,23 @@ public:
      */
     bool DetectSpoofing(const std::vector<std::string>& device_ids);
     
+    /**
+     * Verification cache counters
+     */
+    struct VerificationCacheStats {
+        uint64_t hits;
+        uint64_t misses;
+        size_t entries;
+    };
+    
+    VerificationCacheStats GetVerificationCacheStats() const;
+    
+    /**
+     * Set how long a cached verification result stays usable. Results are
+     * dropped earlier if any member's fingerprint changes.
+     */
+    void SetVerificationCacheTTL(std::chrono::seconds ttl);
+    
     /**
      * Calculate reward multiplier based on device verification status
      * @param device_id Device requesting reward
@@ -134,11 +334,135 @@ public:
      */
     std::string FormMiningSquad(const std::vector<std::string>& device_ids);
     
+    /**
+     * Find the squads a device mines in through the device index;
+     * O(squads of the device)
+     * @return Squad IDs in ID order, empty if the device is in no squad
+     */
+    std::vector<std::string> GetDeviceSquads(const std::string& device_id) const;
+    
+    /**
+     * Number of members of a squad
+     * @return 0 if the squad does not exist
+     */
+    size_t GetSquadSize(const std::string& squad_id) const;
+    
+    /**
+     * Difficulty-weighted work of each member in the current round, in
+     * join order
+     * @return False if the squad does not exist
+     */
+    bool GetSquadWork(const std::string& squad_id,
+                      std::vector<std::pair<std::string, uint64_t>>& work) const;
+    
+    /**
+     * Like GetSquadWork, but also closes the round: the counters are reset
+     * as they are read, and shares arriving meanwhile count towards the
+     * next round. Call once per block the squad is paid for.
+     */
+    bool TakeSquadWork(const std::string& squad_id,
+                       std::vector<std::pair<std::string, uint64_t>>& work);
+    
     /**
      * Get device's current hashrate estimate
      */
     double GetDeviceHashrate(const std::string& device_id) const;
     
+    /**
+     * Number of independently locked registry shards
+     */
+    static constexpr size_t GetShardCount() {
+        return ShardedDeviceStore<DeviceRecord>::SHARD_COUNT;
+    }
+    
+    /**
+     * Copy every fingerprint in one registry shard; only that shard is
+     * locked, and only for the duration of the copy
+     * @param shard Shard index below GetShardCount()
+     * @param out Receives (device_id, fingerprint) pairs
+     */
+    void SnapshotShard(size_t shard,
+                       std::vector<std::pair<std::string, DeviceFingerprint>>& out) const;
+    
+    /**
+     * Get the member devices of every squad, keyed by squad ID
+     */
+    std::vector<std::pair<std::string, std::vector<std::string>>> GetSquads() const;
+    
+    /**
+     * Get the number of registered devices
+     */
+    size_t GetDeviceCount() const;
+    
+    /**
+     * Per-device findings from the streaming share statistics
+     */
+    struct DeviceStatistics {
+        size_t timing_samples;          // Nonce times in the KS window
+        double timing_ks_distance;      // KS distance to an exponential fit
+        bool timing_consistent;         // Nonce times look like a Poisson process
+        uint64_t nonce_pairs;           // Consecutive nonce pairs in the MI window
+        double nonce_entropy;           // Bits, at most log2(NONCE_BINS)
+        double nonce_mutual_information; // Bits shared by consecutive nonces
+        bool nonce_artificial;
+        double timing_entropy;          // Bits, over the fingerprint's timing samples
+        bool low_timing_entropy;
+        bool network_consistent;
+        bool hardware_consistent;
+    };
+    
+    /**
+     * Query a device's share statistics; O(window + bins), no allocation
+     * @return False if the device is not registered
+     */
+    bool GetDeviceStatistics(const std::string& device_id, DeviceStatistics& stats) const;
+    
+    /**
+     * Get a squad's timing entropy over all its members' samples, as
+     * maintained share by share
+     * @return False if the squad does not exist
+     */
+    bool GetSquadTimingEntropy(const std::string& squad_id, double& entropy, bool& low_entropy) const;
+    
+    /**
+     * Persistence hooks, used by RegistryStore
+     */
+    
+    /** Record every registration and share in a journal (null to stop) */
+    void SetJournal(RegistryJournal* journal);
+    
+    /** Visit every record of one shard under its shared lock */
+    void VisitShard(size_t shard,
+                    const std::function<void(std::string_view, const DeviceRecord&)>& fn) const;
+    
+    /** Size the registry for about count devices ahead of a bulk restore */
+    void ReserveDevices(size_t count);
+    
+    /**
+     * Recreate a persisted device: init fills in the fingerprint, times and
+     * generation. Share statistics are rebuilt from the restored timing
+     * window once the device mines again.
+     * @return False if the device is already registered
+     */
+    bool RestoreDevice(InternedString device_id, const std::function<void(DeviceRecord&)>& init);
+    
+    /**
+     * Recreate a batch of persisted devices; init(i, record) fills in the
+     * record of device_ids[i] as for RestoreDevice(). Much faster than one
+     * call per device when loading a whole registry.
+     * @return Devices restored; those already registered are skipped
+     */
+    size_t RestoreDevices(const InternedString* device_ids, size_t count,
+                          const std::function<void(size_t, DeviceRecord&)>& init);
+    
+    /**
+     * Re-apply a journaled share. Shares the device has already seen (its
+     * generation is not below the journaled one) are skipped.
+     * @return True if the share was applied
+     */
+    bool ReplayShare(const std::string& device_id, const ShareData& share_data,
+                     std::chrono::steady_clock::time_point seen_at, uint64_t generation);
+    
     /**
      * Timing analysis to detect hardware variations
      */
@@ -171,46 +495,60 @@ private:
     struct Impl;
     std::unique_ptr<Impl> pImpl;
     
-    // Device registry
-    std::map<std::string, DeviceFingerprint> m_devices;
-    std::map<std::string, std::chrono::steady_clock::time_point> m_registration_times;
+    // Device registry (safe to update from many stratum threads at once)
+    ShardedDeviceStore<DeviceRecord> m_devices;
+    std::atomic<RegistryJournal*> m_journal{nullptr};
+    
+    // Apply one share to a record whose shard the caller holds exclusively
+    void ApplyShare(DeviceRecord& record, const ShareData& share_data,
+                    std::chrono::steady_clock::time_point seen_at);
     
-    // Squad registry
+    // Squad registry. A device may mine in several squads; m_device_squads
+    // maps each member to each of its squads' nodes in m_squads, which never
+    // move.
+    mutable std::mutex m_squads_mutex;
     std::map<std::string, MiningSquad> m_squads;
+    std::unordered_multimap<InternedString, const MiningSquad*> m_device_squads;
+    
+    bool CollectSquadWork(const std::string& squad_id,
+                          std::vector<std::pair<std::string, uint64_t>>& work, bool take) const;
     
-    // Verification cache
+    // Verification cache, keyed by the device list in the caller's order;
+    // an entry is only valid while every member still has the generation it
+    // was computed from
     struct VerificationCache {
         std::chrono::steady_clock::time_point timestamp;
+        std::vector<uint64_t> generations;
         VerificationResult result;
     };
+    mutable std::mutex m_cache_mutex;
     std::map<std::string, VerificationCache> m_verification_cache;
+    std::chrono::steady_clock::duration m_cache_ttl;
+    mutable std::atomic<uint64_t> m_cache_hits{0};
+    mutable std::atomic<uint64_t> m_cache_misses{0};
     
-    // Anti-spoofing detection
-    bool CheckTimingConsistency(const DeviceFingerprint& fp);
-    bool CheckNetworkConsistency(const DeviceFingerprint& fp);
-    bool CheckHardwareConsistency(const DeviceFingerprint& fp);
+    bool LookupVerificationCache(const std::string& key,
+                                 const std::vector<uint64_t>& generations,
+                                 VerificationResult& result) const;
+    void StoreVerificationCache(const std::string& key,
+                                const std::vector<uint64_t>& generations,
+                                const VerificationResult& result);
+    
+    // Run every verification check on a device set; fingerprints[i] holds
+    // the analyzed fields of ids[i], copied out of the store
+    VerificationResult AnalyzeDeviceSet(const std::vector<InternedString>& ids,
+                                        const std::vector<const DeviceFingerprint*>& fingerprints);
+    
+    // Anti-spoofing detection (on a record whose shard the caller holds)
+    bool CheckTimingConsistency(const ShareStatistics& statistics) const;
+    bool CheckNetworkConsistency(const DeviceRecord& record) const;
+    bool CheckHardwareConsistency(const DeviceRecord& record) const;
     
     // Statistical analysis
     double CalculateKolmogorovSmirnovStatistic(const std::vector<double>& sample1,
-                                               const std::vector<double>& sample2);
+                                               const std::vector<double>& sample2) const;
     double CalculateMutualInformation(const std::vector<uint64_t>& data1,
-                                     const std::vector<uint64_t>& data2);
-};
-
-/**
- * Share data from mining operation
- */
-struct ShareData {
-    std::string device_id;
-    uint64_t nonce;
-    uint64_t timestamp_us;
-    uint32_t difficulty;
-    std::string block_hash;
-    double hashrate;
-    double temperature;
-    double power_watts;
-    std::string ip_address;
-    uint32_t latency_ms;
+                                     const std::vector<uint64_t>& data2) const;
 };
 
 /**
@@ -226,31 +564,162 @@ struct DeviceRegistration {
     double max_hashrate_ghs;
     std::chrono::system_clock::time_point manufacture_date;
     std::string owner_address; // SYNC address of owner
+    std::vector<uint8_t> owner_pubkey; // Owner's secp256k1 key, SEC1 encoded (33 or 65 bytes)
     std::vector<uint8_t> signature; // Cryptographic proof of ownership
+    
+    /**
+     * Bytes the owner signs: a domain tag, then every field above in
+     * declaration order, little-endian, strings length-prefixed
+     */
+    std::string GetSigningMessage() const;
+    
+    /**
+     * Check that signature is a DER-encoded ECDSA signature by owner_pubkey
+     * over SHA256(GetSigningMessage()). Tying the key to owner_address is
+     * not checked here.
+     */
+    bool VerifySignature() const;
 };
 
 /**
  * Global device registry interface
+ *
+ * Safe to use from any thread. Reads work on an immutable snapshot of the
+ * registry and never wait for a writer: each writer copies the snapshot's
+ * root and just the shards it changes, then publishes the result with one
+ * atomic store. Writers are serialized among themselves. A reader sees a
+ * change either completely or not at all.
  */
 class DeviceRegistry {
 public:
     static DeviceRegistry& GetInstance();
     
+    /** Register a device if its signature verifies and it is not registered yet */
     bool RegisterDevice(const DeviceRegistration& registration);
+    
+    struct BatchRegistrationResult {
+        bool committed;
+        size_t failed_index;    // First rejected registration, if not committed
+        std::string reason;
+    };
+    
+    /**
+     * Register a batch all-or-nothing. Signatures are verified in parallel
+     * on pool (on the calling thread without one), then the whole batch is
+     * published in one snapshot. Nothing is registered if any signature
+     * fails, or if any device is already registered or listed twice.
+     */
+    BatchRegistrationResult RegisterDevices(const std::vector<DeviceRegistration>& registrations,
+                                            WorkStealingPool* pool = nullptr);
+    
     bool VerifyDeviceOwnership(const std::string& device_id, const std::string& owner_address);
+    
+    /** Devices registered to an owner, in no particular order; O(owner's devices) */
     std::vector<std::string> GetOwnerDevices(const std::string& owner_address);
     bool TransferDevice(const std::string& device_id, 
                        const std::string& from_address,
                        const std::string& to_address);
     
+    /**
+     * Record that a registered device mined at a height; unregistered
+     * devices are ignored. Activity is kept for ActivityWindow::WINDOW
+     * blocks below the highest height reported.
+     * @param hashrate Device's current hashrate, in any consistent unit
+     */
+    void RecordDeviceActivity(const std::string& device_id, uint32_t height, double hashrate);
+    
     // Statistics
     uint32_t GetTotalRegisteredDevices() const;
+    
+    /** Registered devices active in the last n blocks; O(n) */
     uint32_t GetActiveDevices(uint32_t last_n_blocks) const;
+    
+    /**
+     * How evenly hashrate is spread over the recently active devices, from
+     * 0 (one device) towards 1; O(1). See ActivityWindow.
+     */
     double GetNetworkHashrateDistribution() const;
     
+    // Persistence hooks, used by RegistryStore. Every successful change
+    // advances a change sequence that is journaled with it.
+    void SetJournal(RegistryJournal* journal);
+    
+    /**
+     * Copy all registrations
+     * @return Change sequence the copy is current to
+     */
+    uint64_t CopyRegistrations(std::vector<DeviceRegistration>& out) const;
+    
+    /** Replace all registrations with persisted ones */
+    void Restore(std::vector<DeviceRegistration> registrations, uint64_t sequence);
+    
+    /**
+     * Re-apply journaled registrations, numbered from first_sequence, without
+     * verifying them again; those the registry already includes are skipped
+     * @return Registrations applied
+     */
+    size_t ReplayRegistrations(const std::vector<DeviceRegistration>& registrations,
+                               uint64_t first_sequence);
+    
+    uint64_t GetSequence() const;
+    
 private:
-    DeviceRegistry() = default;
-    std::map<std::string, DeviceRegistration> m_registrations;
+    DeviceRegistry();
+    
+    // Shards sit in groups so that a writer copies only the groups it
+    // touches, not a table of every shard
+    static constexpr size_t GROUP_COUNT = 64;
+    static constexpr size_t SHARDS_PER_GROUP = 64;
+    static constexpr size_t SHARD_COUNT = GROUP_COUNT * SHARDS_PER_GROUP;
+    
+    using RegistrationPtr = std::shared_ptr<const DeviceRegistration>;
+    using DeviceShard = std::unordered_map<InternedString, RegistrationPtr>;
+    using OwnerShard = std::unordered_map<std::string, std::vector<InternedString>>;
+    
+    template <typename Shard>
+    struct ShardTable {
+        using Group = std::array<std::shared_ptr<const Shard>, SHARDS_PER_GROUP>;
+        std::array<std::shared_ptr<const Group>, GROUP_COUNT> groups;
+        
+        const Shard& Get(size_t shard) const {
+            return *(*groups[shard / SHARDS_PER_GROUP])[shard % SHARDS_PER_GROUP];
+        }
+    };
+    
+    /** One immutable version of the registry */
+    struct Snapshot {
+        ShardTable<DeviceShard> devices;    // By interned device ID
+        ShardTable<OwnerShard> owners;      // By owner address
+        size_t device_count = 0;
+        uint64_t sequence = 0;              // Change sequence this version is current to
+    };
+    
+    class Transaction;
+    
+    static size_t ShardOf(const std::string& key);
+    static size_t ShardOf(InternedString key);
+    static std::shared_ptr<const Snapshot> EmptySnapshot();
+    
+    /**
+     * Current snapshot. It stays valid until the calling thread acquires
+     * again.
+     */
+    const Snapshot& AcquireSnapshot() const;
+    void Publish(std::shared_ptr<const Snapshot> snapshot);
+    
+    /** Commit registrations that have been verified */
+    BatchRegistrationResult Commit(const DeviceRegistration* registrations, size_t count);
+    
+    std::shared_ptr<const Snapshot> m_snapshot;     // Only via std::atomic_load/atomic_store
+    std::atomic<uint64_t> m_version{0};             // Bumped after each publish
+    
+    std::mutex m_write_mutex;           // Serializes writers; readers never take it
+    RegistryJournal* m_journal = nullptr;
+    
+    // Block activity changes every block, so it is kept apart from the
+    // copy-on-write snapshots
+    mutable std::mutex m_activity_mutex;
+    ActivityWindow m_activity;
 };
 
 } // namespace PoDD
@@ -0,0 +1,204 @@
+// Copyright (c) 2024 SyntheticCoin Developers
+// Distributed under the MIT software license
+
+#include "fingerprint_matrix.h"
+#include <cmath>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SYNC_PODD_HAVE_AVX2_KERNEL 1
+#include <immintrin.h>
+#endif
+
+namespace PoDD {
+
+namespace {
+
+constexpr double WEIGHT_SUM = Similarity::TIMING_WEIGHT + Similarity::VARIANCE_WEIGHT +
+                              Similarity::CATEGORY_WEIGHT + Similarity::CATEGORY_WEIGHT;
+
+#ifdef SYNC_PODD_HAVE_AVX2_KERNEL
+
+/**
+ * exp(x) for four doubles with x <= 0.
+ * x = n*ln2 + r with |r| <= ln2/2, exp(r) from a degree-13 Taylor polynomial
+ * (truncation error below 1e-17), then scaled by 2^n through the exponent
+ * bits. Inputs below -708 flush to zero, which is what std::exp underflows
+ * to as far as the similarity score is concerned.
+ */
+__attribute__((target("avx2,fma")))
+__m256d Exp4(__m256d x) {
+    const __m256d min_x = _mm256_set1_pd(-708.0);
+    const __m256d underflow = _mm256_cmp_pd(x, min_x, _CMP_LT_OQ);
+    x = _mm256_max_pd(x, min_x);
+
+    const __m256d n = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(1.4426950408889634)),
+                                      _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256d r = _mm256_fnmadd_pd(n, _mm256_set1_pd(6.93145751953125e-1), x);
+    r = _mm256_fnmadd_pd(n, _mm256_set1_pd(1.42860682030941723212e-6), r);
+
+    static const double COEFFS[] = {
+        1.0 / 6227020800.0, 1.0 / 479001600.0, 1.0 / 39916800.0, 1.0 / 3628800.0,
+        1.0 / 362880.0, 1.0 / 40320.0, 1.0 / 5040.0, 1.0 / 720.0,
+        1.0 / 120.0, 1.0 / 24.0, 1.0 / 6.0, 0.5, 1.0, 1.0,
+    };
+    __m256d p = _mm256_set1_pd(COEFFS[0]);
+    for (size_t i = 1; i < sizeof(COEFFS) / sizeof(COEFFS[0]); ++i) {
+        p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(COEFFS[i]));
+    }
+
+    // 2^n: place n + 1023 in the exponent field
+    __m128i n32 = _mm256_cvtpd_epi32(n);
+    __m256i bits = _mm256_slli_epi64(
+        _mm256_add_epi64(_mm256_cvtepi32_epi64(n32), _mm256_set1_epi64x(1023)), 52);
+    __m256d result = _mm256_mul_pd(p, _mm256_castsi256_pd(bits));
+
+    return _mm256_andnot_pd(underflow, result);
+}
+
+__attribute__((target("avx2,fma")))
+__m256d AbsDiff4(__m256d a, __m256d b) {
+    const __m256d sign_mask = _mm256_set1_pd(-0.0);
+    return _mm256_andnot_pd(sign_mask, _mm256_sub_pd(a, b));
+}
+
+/** Bonus where the 32-bit IDs match, 0.0 elsewhere */
+__attribute__((target("avx2,fma")))
+__m256d MatchBonus4(uint32_t query_id, const uint32_t* ids, double bonus) {
+    __m128i candidates = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ids));
+    __m128i eq32 = _mm_cmpeq_epi32(candidates, _mm_set1_epi32(static_cast<int>(query_id)));
+    __m256d eq64 = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(eq32));
+    return _mm256_and_pd(eq64, _mm256_set1_pd(bonus));
+}
+
+#endif // SYNC_PODD_HAVE_AVX2_KERNEL
+
+} // namespace
+
+void FingerprintMatrix::Reserve(size_t rows) {
+    m_timing.reserve(rows);
+    m_variance.reserve(rows);
+    m_latency.reserve(rows);
+    m_power.reserve(rows);
+    m_ip_id.reserve(rows);
+    m_firmware_id.reserve(rows);
+    m_chip_count.reserve(rows);
+}
+
+void FingerprintMatrix::Clear() {
+    m_timing.clear();
+    m_variance.clear();
+    m_latency.clear();
+    m_power.clear();
+    m_ip_id.clear();
+    m_firmware_id.clear();
+    m_chip_count.clear();
+}
+
+size_t FingerprintMatrix::Add(const DeviceFingerprint& fp) {
+    m_timing.push_back(static_cast<double>(fp.avg_nonce_time_us));
+    m_variance.push_back(static_cast<double>(fp.timing_variance_us));
+    m_latency.push_back(static_cast<double>(fp.avg_latency_ms));
+    m_power.push_back(fp.power_consumption_watts);
+    m_ip_id.push_back(fp.ip_address.GetHandle());
+    m_firmware_id.push_back(fp.firmware_version.GetHandle());
+    m_chip_count.push_back(fp.chip_count);
+    return m_timing.size() - 1;
+}
+
+bool FingerprintMatrix::HasVectorKernel() {
+#ifdef SYNC_PODD_HAVE_AVX2_KERNEL
+    static const bool supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+void FingerprintMatrix::ScoreOneVsManyScalar(size_t query, size_t begin, size_t end,
+                                             double* out) const {
+    using namespace Similarity;
+
+    const double timing = m_timing[query];
+    const double variance = m_variance[query];
+    const double latency = m_latency[query];
+    const double power = m_power[query];
+    const uint32_t ip = m_ip_id[query];
+    const uint32_t firmware = m_firmware_id[query];
+    const uint32_t chips = m_chip_count[query];
+
+    // Same terms, in the same order, as DeviceFingerprint::CalculateSimilarity
+    for (size_t k = begin; k < end; ++k) {
+        double similarity = 0.0;
+        similarity += std::exp(-std::abs(timing - m_timing[k]) / TIMING_SCALE_US) * TIMING_WEIGHT;
+        similarity += std::exp(-std::abs(variance - m_variance[k]) / VARIANCE_SCALE_US) * VARIANCE_WEIGHT;
+        if (ip == m_ip_id[k]) similarity += SAME_IP_BONUS;
+        similarity += std::exp(-std::abs(latency - m_latency[k]) / LATENCY_SCALE_MS) * LATENCY_WEIGHT;
+        if (firmware == m_firmware_id[k]) similarity += SAME_FIRMWARE_BONUS;
+        if (chips == m_chip_count[k]) similarity += SAME_CHIP_COUNT_BONUS;
+        similarity += std::exp(-std::abs(power - m_power[k]) / POWER_SCALE_W) * POWER_WEIGHT;
+        out[k - begin] = similarity / WEIGHT_SUM;
+    }
+}
+
+#ifdef SYNC_PODD_HAVE_AVX2_KERNEL
+__attribute__((target("avx2,fma")))
+static size_t ScoreBlockAVX2(const double* timing, const double* variance,
+                             const double* latency, const double* power,
+                             const uint32_t* ip_id, const uint32_t* firmware_id,
+                             const uint32_t* chip_count, size_t count,
+                             double q_timing, double q_variance, double q_latency, double q_power,
+                             uint32_t q_ip, uint32_t q_firmware, uint32_t q_chips,
+                             double* out) {
+    using namespace Similarity;
+
+    const __m256d qt = _mm256_set1_pd(q_timing);
+    const __m256d qv = _mm256_set1_pd(q_variance);
+    const __m256d ql = _mm256_set1_pd(q_latency);
+    const __m256d qp = _mm256_set1_pd(q_power);
+    const __m256d inv_timing = _mm256_set1_pd(-1.0 / TIMING_SCALE_US);
+    const __m256d inv_variance = _mm256_set1_pd(-1.0 / VARIANCE_SCALE_US);
+    const __m256d inv_latency = _mm256_set1_pd(-1.0 / LATENCY_SCALE_MS);
+    const __m256d inv_power = _mm256_set1_pd(-1.0 / POWER_SCALE_W);
+    const __m256d inv_weight_sum = _mm256_set1_pd(1.0 / WEIGHT_SUM);
+
+    size_t k = 0;
+    for (; k + 4 <= count; k += 4) {
+        __m256d t = Exp4(_mm256_mul_pd(AbsDiff4(qt, _mm256_loadu_pd(timing + k)), inv_timing));
+        __m256d v = Exp4(_mm256_mul_pd(AbsDiff4(qv, _mm256_loadu_pd(variance + k)), inv_variance));
+        __m256d l = Exp4(_mm256_mul_pd(AbsDiff4(ql, _mm256_loadu_pd(latency + k)), inv_latency));
+        __m256d p = Exp4(_mm256_mul_pd(AbsDiff4(qp, _mm256_loadu_pd(power + k)), inv_power));
+
+        __m256d s = _mm256_mul_pd(t, _mm256_set1_pd(TIMING_WEIGHT));
+        s = _mm256_fmadd_pd(v, _mm256_set1_pd(VARIANCE_WEIGHT), s);
+        s = _mm256_add_pd(s, MatchBonus4(q_ip, ip_id + k, SAME_IP_BONUS));
+        s = _mm256_fmadd_pd(l, _mm256_set1_pd(LATENCY_WEIGHT), s);
+        s = _mm256_add_pd(s, MatchBonus4(q_firmware, firmware_id + k, SAME_FIRMWARE_BONUS));
+        s = _mm256_add_pd(s, MatchBonus4(q_chips, chip_count + k, SAME_CHIP_COUNT_BONUS));
+        s = _mm256_fmadd_pd(p, _mm256_set1_pd(POWER_WEIGHT), s);
+
+        _mm256_storeu_pd(out + k, _mm256_mul_pd(s, inv_weight_sum));
+    }
+    return k;
+}
+#endif
+
+void FingerprintMatrix::ScoreOneVsMany(size_t query, size_t begin, size_t end, double* out) const {
+#ifdef SYNC_PODD_HAVE_AVX2_KERNEL
+    if (HasVectorKernel() && end > begin) {
+        size_t done = ScoreBlockAVX2(
+            m_timing.data() + begin, m_variance.data() + begin,
+            m_latency.data() + begin, m_power.data() + begin,
+            m_ip_id.data() + begin, m_firmware_id.data() + begin,
+            m_chip_count.data() + begin, end - begin,
+            m_timing[query], m_variance[query], m_latency[query], m_power[query],
+            m_ip_id[query], m_firmware_id[query], m_chip_count[query],
+            out);
+        begin += done;
+        out += done;
+    }
+#endif
+    // Tail (or whole block without AVX2)
+    ScoreOneVsManyScalar(query, begin, end, out);
+}
+
+} // namespace PoDD
@@ -0,0 +1,74 @@
+// Copyright (c) 2024 SyntheticCoin Developers
+// Distributed under the MIT software license
+
+#ifndef SYNC_PODD_FINGERPRINT_MATRIX_H
+#define SYNC_PODD_FINGERPRINT_MATRIX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "device_verifier.h"
+
+namespace PoDD {
+
+/**
+ * Structure-of-arrays copy of the fingerprint fields that feed
+ * DeviceFingerprint::CalculateSimilarity.
+ *
+ * IP addresses and firmware versions are kept as their interned handles, so
+ * a row is a handful of contiguous doubles and integers and one device can be scored
+ * against a block of candidates with a vectorized kernel. On CPUs with AVX2
+ * and FMA the kernel scores four candidates per iteration using a polynomial
+ * exp() accurate to a few ULP; elsewhere a scalar loop computes exactly what
+ * CalculateSimilarity does.
+ */
+class FingerprintMatrix {
+public:
+    /** Largest difference between kernel and CalculateSimilarity scores */
+    static constexpr double MAX_KERNEL_ERROR = 1e-12;
+
+    void Reserve(size_t rows);
+
+    /**
+     * Drop all rows but keep the array capacity, so a reused matrix stops
+     * allocating once it has seen its working set
+     */
+    void Clear();
+
+    /**
+     * Append a fingerprint
+     * @return Row index of the new entry
+     */
+    size_t Add(const DeviceFingerprint& fp);
+
+    size_t Size() const { return m_timing.size(); }
+
+    /**
+     * Score one row against a contiguous block of rows
+     * @param query Row to compare
+     * @param begin First candidate row
+     * @param end One past the last candidate row
+     * @param out Receives end - begin similarity scores
+     */
+    void ScoreOneVsMany(size_t query, size_t begin, size_t end, double* out) const;
+
+    /** Same as ScoreOneVsMany but never uses the vector kernel */
+    void ScoreOneVsManyScalar(size_t query, size_t begin, size_t end, double* out) const;
+
+    /** Whether the running CPU supports the AVX2 kernel */
+    static bool HasVectorKernel();
+
+private:
+    std::vector<double> m_timing;
+    std::vector<double> m_variance;
+    std::vector<double> m_latency;
+    std::vector<double> m_power;
+    std::vector<uint32_t> m_ip_id;
+    std::vector<uint32_t> m_firmware_id;
+    std::vector<uint32_t> m_chip_count;
+};
+
+} // namespace PoDD
+
+#endif // SYNC_PODD_FINGERPRINT_MATRIX_H
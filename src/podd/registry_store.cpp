@@ -0,0 +1,1111 @@
+// Copyright (c) 2024 SyntheticCoin Developers
+// Distributed under the MIT software license
+
+#include "registry_store.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SYNC_PODD_HAVE_SSE42_CRC 1
+#include <immintrin.h>
+#endif
+
+namespace PoDD {
+
+namespace {
+
+// Journal buffer size that triggers a write
+constexpr size_t JOURNAL_BUFFER_BYTES = 1 << 20;
+
+// Snapshot devices restored per batch
+constexpr uint64_t RESTORE_BATCH = 1 << 16;
+
+constexpr char SNAPSHOT_MAGIC[8] = {'S', 'Y', 'N', 'C', 'P', 'O', 'D', 'D'};
+constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+/**
+ * CRC32C (Castagnoli), chainable: Crc32c(b, n2, Crc32c(a, n1)) is the CRC of
+ * a followed by b. Uses the SSE4.2 instruction where the CPU has it.
+ */
+uint32_t Crc32cSoftware(uint32_t state, const uint8_t* data, size_t length) {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> values{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ (0x82F63B78 & (0 - (crc & 1)));
+            }
+            values[i] = crc;
+        }
+        return values;
+    }();
+    for (size_t i = 0; i < length; ++i) {
+        state = table[(state ^ data[i]) & 0xFF] ^ (state >> 8);
+    }
+    return state;
+}
+
+#ifdef SYNC_PODD_HAVE_SSE42_CRC
+__attribute__((target("sse4.2")))
+uint32_t Crc32cHardware(uint32_t state, const uint8_t* data, size_t length) {
+    uint64_t crc = state;
+    for (; length >= 8; data += 8, length -= 8) {
+        uint64_t word;
+        std::memcpy(&word, data, sizeof(word));
+        crc = _mm_crc32_u64(crc, word);
+    }
+    state = static_cast<uint32_t>(crc);
+    for (; length > 0; ++data, --length) {
+        state = _mm_crc32_u8(state, *data);
+    }
+    return state;
+}
+#endif
+
+uint32_t Crc32c(const void* data, size_t length, uint32_t crc = 0) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint32_t state = ~crc;
+#ifdef SYNC_PODD_HAVE_SSE42_CRC
+    static const bool hardware = __builtin_cpu_supports("sse4.2");
+    if (hardware) {
+        return ~Crc32cHardware(state, bytes, length);
+    }
+#endif
+    return ~Crc32cSoftware(state, bytes, length);
+}
+
+// On-disk layout. Native byte order and alignment; the header's byte-order
+// mark rejects files from a machine that differs.
+
+struct StringRef {
+    uint32_t offset;
+    uint32_t length;
+};
+
+struct DiskDevice {
+    uint64_t generation;
+    int64_t registered_at_us;
+    int64_t last_seen_us;
+    uint64_t avg_nonce_time_us;
+    uint64_t timing_variance_us;
+    uint64_t nonce_search_space;
+    double power_consumption_watts;
+    double temperature_celsius;
+    double average_hashrate;
+    StringRef device_id;
+    StringRef ip_address;
+    StringRef firmware_version;
+    StringRef traceroute_hops;          // Raw uint32_t array
+    uint32_t avg_latency_ms;
+    uint32_t latency_variance_ms;
+    uint32_t memory_size_mb;
+    uint32_t chip_count;
+    uint32_t nonce_increment_pattern;
+    uint32_t uptime_seconds;
+    uint32_t restart_count;
+    uint32_t timing_sample_count;
+    uint64_t timing_samples[decltype(DeviceFingerprint::timing_samples)::Capacity()];
+};
+static_assert(sizeof(DiskDevice) == 216, "DiskDevice layout changed; bump FORMAT_VERSION");
+static_assert(std::is_trivially_copyable<DiskDevice>::value, "DiskDevice must be raw bytes");
+
+struct DiskRegistration {
+    StringRef device_id;
+    StringRef manufacturer;
+    StringRef model;
+    StringRef serial_number;
+    StringRef firmware_version;
+    StringRef owner_address;
+    StringRef owner_pubkey;
+    StringRef signature;
+    uint32_t chip_count;
+    double max_hashrate_ghs;
+    int64_t manufacture_date_us;
+};
+static_assert(sizeof(DiskRegistration) == 88, "DiskRegistration layout changed; bump FORMAT_VERSION");
+static_assert(std::is_trivially_copyable<DiskRegistration>::value, "DiskRegistration must be raw bytes");
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t header_size;
+    uint32_t reserved;
+    uint64_t journal_sequence;          // First journal to replay on top
+    uint64_t registry_sequence;         // DeviceRegistry change sequence of the copy
+    int64_t created_at_us;
+    uint64_t device_count;
+    uint64_t devices_offset;
+    uint64_t registration_count;
+    uint64_t registrations_offset;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+    uint32_t body_crc;                  // Everything after the header
+    uint32_t header_crc;                // This header with header_crc = 0
+};
+static_assert(sizeof(SnapshotHeader) == 104, "SnapshotHeader layout changed; bump FORMAT_VERSION");
+
+enum JournalEntryType : uint8_t {
+    JOURNAL_DEVICE_REGISTERED = 1,
+    JOURNAL_SHARE = 2,
+    // 3 held a single registration in format version 1
+    JOURNAL_TRANSFER = 4,
+    JOURNAL_REGISTRATIONS = 5,
+};
+
+// Journal frame: payload length and CRC32C, then the payload
+struct JournalFrame {
+    uint32_t length;
+    uint32_t crc;
+};
+
+/**
+ * Converts between steady_clock, which is only meaningful within one
+ * process, and Unix-epoch microseconds
+ */
+class ClockMapping {
+public:
+    ClockMapping()
+        : m_system(std::chrono::system_clock::now()),
+          m_steady(std::chrono::steady_clock::now()) {}
+
+    int64_t ToUnix(std::chrono::steady_clock::time_point t) const {
+        auto system = m_system + std::chrono::duration_cast<std::chrono::system_clock::duration>(t - m_steady);
+        return ToUnix(system);
+    }
+
+    static int64_t ToUnix(std::chrono::system_clock::time_point t) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(t.time_since_epoch()).count();
+    }
+
+    std::chrono::steady_clock::time_point ToSteady(int64_t unix_us) const {
+        auto system = FromUnix(unix_us);
+        return m_steady + std::chrono::duration_cast<std::chrono::steady_clock::duration>(system - m_system);
+    }
+
+    static std::chrono::system_clock::time_point FromUnix(int64_t unix_us) {
+        return std::chrono::system_clock::time_point(
+            std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::microseconds(unix_us)));
+    }
+
+private:
+    std::chrono::system_clock::time_point m_system;
+    std::chrono::steady_clock::time_point m_steady;
+};
+
+/** Appends strings to a string table, handing back references */
+class StringTable {
+public:
+    explicit StringTable(std::string& data) : m_data(data) {}
+
+    StringRef Add(const void* bytes, size_t length) {
+        StringRef ref{static_cast<uint32_t>(m_data.size()), static_cast<uint32_t>(length)};
+        m_data.append(static_cast<const char*>(bytes), length);
+        return ref;
+    }
+    StringRef Add(std::string_view s) { return Add(s.data(), s.size()); }
+
+    /** String tables are addressed with 32-bit offsets */
+    bool Overflowed() const { return m_data.size() > UINT32_MAX; }
+
+private:
+    std::string& m_data;
+};
+
+/** Bounds-checked view of a string table */
+class StringView {
+public:
+    StringView(const char* data, size_t size) : m_data(data), m_size(size) {}
+
+    bool Valid(StringRef ref) const {
+        return static_cast<uint64_t>(ref.offset) + ref.length <= m_size;
+    }
+    std::string Get(StringRef ref) const { return std::string(m_data + ref.offset, ref.length); }
+    std::string_view View(StringRef ref) const { return std::string_view(m_data + ref.offset, ref.length); }
+
+private:
+    const char* m_data;
+    size_t m_size;
+};
+
+DiskDevice EncodeDevice(std::string_view device_id, const DeviceRecord& record,
+                        const ClockMapping& clock, StringTable& strings) {
+    const DeviceFingerprint& fp = record.fingerprint;
+
+    DiskDevice disk;
+    std::memset(&disk, 0, sizeof(disk));
+    disk.generation = record.generation;
+    disk.registered_at_us = clock.ToUnix(record.registered_at);
+    disk.last_seen_us = clock.ToUnix(fp.last_seen);
+    disk.avg_nonce_time_us = fp.avg_nonce_time_us;
+    disk.timing_variance_us = fp.timing_variance_us;
+    disk.nonce_search_space = fp.nonce_search_space;
+    disk.power_consumption_watts = fp.power_consumption_watts;
+    disk.temperature_celsius = fp.temperature_celsius;
+    disk.average_hashrate = fp.average_hashrate;
+    disk.device_id = strings.Add(device_id);
+    disk.ip_address = strings.Add(fp.ip_address.View());
+    disk.firmware_version = strings.Add(fp.firmware_version.View());
+    disk.traceroute_hops = strings.Add(fp.traceroute_hops.data(),
+                                       fp.traceroute_hops.size() * sizeof(uint32_t));
+    disk.avg_latency_ms = fp.avg_latency_ms;
+    disk.latency_variance_ms = fp.latency_variance_ms;
+    disk.memory_size_mb = fp.memory_size_mb;
+    disk.chip_count = fp.chip_count;
+    disk.nonce_increment_pattern = fp.nonce_increment_pattern;
+    disk.uptime_seconds = fp.uptime_seconds;
+    disk.restart_count = fp.restart_count;
+    disk.timing_sample_count = static_cast<uint32_t>(fp.timing_samples.Size());
+    for (size_t i = 0; i < fp.timing_samples.Size(); ++i) {
+        disk.timing_samples[i] = fp.timing_samples[i];
+    }
+    return disk;
+}
+
+bool ValidDevice(const DiskDevice& disk, const StringView& strings) {
+    return strings.Valid(disk.device_id) && strings.Valid(disk.ip_address) &&
+           strings.Valid(disk.firmware_version) && strings.Valid(disk.traceroute_hops) &&
+           disk.traceroute_hops.length % sizeof(uint32_t) == 0 &&
+           disk.timing_sample_count <= decltype(DeviceFingerprint::timing_samples)::Capacity();
+}
+
+/** Fill a record from a validated DiskDevice and its strings, interned */
+void DecodeDevice(const DiskDevice& disk, InternedString device_id, InternedString ip_address,
+                  InternedString firmware_version, const char* string_data,
+                  const ClockMapping& clock, DeviceRecord& record) {
+    DeviceFingerprint& fp = record.fingerprint;
+
+    record.generation = disk.generation;
+    record.registered_at = clock.ToSteady(disk.registered_at_us);
+    fp.last_seen = clock.ToSteady(disk.last_seen_us);
+    fp.avg_nonce_time_us = disk.avg_nonce_time_us;
+    fp.timing_variance_us = disk.timing_variance_us;
+    fp.nonce_search_space = disk.nonce_search_space;
+    fp.power_consumption_watts = disk.power_consumption_watts;
+    fp.temperature_celsius = disk.temperature_celsius;
+    fp.average_hashrate = disk.average_hashrate;
+    fp.device_id = device_id;
+    fp.ip_address = ip_address;
+    fp.firmware_version = firmware_version;
+    fp.traceroute_hops.resize(disk.traceroute_hops.length / sizeof(uint32_t));
+    if (!fp.traceroute_hops.empty()) {
+        std::memcpy(fp.traceroute_hops.data(), string_data + disk.traceroute_hops.offset,
+                    disk.traceroute_hops.length);
+    }
+    fp.avg_latency_ms = disk.avg_latency_ms;
+    fp.latency_variance_ms = disk.latency_variance_ms;
+    fp.memory_size_mb = disk.memory_size_mb;
+    fp.chip_count = disk.chip_count;
+    fp.nonce_increment_pattern = disk.nonce_increment_pattern;
+    fp.uptime_seconds = disk.uptime_seconds;
+    fp.restart_count = disk.restart_count;
+    for (uint32_t i = 0; i < disk.timing_sample_count; ++i) {
+        fp.timing_samples.Push(disk.timing_samples[i]);
+    }
+}
+
+DiskRegistration EncodeRegistration(const DeviceRegistration& registration, StringTable& strings) {
+    DiskRegistration disk;
+    std::memset(&disk, 0, sizeof(disk));
+    disk.device_id = strings.Add(registration.device_id);
+    disk.manufacturer = strings.Add(registration.manufacturer);
+    disk.model = strings.Add(registration.model);
+    disk.serial_number = strings.Add(registration.serial_number);
+    disk.firmware_version = strings.Add(registration.firmware_version);
+    disk.owner_address = strings.Add(registration.owner_address);
+    disk.owner_pubkey = strings.Add(registration.owner_pubkey.data(), registration.owner_pubkey.size());
+    disk.signature = strings.Add(registration.signature.data(), registration.signature.size());
+    disk.chip_count = registration.chip_count;
+    disk.max_hashrate_ghs = registration.max_hashrate_ghs;
+    disk.manufacture_date_us = ClockMapping::ToUnix(registration.manufacture_date);
+    return disk;
+}
+
+bool DecodeRegistration(const DiskRegistration& disk, const StringView& strings,
+                        DeviceRegistration& registration) {
+    for (StringRef ref : {disk.device_id, disk.manufacturer, disk.model, disk.serial_number,
+                          disk.firmware_version, disk.owner_address, disk.owner_pubkey,
+                          disk.signature}) {
+        if (!strings.Valid(ref)) return false;
+    }
+    registration.device_id = strings.Get(disk.device_id);
+    registration.manufacturer = strings.Get(disk.manufacturer);
+    registration.model = strings.Get(disk.model);
+    registration.serial_number = strings.Get(disk.serial_number);
+    registration.firmware_version = strings.Get(disk.firmware_version);
+    registration.owner_address = strings.Get(disk.owner_address);
+    std::string owner_pubkey = strings.Get(disk.owner_pubkey);
+    registration.owner_pubkey.assign(owner_pubkey.begin(), owner_pubkey.end());
+    std::string signature = strings.Get(disk.signature);
+    registration.signature.assign(signature.begin(), signature.end());
+    registration.chip_count = disk.chip_count;
+    registration.max_hashrate_ghs = disk.max_hashrate_ghs;
+    registration.manufacture_date = ClockMapping::FromUnix(disk.manufacture_date_us);
+    return true;
+}
+
+// Journal payload encoding
+
+template <typename T>
+void Put(std::string& out, const T& value) {
+    static_assert(std::is_trivially_copyable<T>::value, "Only raw values");
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void PutString(std::string& out, const std::string& s) {
+    Put(out, static_cast<uint32_t>(s.size()));
+    out.append(s);
+}
+
+/** Bounds-checked reader over one journal payload */
+class PayloadReader {
+public:
+    PayloadReader(const char* data, size_t size) : m_data(data), m_size(size) {}
+
+    template <typename T>
+    bool Get(T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "Only raw values");
+        if (m_size - m_pos < sizeof(T)) return false;
+        std::memcpy(&value, m_data + m_pos, sizeof(T));
+        m_pos += sizeof(T);
+        return true;
+    }
+
+    bool GetString(std::string& s) {
+        uint32_t length;
+        if (!Get(length) || m_size - m_pos < length) return false;
+        s.assign(m_data + m_pos, length);
+        m_pos += length;
+        return true;
+    }
+
+    /** Remaining bytes, consumed */
+    StringView Rest(const char*& data) {
+        data = m_data + m_pos;
+        StringView view(data, m_size - m_pos);
+        m_pos = m_size;
+        return view;
+    }
+
+private:
+    const char* m_data;
+    size_t m_size;
+    size_t m_pos = 0;
+};
+
+/** Read-only memory map of a whole file */
+class MappedFile {
+public:
+    ~MappedFile() {
+        if (m_data) munmap(const_cast<char*>(m_data), m_size);
+    }
+
+    /** @return False with errno set; an empty file maps to size 0 */
+    bool Open(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            int saved = errno;
+            ::close(fd);
+            errno = saved;
+            return false;
+        }
+        m_size = static_cast<size_t>(st.st_size);
+        if (m_size > 0) {
+            void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) {
+                int saved = errno;
+                ::close(fd);
+                errno = saved;
+                return false;
+            }
+            madvise(data, m_size, MADV_SEQUENTIAL | MADV_WILLNEED);
+            m_data = static_cast<const char*>(data);
+        }
+        ::close(fd);
+        return true;
+    }
+
+    const char* Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+
+private:
+    const char* m_data = nullptr;
+    size_t m_size = 0;
+};
+
+/** Buffered sequential writer that keeps a running CRC32C */
+class FileWriter {
+public:
+    explicit FileWriter(int fd) : m_fd(fd) {}
+
+    bool Write(const void* data, size_t length) {
+        m_crc = Crc32c(data, length, m_crc);
+        m_written += length;
+        m_buffer.append(static_cast<const char*>(data), length);
+        return m_buffer.size() < JOURNAL_BUFFER_BYTES || Drain();
+    }
+
+    bool Drain() {
+        const char* p = m_buffer.data();
+        size_t left = m_buffer.size();
+        while (left > 0) {
+            ssize_t n = ::write(m_fd, p, left);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            p += n;
+            left -= static_cast<size_t>(n);
+        }
+        m_buffer.clear();
+        return true;
+    }
+
+    uint32_t Crc() const { return m_crc; }
+    uint64_t Written() const { return m_written; }
+
+private:
+    int m_fd;
+    std::string m_buffer;
+    uint32_t m_crc = 0;
+    uint64_t m_written = 0;
+};
+
+bool WriteAll(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t n = ::write(fd, data, length);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        length -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+std::string ErrnoMessage(const std::string& what, const std::string& path) {
+    return what + " " + path + ": " + std::strerror(errno);
+}
+
+bool SyncDirectory(const std::string& directory) {
+    int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return false;
+    bool ok = fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
+
+std::chrono::microseconds Since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+}
+
+} // namespace
+
+// RegistryJournal implementation
+RegistryJournal::~RegistryJournal() {
+    Close();
+}
+
+bool RegistryJournal::Open(const std::string& path, std::string& error) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        error = ErrnoMessage("Cannot open journal", path);
+        return false;
+    }
+
+    struct stat st;
+    m_size = fstat(fd, &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+    m_fd = fd;
+    m_failed = false;
+    m_buffer.reserve(JOURNAL_BUFFER_BYTES);
+    return true;
+}
+
+bool RegistryJournal::Rotate(const std::string& path, std::string& error) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        error = ErrnoMessage("Cannot open journal", path);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    bool ok = WriteBuffer() && (m_fd < 0 || fdatasync(m_fd) == 0);
+    if (!ok) {
+        error = std::string("Cannot write journal: ") + std::strerror(errno);
+        ::close(fd);
+        return false;
+    }
+    if (m_fd >= 0) ::close(m_fd);
+    m_fd = fd;
+    m_size = 0;
+    return true;
+}
+
+void RegistryJournal::Close() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_fd < 0) return;
+    WriteBuffer();
+    fdatasync(m_fd);
+    ::close(m_fd);
+    m_fd = -1;
+}
+
+bool RegistryJournal::WriteBuffer() {
+    if (m_buffer.empty() || m_fd < 0) return !m_failed;
+
+    // Drop only what reached the file. After an error the rest stays
+    // buffered, and the next attempt resumes at the same byte, so a frame
+    // cut short by a full disk is completed rather than left torn.
+    size_t written = 0;
+    bool ok = true;
+    while (written < m_buffer.size()) {
+        ssize_t n = ::write(m_fd, m_buffer.data() + written, m_buffer.size() - written);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            ok = false;
+            break;
+        }
+        written += static_cast<size_t>(n);
+    }
+    m_buffer.erase(0, written);
+    return ok && !m_failed;
+}
+
+void RegistryJournal::Append(const std::string& payload) {
+    JournalFrame frame{static_cast<uint32_t>(payload.size()), Crc32c(payload.data(), payload.size())};
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_buffer.append(reinterpret_cast<const char*>(&frame), sizeof(frame));
+    m_buffer.append(payload);
+    m_size += sizeof(frame) + payload.size();
+    if (m_buffer.size() >= JOURNAL_BUFFER_BYTES) {
+        WriteBuffer();
+    }
+}
+
+void RegistryJournal::AppendDeviceRegistered(const std::string& device_id, const DeviceRecord& record) {
+    thread_local std::string payload;
+    thread_local std::string strings;
+    payload.clear();
+    strings.clear();
+
+    StringTable table(strings);
+    DiskDevice disk = EncodeDevice(device_id, record, ClockMapping(), table);
+    Put(payload, JOURNAL_DEVICE_REGISTERED);
+    Put(payload, disk);
+    payload.append(strings);
+    Append(payload);
+}
+
+void RegistryJournal::AppendShare(const std::string& device_id, uint64_t generation,
+                                  const ShareData& share_data,
+                                  std::chrono::steady_clock::time_point seen_at) {
+    // One clock mapping per thread; the offset between the clocks only
+    // moves when the system clock is stepped
+    thread_local ClockMapping clock;
+    thread_local std::string payload;
+    payload.clear();
+
+    Put(payload, JOURNAL_SHARE);
+    Put(payload, generation);
+    Put(payload, clock.ToUnix(seen_at));
+    Put(payload, share_data.nonce);
+    Put(payload, share_data.timestamp_us);
+    Put(payload, share_data.latency_ms);
+    Put(payload, share_data.temperature);
+    Put(payload, share_data.power_watts);
+    Put(payload, share_data.hashrate);
+    PutString(payload, device_id);
+    PutString(payload, share_data.ip_address);
+    Append(payload);
+}
+
+void RegistryJournal::AppendRegistrations(const DeviceRegistration* registrations, size_t count,
+                                          uint64_t first_sequence) {
+    // One entry for the whole batch, so a torn write cannot keep only part
+    // of it
+    std::string payload;
+    std::string strings;
+    StringTable table(strings);
+    Put(payload, JOURNAL_REGISTRATIONS);
+    Put(payload, first_sequence);
+    Put(payload, static_cast<uint32_t>(count));
+    for (size_t i = 0; i < count; ++i) {
+        Put(payload, EncodeRegistration(registrations[i], table));
+    }
+    payload.append(strings);
+    Append(payload);
+}
+
+void RegistryJournal::AppendTransfer(const std::string& device_id, const std::string& from_address,
+                                     const std::string& to_address, uint64_t sequence) {
+    std::string payload;
+    Put(payload, JOURNAL_TRANSFER);
+    Put(payload, sequence);
+    PutString(payload, device_id);
+    PutString(payload, from_address);
+    PutString(payload, to_address);
+    Append(payload);
+}
+
+bool RegistryJournal::Flush(bool sync) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!WriteBuffer()) return false;
+    // A failed fsync may have dropped written pages, so unlike a failed
+    // write it cannot be retried
+    if (sync && m_fd >= 0 && fdatasync(m_fd) != 0) {
+        m_failed = true;
+    }
+    return !m_failed;
+}
+
+uint64_t RegistryJournal::GetSize() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_size;
+}
+
+// RegistryStore implementation
+RegistryStore::RegistryStore(std::string directory)
+    : m_directory(std::move(directory)) {}
+
+RegistryStore::~RegistryStore() {
+    Detach();
+}
+
+std::string RegistryStore::SnapshotPath() const {
+    return m_directory + "/registry.dat";
+}
+
+std::string RegistryStore::JournalPath(uint64_t sequence) const {
+    return m_directory + "/journal-" + std::to_string(sequence) + ".log";
+}
+
+std::vector<uint64_t> RegistryStore::ListJournals() const {
+    std::vector<uint64_t> sequences;
+    DIR* dir = opendir(m_directory.c_str());
+    if (!dir) return sequences;
+
+    while (struct dirent* entry = readdir(dir)) {
+        const char* name = entry->d_name;
+        unsigned long long sequence;
+        int consumed = 0;
+        if (std::sscanf(name, "journal-%llu.log%n", &sequence, &consumed) == 1 &&
+            name[consumed] == '\0') {
+            sequences.push_back(sequence);
+        }
+    }
+    closedir(dir);
+
+    std::sort(sequences.begin(), sequences.end());
+    return sequences;
+}
+
+bool RegistryStore::Load(DeviceVerifier& verifier, DeviceRegistry& registry,
+                         RegistryLoadStats& stats, std::string& error) {
+    std::lock_guard<std::mutex> lock(m_checkpoint_mutex);
+
+    uint64_t journal_sequence = 0;
+    auto start = std::chrono::steady_clock::now();
+    if (!LoadSnapshot(verifier, registry, stats, journal_sequence, error)) {
+        return false;
+    }
+    stats.snapshot_time = Since(start);
+
+    // Journals older than the snapshot are covered by it (left behind if
+    // the process died between writing the snapshot and deleting them)
+    start = std::chrono::steady_clock::now();
+    m_journal_sequence = journal_sequence;
+    for (uint64_t sequence : ListJournals()) {
+        if (sequence < journal_sequence) continue;
+        if (!ReplayJournal(JournalPath(sequence), verifier, registry, stats, error)) {
+            return false;
+        }
+        ++stats.journals_replayed;
+        m_journal_sequence = sequence;
+    }
+    stats.journal_time = Since(start);
+    return true;
+}
+
+bool RegistryStore::LoadSnapshot(DeviceVerifier& verifier, DeviceRegistry& registry,
+                                 RegistryLoadStats& stats, uint64_t& journal_sequence,
+                                 std::string& error) {
+    const std::string path = SnapshotPath();
+    MappedFile file;
+    if (!file.Open(path)) {
+        if (errno == ENOENT) return true; // First run
+        error = ErrnoMessage("Cannot read", path);
+        return false;
+    }
+    stats.snapshot_found = true;
+
+    SnapshotHeader header;
+    if (file.Size() < sizeof(header)) {
+        error = path + ": truncated header";
+        return false;
+    }
+    std::memcpy(&header, file.Data(), sizeof(header));
+
+    uint32_t header_crc = header.header_crc;
+    header.header_crc = 0;
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 ||
+        header.byte_order != BYTE_ORDER_MARK || header.header_size != sizeof(header) ||
+        Crc32c(&header, sizeof(header)) != header_crc) {
+        error = path + ": not a registry snapshot for this platform";
+        return false;
+    }
+    if (header.version != FORMAT_VERSION) {
+        error = path + ": unsupported format version " + std::to_string(header.version);
+        return false;
+    }
+
+    // Every section must lie inside the file
+    const uint64_t size = file.Size();
+    auto section_ok = [&](uint64_t offset, uint64_t count, uint64_t width) {
+        return offset >= sizeof(header) && offset <= size && count <= (size - offset) / width;
+    };
+    if (!section_ok(header.devices_offset, header.device_count, sizeof(DiskDevice)) ||
+        !section_ok(header.registrations_offset, header.registration_count, sizeof(DiskRegistration)) ||
+        !section_ok(header.strings_offset, header.strings_size, 1) ||
+        header.devices_offset % alignof(DiskDevice) != 0 ||
+        header.registrations_offset % alignof(DiskRegistration) != 0) {
+        error = path + ": section out of bounds";
+        return false;
+    }
+    if (Crc32c(file.Data() + sizeof(header), size - sizeof(header)) != header.body_crc) {
+        error = path + ": checksum mismatch";
+        return false;
+    }
+
+    const char* string_data = file.Data() + header.strings_offset;
+    StringView strings(string_data, header.strings_size);
+    ClockMapping clock;
+
+    // The map is page aligned and the offsets are checked above, so the
+    // records are decoded in place
+    const DiskDevice* devices = reinterpret_cast<const DiskDevice*>(file.Data() + header.devices_offset);
+    verifier.ReserveDevices(header.device_count);
+    // Each device brings its own ID and usually its own IP address
+    StringInterner::Global().Reserve(2 * header.device_count);
+    // Devices are restored a batch at a time: a batch's strings are interned
+    // together and its records inserted shard by shard, so each table fills
+    // while it is in cache instead of being hit at random
+    std::vector<std::string_view> views;
+    std::vector<InternedString> interned;
+    for (uint64_t first = 0; first < header.device_count; first += RESTORE_BATCH) {
+        const size_t count = static_cast<size_t>(std::min(RESTORE_BATCH, header.device_count - first));
+        const DiskDevice* batch = devices + first;
+        views.resize(3 * count);
+        interned.resize(3 * count);
+        for (size_t i = 0; i < count; ++i) {
+            if (!ValidDevice(batch[i], strings)) {
+                error = path + ": bad device record " + std::to_string(first + i);
+                return false;
+            }
+            views[i] = strings.View(batch[i].device_id);
+            views[count + i] = strings.View(batch[i].ip_address);
+            views[2 * count + i] = strings.View(batch[i].firmware_version);
+        }
+        InternedString::InternMany(views.data(), views.size(), interned.data());
+        stats.devices_restored += verifier.RestoreDevices(
+            interned.data(), count, [&](size_t i, DeviceRecord& record) {
+                DecodeDevice(batch[i], interned[i], interned[count + i], interned[2 * count + i],
+                             string_data, clock, record);
+            });
+    }
+
+    const DiskRegistration* registrations =
+        reinterpret_cast<const DiskRegistration*>(file.Data() + header.registrations_offset);
+    std::vector<DeviceRegistration> restored(header.registration_count);
+    for (uint64_t i = 0; i < header.registration_count; ++i) {
+        if (!DecodeRegistration(registrations[i], strings, restored[i])) {
+            error = path + ": bad registration record " + std::to_string(i);
+            return false;
+        }
+    }
+    stats.registrations_restored = restored.size();
+    registry.Restore(std::move(restored), header.registry_sequence);
+
+    journal_sequence = header.journal_sequence;
+    return true;
+}
+
+bool RegistryStore::ReplayJournal(const std::string& path, DeviceVerifier& verifier,
+                                  DeviceRegistry& registry, RegistryLoadStats& stats,
+                                  std::string& error) {
+    MappedFile file;
+    if (!file.Open(path)) {
+        error = ErrnoMessage("Cannot read", path);
+        return false;
+    }
+
+    ClockMapping clock;
+    const char* data = file.Data();
+    size_t pos = 0;
+    while (pos < file.Size()) {
+        JournalFrame frame;
+        if (file.Size() - pos < sizeof(frame)) break;
+        std::memcpy(&frame, data + pos, sizeof(frame));
+        if (file.Size() - pos - sizeof(frame) < frame.length) break;
+
+        const char* payload = data + pos + sizeof(frame);
+        if (Crc32c(payload, frame.length) != frame.crc) break;
+        pos += sizeof(frame) + frame.length;
+        ++stats.journal_entries;
+
+        PayloadReader reader(payload, frame.length);
+        uint8_t type = 0;
+        reader.Get(type);
+        bool ok = true;
+        bool applied = false;
+
+        if (type == JOURNAL_DEVICE_REGISTERED) {
+            DiskDevice disk;
+            ok = reader.Get(disk);
+            const char* string_data = nullptr;
+            StringView strings = reader.Rest(string_data);
+            ok = ok && ValidDevice(disk, strings);
+            if (ok) {
+                InternedString device_id = InternedString::Intern(strings.View(disk.device_id));
+                applied = verifier.RestoreDevice(device_id, [&](DeviceRecord& record) {
+                    DecodeDevice(disk, device_id, InternedString::Intern(strings.View(disk.ip_address)),
+                                 InternedString::Intern(strings.View(disk.firmware_version)), string_data,
+                                 clock, record);
+                });
+            }
+        } else if (type == JOURNAL_SHARE) {
+            uint64_t generation;
+            int64_t seen_us;
+            std::string device_id;
+            ShareData share{};
+            ok = reader.Get(generation) && reader.Get(seen_us) && reader.Get(share.nonce) &&
+                 reader.Get(share.timestamp_us) && reader.Get(share.latency_ms) &&
+                 reader.Get(share.temperature) && reader.Get(share.power_watts) &&
+                 reader.Get(share.hashrate) && reader.GetString(device_id) &&
+                 reader.GetString(share.ip_address);
+            if (ok) {
+                share.device_id = device_id;
+                applied = verifier.ReplayShare(device_id, share, clock.ToSteady(seen_us), generation);
+            }
+        } else if (type == JOURNAL_REGISTRATIONS) {
+            uint64_t first_sequence;
+            uint32_t count = 0;
+            ok = reader.Get(first_sequence) && reader.Get(count) &&
+                 count <= frame.length / sizeof(DiskRegistration);
+            std::vector<DiskRegistration> disks(ok ? count : 0);
+            for (DiskRegistration& disk : disks) {
+                ok = ok && reader.Get(disk);
+            }
+            const char* string_data = nullptr;
+            StringView strings = reader.Rest(string_data);
+            std::vector<DeviceRegistration> registrations(disks.size());
+            for (size_t i = 0; ok && i < disks.size(); ++i) {
+                ok = DecodeRegistration(disks[i], strings, registrations[i]);
+            }
+            if (ok) {
+                applied = registry.ReplayRegistrations(registrations, first_sequence) > 0;
+            }
+        } else if (type == JOURNAL_TRANSFER) {
+            uint64_t sequence;
+            std::string device_id, from_address, to_address;
+            ok = reader.Get(sequence) && reader.GetString(device_id) &&
+                 reader.GetString(from_address) && reader.GetString(to_address);
+            if (ok && sequence > registry.GetSequence()) {
+                applied = registry.TransferDevice(device_id, from_address, to_address);
+            }
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            // The CRC matched, so this is not a torn write
+            error = path + ": malformed entry at offset " + std::to_string(pos);
+            return false;
+        }
+        if (applied) {
+            ++stats.journal_entries_applied;
+        }
+    }
+
+    if (pos < file.Size()) {
+        stats.journal_truncated = true;
+    }
+    return true;
+}
+
+bool RegistryStore::Attach(DeviceVerifier& verifier, DeviceRegistry& registry, std::string& error) {
+    std::lock_guard<std::mutex> lock(m_checkpoint_mutex);
+    if (m_journal) {
+        error = "Registry store already attached";
+        return false;
+    }
+    if (::mkdir(m_directory.c_str(), 0700) != 0 && errno != EEXIST) {
+        error = ErrnoMessage("Cannot create", m_directory);
+        return false;
+    }
+
+    // Always start a fresh journal, so appends never follow a torn tail
+    auto journal = std::make_unique<RegistryJournal>();
+    if (!journal->Open(JournalPath(m_journal_sequence + 1), error)) {
+        return false;
+    }
+    ++m_journal_sequence;
+
+    m_journal = std::move(journal);
+    m_verifier = &verifier;
+    m_registry = &registry;
+    verifier.SetJournal(m_journal.get());
+    registry.SetJournal(m_journal.get());
+    return true;
+}
+
+void RegistryStore::Detach() {
+    std::lock_guard<std::mutex> lock(m_checkpoint_mutex);
+    if (!m_journal) return;
+
+    m_verifier->SetJournal(nullptr);
+    m_registry->SetJournal(nullptr);
+    m_journal->Close();
+    m_journal.reset();
+    m_verifier = nullptr;
+    m_registry = nullptr;
+}
+
+bool RegistryStore::Checkpoint(std::string& error, RegistryCheckpointStats* stats) {
+    std::lock_guard<std::mutex> lock(m_checkpoint_mutex);
+    if (!m_journal) {
+        error = "Registry store not attached";
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    // Changes from here on go to the new journal; everything already in the
+    // old ones is visible to the copy below
+    const uint64_t sequence = m_journal_sequence + 1;
+    if (!m_journal->Rotate(JournalPath(sequence), error)) {
+        return false;
+    }
+    m_journal_sequence = sequence;
+
+    RegistryCheckpointStats written;
+    const std::string tmp_path = SnapshotPath() + ".tmp";
+    if (!WriteSnapshot(tmp_path, sequence, written, error)) {
+        ::unlink(tmp_path.c_str());
+        return false;
+    }
+    if (::rename(tmp_path.c_str(), SnapshotPath().c_str()) != 0) {
+        error = ErrnoMessage("Cannot replace", SnapshotPath());
+        ::unlink(tmp_path.c_str());
+        return false;
+    }
+    SyncDirectory(m_directory);
+
+    // The snapshot now covers every older journal
+    for (uint64_t old : ListJournals()) {
+        if (old < sequence) {
+            ::unlink(JournalPath(old).c_str());
+        }
+    }
+
+    written.time = Since(start);
+    if (stats) *stats = written;
+    return true;
+}
+
+bool RegistryStore::WriteSnapshot(const std::string& path, uint64_t journal_sequence,
+                                  RegistryCheckpointStats& stats, std::string& error) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        error = ErrnoMessage("Cannot create", path);
+        return false;
+    }
+
+    SnapshotHeader header;
+    std::memset(&header, 0, sizeof(header));
+    bool ok = WriteAll(fd, reinterpret_cast<const char*>(&header), sizeof(header));
+
+    FileWriter writer(fd);
+    std::string string_data;
+    StringTable strings(string_data);
+    ClockMapping clock;
+
+    // Devices, one shard at a time; each shard is share-locked only while
+    // its records are encoded
+    header.devices_offset = sizeof(header);
+    for (size_t shard = 0; ok && shard < DeviceVerifier::GetShardCount(); ++shard) {
+        m_verifier->VisitShard(shard, [&](std::string_view device_id, const DeviceRecord& record) {
+            DiskDevice disk = EncodeDevice(device_id, record, clock, strings);
+            ok = ok && writer.Write(&disk, sizeof(disk));
+            ++header.device_count;
+        });
+    }
+
+    std::vector<DeviceRegistration> registrations;
+    header.registry_sequence = m_registry->CopyRegistrations(registrations);
+    header.registrations_offset = header.devices_offset + writer.Written();
+    for (const auto& registration : registrations) {
+        DiskRegistration disk = EncodeRegistration(registration, strings);
+        ok = ok && writer.Write(&disk, sizeof(disk));
+    }
+    header.registration_count = registrations.size();
+
+    if (strings.Overflowed()) {
+        ::close(fd);
+        error = path + ": string table exceeds 4 GiB";
+        return false;
+    }
+    header.strings_offset = header.devices_offset + writer.Written();
+    header.strings_size = string_data.size();
+    ok = ok && writer.Write(string_data.data(), string_data.size()) && writer.Drain();
+
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = FORMAT_VERSION;
+    header.byte_order = BYTE_ORDER_MARK;
+    header.header_size = sizeof(header);
+    header.journal_sequence = journal_sequence;
+    header.created_at_us = ClockMapping::ToUnix(std::chrono::system_clock::now());
+    header.body_crc = writer.Crc();
+    header.header_crc = Crc32c(&header, sizeof(header));
+
+    ok = ok && ::pwrite(fd, &header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header));
+    ok = ok && fsync(fd) == 0;
+    if (!ok) {
+        error = ErrnoMessage("Cannot write", path);
+    }
+    ::close(fd);
+
+    stats.devices = header.device_count;
+    stats.registrations = header.registration_count;
+    stats.bytes = sizeof(header) + writer.Written();
+    return ok;
+}
+
+bool RegistryStore::Flush() {
+    std::lock_guard<std::mutex> lock(m_checkpoint_mutex);
+    return !m_journal || m_journal->Flush();
+}
+
+uint64_t RegistryStore::GetJournalSize() const {
+    // m_journal only changes under Attach/Detach, which syncd calls from
+    // the same thread as this
+    return m_journal ? m_journal->GetSize() : 0;
+}
+
+} // namespace PoDD
@@ -0,0 +1,182 @@
+// Copyright (c) 2024 SyntheticCoin Developers
+// Distributed under the MIT software license
+
+#ifndef SYNC_PODD_REGISTRY_STORE_H
+#define SYNC_PODD_REGISTRY_STORE_H
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "device_verifier.h"
+
+namespace PoDD {
+
+/**
+ * Append-only log of registry changes made since the last snapshot.
+ *
+ * Entries are framed as [payload length][CRC32C of payload][payload]. A torn
+ * write at the tail is detected on replay, and everything before it is still
+ * used. Appends are encoded outside the lock and buffered in memory. The
+ * buffer is written out when it fills or when Flush() is called. Flush(true)
+ * and Rotate() also fsync.
+ *
+ * Entries that could not be written, e.g. because the disk is full, stay
+ * buffered and are retried on the next write; nothing is dropped until
+ * Close(). A failed fsync is not retried: the journal stays failed until it
+ * is reopened.
+ */
+class RegistryJournal {
+public:
+    RegistryJournal() = default;
+    ~RegistryJournal();
+
+    RegistryJournal(const RegistryJournal&) = delete;
+    RegistryJournal& operator=(const RegistryJournal&) = delete;
+
+    bool Open(const std::string& path, std::string& error);
+
+    /** Sync and close the current file, then continue in a new one */
+    bool Rotate(const std::string& path, std::string& error);
+
+    void Close();
+
+    void AppendDeviceRegistered(const std::string& device_id, const DeviceRecord& record);
+    void AppendShare(const std::string& device_id, uint64_t generation, const ShareData& share_data,
+                     std::chrono::steady_clock::time_point seen_at);
+    void AppendRegistrations(const DeviceRegistration* registrations, size_t count,
+                             uint64_t first_sequence);
+    void AppendTransfer(const std::string& device_id, const std::string& from_address,
+                        const std::string& to_address, uint64_t sequence);
+
+    /**
+     * Write out buffered entries
+     * @param sync Also fsync the file
+     * @return False if entries are still buffered because a write failed, or
+     *         if an fsync has failed since the journal was opened
+     */
+    bool Flush(bool sync = false);
+
+    /** Bytes in the current file, buffered entries included */
+    uint64_t GetSize() const;
+
+private:
+    void Append(const std::string& payload);
+    bool WriteBuffer();
+
+    mutable std::mutex m_mutex;
+    int m_fd = -1;
+    std::string m_buffer;
+    uint64_t m_size = 0;
+    bool m_failed = false;
+};
+
+/**
+ * What Load() found on disk
+ */
+struct RegistryLoadStats {
+    bool snapshot_found = false;
+    size_t devices_restored = 0;
+    size_t registrations_restored = 0;
+    size_t journals_replayed = 0;
+    size_t journal_entries = 0;         // Entries read from journals
+    size_t journal_entries_applied = 0; // Entries not already covered by the snapshot
+    bool journal_truncated = false;     // A torn entry ended a journal early
+    std::chrono::microseconds snapshot_time{0};
+    std::chrono::microseconds journal_time{0};
+};
+
+/**
+ * What Checkpoint() wrote
+ */
+struct RegistryCheckpointStats {
+    size_t devices = 0;
+    size_t registrations = 0;
+    uint64_t bytes = 0;
+    std::chrono::microseconds time{0};
+};
+
+/**
+ * Binary, versioned persistence for DeviceVerifier and DeviceRegistry.
+ *
+ * The directory holds one snapshot, registry.dat, plus journal-<n>.log
+ * files. The snapshot is written by Checkpoint() and contains:
+ *  - a fixed header (magic, format version, byte-order mark, section offsets
+ *    and counts, CRC32C of the header and of the body);
+ *  - fixed-width device records, then fixed-width registration records,
+ *    whose strings are {offset, length} references;
+ *  - the string table.
+ * Load() maps the snapshot read-only and decodes the records in place, then
+ * replays every journal from the one the snapshot names onwards.
+ *
+ * A checkpoint runs while shares keep flowing. It first rotates the journal,
+ * then copies the registry shard by shard. Journaled shares carry the
+ * device's generation and registry changes carry the registry's change
+ * sequence. On replay, entries the snapshot already includes are skipped,
+ * so nothing is applied twice.
+ *
+ * Times are stored as microseconds since the Unix epoch, so a device keeps
+ * its registration age across restarts. Squads, the verification cache, the
+ * recent nonce window and the share statistics derived from it are not
+ * persisted; they are rebuilt as shares arrive.
+ */
+class RegistryStore {
+public:
+    static constexpr uint32_t FORMAT_VERSION = 2;
+
+    /** Journal size at which syncd writes a new snapshot */
+    static constexpr uint64_t CHECKPOINT_JOURNAL_BYTES = 64ULL << 20;
+
+    explicit RegistryStore(std::string directory);
+    ~RegistryStore();
+
+    RegistryStore(const RegistryStore&) = delete;
+    RegistryStore& operator=(const RegistryStore&) = delete;
+
+    /**
+     * Restore the snapshot and replay the journals into an empty verifier
+     * and registry. A missing directory or snapshot is not an error.
+     */
+    bool Load(DeviceVerifier& verifier, DeviceRegistry& registry,
+              RegistryLoadStats& stats, std::string& error);
+
+    /** Start journaling every change to the verifier and registry */
+    bool Attach(DeviceVerifier& verifier, DeviceRegistry& registry, std::string& error);
+
+    /** Stop journaling; buffered entries are flushed and synced */
+    void Detach();
+
+    /** Write a new snapshot and drop the journals it covers */
+    bool Checkpoint(std::string& error, RegistryCheckpointStats* stats = nullptr);
+
+    /** Write buffered journal entries out (without fsync) */
+    bool Flush();
+
+    uint64_t GetJournalSize() const;
+
+private:
+    std::string SnapshotPath() const;
+    std::string JournalPath(uint64_t sequence) const;
+    std::vector<uint64_t> ListJournals() const;
+
+    bool LoadSnapshot(DeviceVerifier& verifier, DeviceRegistry& registry,
+                      RegistryLoadStats& stats, uint64_t& journal_sequence, std::string& error);
+    bool ReplayJournal(const std::string& path, DeviceVerifier& verifier, DeviceRegistry& registry,
+                       RegistryLoadStats& stats, std::string& error);
+    bool WriteSnapshot(const std::string& path, uint64_t journal_sequence,
+                       RegistryCheckpointStats& stats, std::string& error);
+
+    const std::string m_directory;
+    DeviceVerifier* m_verifier = nullptr;
+    DeviceRegistry* m_registry = nullptr;
+    std::unique_ptr<RegistryJournal> m_journal;
+    uint64_t m_journal_sequence = 0;    // Journal currently appended to
+    std::mutex m_checkpoint_mutex;
+};
+
+} // namespace PoDD
+
+#endif // SYNC_PODD_REGISTRY_STORE_H
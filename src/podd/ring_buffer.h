@@ -0,0 +1,206 @@
+// Copyright (c) 2024 SyntheticCoin Developers
+// Distributed under the MIT software license
+
+#ifndef SYNC_PODD_RING_BUFFER_H
+#define SYNC_PODD_RING_BUFFER_H
+
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+
+namespace PoDD {
+
+/**
+ * Fixed-capacity sliding window with running statistics.
+ *
+ * Pushing into a full buffer overwrites the oldest sample. The sum, mean and
+ * population variance of the window are maintained incrementally (Welford's
+ * update, extended to handle the evicted sample), so every operation is O(1)
+ * amortized and nothing is ever allocated. The moments are recomputed exactly
+ * once per lap of the buffer to keep floating point drift bounded.
+ */
+template <typename T, size_t N>
+class RingBuffer {
+    static_assert(N > 0, "RingBuffer needs a non-zero capacity");
+
+public:
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        const_iterator(const RingBuffer* buffer, size_t index) : m_buffer(buffer), m_index(index) {}
+
+        reference operator*() const { return (*m_buffer)[m_index]; }
+        pointer operator->() const { return &(*m_buffer)[m_index]; }
+        const_iterator& operator++() { ++m_index; return *this; }
+        const_iterator operator++(int) { const_iterator tmp = *this; ++m_index; return tmp; }
+        bool operator==(const const_iterator& other) const { return m_index == other.m_index; }
+        bool operator!=(const const_iterator& other) const { return m_index != other.m_index; }
+
+    private:
+        const RingBuffer* m_buffer;
+        size_t m_index;
+    };
+
+    /**
+     * Append a sample, evicting the oldest one once the window is full
+     */
+    void Push(T value) {
+        double x = static_cast<double>(value);
+
+        if (m_size < N) {
+            m_data[(m_start + m_size) % N] = value;
+            ++m_size;
+            m_sum += value;
+
+            double delta = x - m_mean;
+            m_mean += delta / m_size;
+            m_m2 += delta * (x - m_mean);
+            return;
+        }
+
+        T evicted = m_data[m_start];
+        m_data[m_start] = value;
+        m_start = (m_start + 1) % N;
+        m_sum += value;
+        m_sum -= evicted;
+
+        if (m_start == 0) {
+            // Once per lap, re-derive the moments exactly so rounding error
+            // from the sliding update cannot accumulate without bound
+            Resync();
+            return;
+        }
+
+        // Replace the evicted sample in place: the count stays at N
+        double old_x = static_cast<double>(evicted);
+        double old_mean = m_mean;
+        m_mean += (x - old_x) / N;
+        m_m2 += (x - old_x) * ((x - m_mean) + (old_x - old_mean));
+        if (m_m2 < 0.0) m_m2 = 0.0; // Rounding can leave a tiny negative residue
+    }
+
+    void Clear() {
+        m_start = 0;
+        m_size = 0;
+        m_sum = T{};
+        m_mean = 0.0;
+        m_m2 = 0.0;
+    }
+
+    /** Sample by age, 0 being the oldest in the window */
+    const T& operator[](size_t i) const { return m_data[(m_start + i) % N]; }
+
+    const T& Newest() const { return (*this)[m_size - 1]; }
+    const T& Oldest() const { return (*this)[0]; }
+
+    size_t Size() const { return m_size; }
+    bool Empty() const { return m_size == 0; }
+    bool Full() const { return m_size == N; }
+    static constexpr size_t Capacity() { return N; }
+
+    /** Exact sum of the window (wraps like T for integral types) */
+    T Sum() const { return m_sum; }
+    double Mean() const { return m_mean; }
+
+    /** Sum of squared deviations from the mean (Welford's M2) */
+    double SumSquaredDeviations() const { return m_m2; }
+
+    /** Population variance of the window */
+    double Variance() const { return m_size > 0 ? m_m2 / m_size : 0.0; }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, m_size); }
+
+private:
+    void Resync() {
+        double sum = 0.0;
+        for (size_t i = 0; i < m_size; ++i) {
+            sum += static_cast<double>((*this)[i]);
+        }
+        m_mean = sum / m_size;
+
+        double m2 = 0.0;
+        for (size_t i = 0; i < m_size; ++i) {
+            double d = static_cast<double>((*this)[i]) - m_mean;
+            m2 += d * d;
+        }
+        m_m2 = m2;
+    }
+
+    std::array<T, N> m_data{};
+    size_t m_start = 0; // Index of the oldest sample
+    size_t m_size = 0;
+    T m_sum{};
+    double m_mean = 0.0;
+    double m_m2 = 0.0;
+};
+
+/**
+ * RingBuffer whose storage is allocated by the first push.
+ *
+ * Until then it is a single null pointer, for windows that many holders never
+ * fill: a device that has not mined since the node started carries no nonce
+ * window. Copies are deep. Clear() keeps the storage.
+ */
+template <typename T, size_t N>
+class LazyRingBuffer {
+public:
+    using const_iterator = typename RingBuffer<T, N>::const_iterator;
+
+    LazyRingBuffer() = default;
+    LazyRingBuffer(const LazyRingBuffer& other)
+        : m_buffer(other.m_buffer ? std::make_unique<RingBuffer<T, N>>(*other.m_buffer) : nullptr) {}
+    LazyRingBuffer(LazyRingBuffer&&) noexcept = default;
+
+    LazyRingBuffer& operator=(const LazyRingBuffer& other) {
+        if (this != &other) {
+            m_buffer = other.m_buffer ? std::make_unique<RingBuffer<T, N>>(*other.m_buffer) : nullptr;
+        }
+        return *this;
+    }
+    LazyRingBuffer& operator=(LazyRingBuffer&&) noexcept = default;
+
+    void Push(T value) {
+        if (!m_buffer) {
+            m_buffer = std::make_unique<RingBuffer<T, N>>();
+        }
+        m_buffer->Push(value);
+    }
+
+    void Clear() {
+        if (m_buffer) m_buffer->Clear();
+    }
+
+    /** Sample by age, 0 being the oldest; i must be below Size() */
+    const T& operator[](size_t i) const { return (*m_buffer)[i]; }
+
+    const T& Newest() const { return m_buffer->Newest(); }
+    const T& Oldest() const { return m_buffer->Oldest(); }
+
+    size_t Size() const { return m_buffer ? m_buffer->Size() : 0; }
+    bool Empty() const { return Size() == 0; }
+    bool Full() const { return Size() == N; }
+    static constexpr size_t Capacity() { return N; }
+
+    T Sum() const { return m_buffer ? m_buffer->Sum() : T{}; }
+    double Mean() const { return m_buffer ? m_buffer->Mean() : 0.0; }
+    double SumSquaredDeviations() const { return m_buffer ? m_buffer->SumSquaredDeviations() : 0.0; }
+    double Variance() const { return m_buffer ? m_buffer->Variance() : 0.0; }
+
+    // An unallocated window iterates as empty: both ends are index 0
+    const_iterator begin() const { return const_iterator(m_buffer.get(), 0); }
+    const_iterator end() const { return const_iterator(m_buffer.get(), Size()); }
+
+private:
+    std::unique_ptr<RingBuffer<T, N>> m_buffer;
+};
+
+} // namespace PoDD
+
+#endif // SYNC_PODD_RING_BUFFER_H
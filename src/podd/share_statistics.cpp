@@ -0,0 +1,122 @@
+// Copyright (c) 2024 SyntheticCoin Developers
+// Distributed under the MIT software license
+
+#include "share_statistics.h"
+
+namespace PoDD {
+
+namespace {
+
+// Table size for the first sample; a device window of ten samples fits
+constexpr size_t INITIAL_SLOTS = 16;
+
+} // namespace
+
+size_t TimingEntropyTracker::Home(uint64_t bucket) const {
+    // Fibonacci hashing: consecutive milliseconds spread over the table
+    return static_cast<size_t>((bucket * 0x9E3779B97F4A7C15ULL) >> 32) & (m_slots.size() - 1);
+}
+
+size_t TimingEntropyTracker::Find(uint64_t bucket) const {
+    size_t mask = m_slots.size() - 1;
+    size_t i = Home(bucket);
+    while (m_slots[i].count != 0 && m_slots[i].bucket != bucket) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+void TimingEntropyTracker::Add(uint64_t timing_us) {
+    if ((m_used + 1) * 2 > m_slots.size()) {
+        Grow();
+    }
+
+    uint64_t bucket = BucketOf(timing_us);
+    Slot& slot = m_slots[Find(bucket)];
+    if (slot.count == 0) {
+        slot.bucket = bucket;
+        ++m_used;
+    }
+
+    m_sum -= CountLog2Count(slot.count);
+    ++slot.count;
+    m_sum += CountLog2Count(slot.count);
+    ++m_count;
+
+    if (++m_updates == RESYNC_INTERVAL) {
+        Resync();
+    }
+}
+
+void TimingEntropyTracker::Remove(uint64_t timing_us) {
+    if (m_slots.empty()) return;
+
+    size_t mask = m_slots.size() - 1;
+    size_t i = Find(BucketOf(timing_us));
+    Slot& slot = m_slots[i];
+    if (slot.count == 0) return;
+
+    m_sum -= CountLog2Count(slot.count);
+    --slot.count;
+    m_sum += CountLog2Count(slot.count);
+    --m_count;
+
+    if (slot.count == 0) {
+        --m_used;
+        // Backward-shift deletion: pull later members of the probe run into
+        // the hole so lookups never need tombstones
+        size_t hole = i;
+        for (size_t j = (i + 1) & mask; m_slots[j].count != 0; j = (j + 1) & mask) {
+            size_t home = Home(m_slots[j].bucket);
+            // Move j into the hole unless its home lies cyclically in (hole, j]
+            bool stays = hole <= j ? (hole < home && home <= j) : (hole < home || home <= j);
+            if (!stays) {
+                m_slots[hole] = m_slots[j];
+                m_slots[j].count = 0;
+                hole = j;
+            }
+        }
+    }
+
+    if (++m_updates == RESYNC_INTERVAL) {
+        Resync();
+    }
+}
+
+void TimingEntropyTracker::Clear() {
+    for (Slot& slot : m_slots) {
+        slot.count = 0;
+    }
+    m_used = 0;
+    m_count = 0;
+    m_sum = 0.0;
+    m_updates = 0;
+}
+
+double TimingEntropyTracker::Entropy() const {
+    if (m_count < 2) return 0.0;
+    double n = static_cast<double>(m_count);
+    return std::max(0.0, std::log2(n) - m_sum / n);
+}
+
+void TimingEntropyTracker::Grow() {
+    std::vector<Slot> old;
+    old.swap(m_slots);
+    m_slots.assign(old.empty() ? INITIAL_SLOTS : old.size() * 2, Slot());
+
+    for (const Slot& slot : old) {
+        if (slot.count != 0) {
+            m_slots[Find(slot.bucket)] = slot;
+        }
+    }
+}
+
+void TimingEntropyTracker::Resync() {
+    m_sum = 0.0;
+    for (const Slot& slot : m_slots) {
+        m_sum += CountLog2Count(slot.count);
+    }
+    m_updates = 0;
+}
+
+} // namespace PoDD
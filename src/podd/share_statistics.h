@@ -0,0 +1,285 @@
+// Copyright (c) 2024 SyntheticCoin Developers
+// Distributed under the MIT software license
+
+#ifndef SYNC_PODD_SHARE_STATISTICS_H
+#define SYNC_PODD_SHARE_STATISTICS_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ring_buffer.h"
+
+namespace PoDD {
+
+/**
+ * c * log2(c), the per-bin term of the count form of Shannon entropy:
+ * H = log2(n) - sum(c * log2 c) / n. Windowed counts stay small, so values
+ * come from a table; log2 is only evaluated beyond it.
+ */
+inline double CountLog2Count(uint64_t c) {
+    constexpr size_t TABLE_SIZE = 1024;
+    static const std::array<double, TABLE_SIZE> table = [] {
+        std::array<double, TABLE_SIZE> values{};
+        for (size_t i = 2; i < TABLE_SIZE; ++i) {
+            values[i] = static_cast<double>(i) * std::log2(static_cast<double>(i));
+        }
+        return values;
+    }();
+    if (c < TABLE_SIZE) return table[c];
+    return static_cast<double>(c) * std::log2(static_cast<double>(c));
+}
+
+/**
+ * Sliding window that keeps its samples sorted.
+ *
+ * Every push evicts the oldest sample once the window is full and inserts the
+ * new one in order, shifting at most N elements; nothing is allocated. The
+ * sorted samples feed Kolmogorov-Smirnov tests directly, without a sort per
+ * query.
+ */
+template <typename T, size_t N>
+class SortedWindow {
+public:
+    void Push(T value) {
+        T* first = m_sorted.data();
+        T* last = first + m_fifo.Size();
+
+        if (m_fifo.Full()) {
+            T* evicted = std::lower_bound(first, last, m_fifo.Oldest());
+            std::move(evicted + 1, last, evicted);
+            --last;
+        }
+
+        T* pos = std::upper_bound(first, last, value);
+        std::move_backward(pos, last, last + 1);
+        *pos = value;
+
+        m_fifo.Push(value);
+    }
+
+    void Clear() { m_fifo.Clear(); }
+
+    /** Samples in ascending order */
+    const T* Sorted() const { return m_sorted.data(); }
+    const T& operator[](size_t i) const { return m_sorted[i]; }
+
+    size_t Size() const { return m_fifo.Size(); }
+    bool Empty() const { return m_fifo.Empty(); }
+    bool Full() const { return m_fifo.Full(); }
+    double Mean() const { return m_fifo.Mean(); }
+
+    /** Samples in arrival order */
+    const RingBuffer<T, N>& Window() const { return m_fifo; }
+
+private:
+    RingBuffer<T, N> m_fifo;
+    std::array<T, N> m_sorted{};
+};
+
+/**
+ * Two-sample Kolmogorov-Smirnov distance: the largest gap between the
+ * empirical CDFs of two sorted samples. O(n + m), no allocation.
+ */
+template <typename T>
+double KolmogorovSmirnovDistance(const T* a, size_t n, const T* b, size_t m) {
+    if (n == 0 || m == 0) return 0.0;
+
+    double distance = 0.0;
+    size_t i = 0;
+    size_t j = 0;
+    while (i < n && j < m) {
+        // Step past every copy of the next value in both samples, so ties
+        // move both CDFs together
+        T x = std::min(a[i], b[j]);
+        while (i < n && !(x < a[i])) ++i;
+        while (j < m && !(x < b[j])) ++j;
+        distance = std::max(distance, std::abs(static_cast<double>(i) / n -
+                                               static_cast<double>(j) / m));
+    }
+    return distance;
+}
+
+/**
+ * One-sample Kolmogorov-Smirnov distance between a sorted sample and the
+ * exponential distribution with the given mean
+ */
+template <typename T>
+double ExponentialKSDistance(const T* sorted, size_t n, double mean) {
+    if (n == 0 || mean <= 0.0) return 0.0;
+
+    double distance = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        double cdf = 1.0 - std::exp(-static_cast<double>(sorted[i]) / mean);
+        distance = std::max(distance, static_cast<double>(i + 1) / n - cdf);
+        distance = std::max(distance, cdf - static_cast<double>(i) / n);
+    }
+    return distance;
+}
+
+/**
+ * Whether a two-sample KS distance rejects "same distribution" at the 1% level
+ */
+inline bool KolmogorovSmirnovRejects(double distance, size_t n, size_t m) {
+    if (n == 0 || m == 0) return false;
+    constexpr double C_ALPHA = 1.628; // sqrt(-ln(0.01 / 2) / 2)
+    return distance > C_ALPHA * std::sqrt(static_cast<double>(n + m) / (static_cast<double>(n) * m));
+}
+
+/**
+ * Whether an ExponentialKSDistance rejects exponentially distributed samples
+ * at the 1% level. The mean is estimated from the sample itself, so this
+ * uses Stephens' modified statistic rather than the plain KS table.
+ */
+inline bool ExponentialFitRejected(double distance, size_t n) {
+    if (n == 0) return false;
+    double root_n = std::sqrt(static_cast<double>(n));
+    return (distance - 0.2 / n) * (root_n + 0.26 + 0.5 / root_n) > 1.308;
+}
+
+/**
+ * Joint histogram of two binned variables with O(1) entropy and mutual
+ * information queries.
+ *
+ * Alongside the counts it maintains S = sum(c * log2 c) for the joint and
+ * both marginal histograms, so H = log2(n) - S / n needs no pass over the
+ * bins. Pairs can be removed as well as added, which lets the caller slide
+ * the histogram over a window. The sums are recomputed from the counts
+ * every RESYNC_INTERVAL updates to bound floating point drift.
+ */
+template <size_t BINS>
+class MutualInformationHistogram {
+    static_assert(BINS > 1, "Need at least two bins");
+
+public:
+    static constexpr uint32_t RESYNC_INTERVAL = 4096;
+
+    void Add(size_t x, size_t y) { Update(x, y, true); }
+    void Remove(size_t x, size_t y) { Update(x, y, false); }
+
+    void Clear() {
+        m_joint.fill(0);
+        m_x.fill(0);
+        m_y.fill(0);
+        m_count = 0;
+        m_s_joint = m_s_x = m_s_y = 0.0;
+        m_updates = 0;
+    }
+
+    uint64_t Count() const { return m_count; }
+
+    /** Entropies in bits */
+    double EntropyX() const { return Entropy(m_s_x); }
+    double EntropyY() const { return Entropy(m_s_y); }
+    double JointEntropy() const { return Entropy(m_s_joint); }
+
+    /**
+     * Mutual information in bits, less the plug-in estimator's expected bias
+     * for independent variables ((BINS - 1)^2 / (2 n ln 2), Miller-Madow),
+     * and clamped at zero
+     */
+    double MutualInformation() const {
+        if (m_count == 0) return 0.0;
+        double plug_in = EntropyX() + EntropyY() - JointEntropy();
+        double bias = static_cast<double>((BINS - 1) * (BINS - 1)) / (2.0 * m_count * std::log(2.0));
+        return std::max(0.0, plug_in - bias);
+    }
+
+private:
+    static void Step(uint32_t& count, double& sum, bool add) {
+        sum -= CountLog2Count(count);
+        count = add ? count + 1 : count - 1;
+        sum += CountLog2Count(count);
+    }
+
+    void Update(size_t x, size_t y, bool add) {
+        Step(m_joint[x * BINS + y], m_s_joint, add);
+        Step(m_x[x], m_s_x, add);
+        Step(m_y[y], m_s_y, add);
+        m_count = add ? m_count + 1 : m_count - 1;
+
+        if (++m_updates == RESYNC_INTERVAL) {
+            Resync();
+        }
+    }
+
+    void Resync() {
+        m_s_joint = m_s_x = m_s_y = 0.0;
+        for (uint32_t c : m_joint) m_s_joint += CountLog2Count(c);
+        for (uint32_t c : m_x) m_s_x += CountLog2Count(c);
+        for (uint32_t c : m_y) m_s_y += CountLog2Count(c);
+        m_updates = 0;
+    }
+
+    double Entropy(double s) const {
+        if (m_count == 0) return 0.0;
+        double n = static_cast<double>(m_count);
+        return std::max(0.0, std::log2(n) - s / n);
+    }
+
+    std::array<uint32_t, BINS * BINS> m_joint{};
+    std::array<uint32_t, BINS> m_x{};
+    std::array<uint32_t, BINS> m_y{};
+    uint64_t m_count = 0;
+    double m_s_joint = 0.0;
+    double m_s_x = 0.0;
+    double m_s_y = 0.0;
+    uint32_t m_updates = 0;
+};
+
+/**
+ * Shannon entropy of timing samples grouped by millisecond, maintained as
+ * samples enter and leave a window.
+ *
+ * Bucket counts live in a flat open-addressing table (linear probing,
+ * backward-shift deletion) next to S = sum(c * log2 c), so adding or removing
+ * a sample is O(1) and Entropy() is O(1). The table grows to keep its load
+ * at most one half and never shrinks, so a tracker that has reached its
+ * working size stops allocating. S is recomputed from the counts every
+ * RESYNC_INTERVAL updates to bound floating point drift.
+ */
+class TimingEntropyTracker {
+public:
+    static constexpr uint32_t RESYNC_INTERVAL = 4096;
+
+    /** Histogram bucket of a timing sample (microseconds to milliseconds) */
+    static uint64_t BucketOf(uint64_t timing_us) { return timing_us / 1000; }
+
+    void Add(uint64_t timing_us);
+
+    /** Remove one sample previously added; unknown samples are ignored */
+    void Remove(uint64_t timing_us);
+
+    /** Forget every sample but keep the table's capacity */
+    void Clear();
+
+    uint64_t Count() const { return m_count; }
+    size_t Buckets() const { return m_used; }
+
+    /** Entropy in bits */
+    double Entropy() const;
+
+private:
+    struct Slot {
+        uint64_t bucket = 0;
+        uint32_t count = 0;             // 0 marks an empty slot
+    };
+
+    size_t Home(uint64_t bucket) const;
+    size_t Find(uint64_t bucket) const;
+    void Grow();
+    void Resync();
+
+    std::vector<Slot> m_slots;
+    size_t m_used = 0;                  // Occupied slots (distinct buckets)
+    uint64_t m_count = 0;
+    double m_sum = 0.0;
+    uint32_t m_updates = 0;
+};
+
+} // namespace PoDD
+
+#endif // SYNC_PODD_SHARE_STATISTICS_H
@@ -0,0 +1,227 @@
+// Copyright (c) 2024 SyntheticCoin Developers
+// Distributed under the MIT software license
+
+#include "similarity_index.h"
+#include "fingerprint_matrix.h"
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+#include <functional>
+
+namespace PoDD {
+
+namespace {
+
+// Below this many devices the grid costs more than it saves
+constexpr size_t BRUTE_FORCE_CUTOFF = 32;
+
+// Absorbs rounding in the score so the pruning bounds stay conservative
+constexpr double SLACK_EPSILON = 1e-9;
+
+struct CellKey {
+    size_t ip_group;
+    int64_t timing_cell;
+    int64_t variance_cell;
+
+    bool operator<(const CellKey& other) const {
+        return std::tie(ip_group, timing_cell, variance_cell) <
+               std::tie(other.ip_group, other.timing_cell, other.variance_cell);
+    }
+    bool operator==(const CellKey& other) const {
+        return ip_group == other.ip_group && timing_cell == other.timing_cell &&
+               variance_cell == other.variance_cell;
+    }
+};
+
+struct Cell {
+    CellKey key;
+    size_t begin; // Range in the sorted entry array
+    size_t end;
+};
+
+/**
+ * Largest distance at which a term with the given weight and decay scale
+ * can still lose less than `slack` score, or 0 if the term cannot prune.
+ */
+double PruningCellWidth(double slack, double weight, double scale) {
+    if (slack >= weight) {
+        return 0.0;
+    }
+    double radius = -scale * std::log(1.0 - slack / weight);
+    // Cells at least as wide as the radius keep every candidate within one
+    // cell of its partner; the extra unit covers integer truncation
+    return radius * (1.0 + SLACK_EPSILON) + 1.0;
+}
+
+int64_t CellOf(uint64_t value, double width) {
+    if (width <= 0.0) return 0;
+    return static_cast<int64_t>(std::floor(static_cast<double>(value) / width));
+}
+
+/** Per-thread working buffers, reused across searches */
+struct GridScratch {
+    std::vector<std::pair<CellKey, size_t>> entries;
+    std::vector<Cell> cells;
+    std::vector<double> scores;
+    FingerprintMatrix matrix;
+};
+
+GridScratch& GetGridScratch() {
+    thread_local GridScratch scratch;
+    return scratch;
+}
+
+} // namespace
+
+SimilarityIndex::SimilarityIndex(double threshold)
+    : m_threshold(threshold) {
+    using namespace Similarity;
+
+    // Highest raw score a pair can reach and the normalizing weight sum used
+    // by CalculateSimilarity
+    double max_score = TIMING_WEIGHT + VARIANCE_WEIGHT +
+                       SAME_IP_BONUS + LATENCY_WEIGHT +
+                       SAME_FIRMWARE_BONUS + SAME_CHIP_COUNT_BONUS + POWER_WEIGHT;
+    double weight_sum = TIMING_WEIGHT + VARIANCE_WEIGHT + CATEGORY_WEIGHT + CATEGORY_WEIGHT;
+
+    // Score a pair may lose in total and still exceed the threshold
+    double slack = max_score - threshold * weight_sum + SLACK_EPSILON;
+
+    m_require_same_ip = slack < SAME_IP_BONUS;
+    m_timing_cell_us = PruningCellWidth(slack, TIMING_WEIGHT, TIMING_SCALE_US);
+    m_variance_cell_us = PruningCellWidth(slack, VARIANCE_WEIGHT, VARIANCE_SCALE_US);
+}
+
+std::vector<std::pair<size_t, size_t>> SimilarityIndex::FindSimilarPairsBruteForce(
+    const std::vector<const DeviceFingerprint*>& fingerprints) const {
+
+    std::vector<std::pair<size_t, size_t>> pairs;
+    for (size_t i = 0; i < fingerprints.size(); ++i) {
+        for (size_t j = i + 1; j < fingerprints.size(); ++j) {
+            if (fingerprints[i]->CalculateSimilarity(*fingerprints[j]) > m_threshold) {
+                pairs.emplace_back(i, j);
+            }
+        }
+    }
+    return pairs;
+}
+
+std::vector<std::pair<size_t, size_t>> SimilarityIndex::FindSimilarPairs(
+    const std::vector<const DeviceFingerprint*>& fingerprints) const {
+
+    std::vector<std::pair<size_t, size_t>> pairs;
+    FindSimilarPairs(fingerprints, pairs);
+    return pairs;
+}
+
+void SimilarityIndex::FindSimilarPairs(const std::vector<const DeviceFingerprint*>& fingerprints,
+                                       std::vector<std::pair<size_t, size_t>>& pairs) const {
+    pairs.clear();
+
+    if (fingerprints.size() < BRUTE_FORCE_CUTOFF ||
+        (!m_require_same_ip && m_timing_cell_us == 0.0 && m_variance_cell_us == 0.0)) {
+        for (size_t i = 0; i < fingerprints.size(); ++i) {
+            for (size_t j = i + 1; j < fingerprints.size(); ++j) {
+                if (fingerprints[i]->CalculateSimilarity(*fingerprints[j]) > m_threshold) {
+                    pairs.emplace_back(i, j);
+                }
+            }
+        }
+        return;
+    }
+
+    GridScratch& scratch = GetGridScratch();
+    auto& entries = scratch.entries;
+    auto& cells = scratch.cells;
+    auto& scores = scratch.scores;
+    auto& matrix = scratch.matrix;
+
+    // Assign every device to a grid cell. IPs are grouped by their interned
+    // handle, which is unique per address, so a group holds exactly the
+    // devices sharing one IP.
+    entries.clear();
+    for (size_t i = 0; i < fingerprints.size(); ++i) {
+        const DeviceFingerprint& fp = *fingerprints[i];
+
+        CellKey key;
+        key.ip_group = m_require_same_ip ? fp.ip_address.GetHandle() : 0;
+        key.timing_cell = CellOf(fp.avg_nonce_time_us, m_timing_cell_us);
+        key.variance_cell = CellOf(fp.timing_variance_us, m_variance_cell_us);
+        entries.emplace_back(key, i);
+    }
+
+    std::sort(entries.begin(), entries.end(),
+              [](const auto& a, const auto& b) {
+                  return a.first < b.first || (a.first == b.first && a.second < b.second);
+              });
+
+    cells.clear();
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (cells.empty() || !(cells.back().key == entries[i].first)) {
+            cells.push_back({entries[i].first, i, i});
+        }
+        cells.back().end = i + 1;
+    }
+
+    auto find_cell = [&](const CellKey& key) -> const Cell* {
+        auto it = std::lower_bound(cells.begin(), cells.end(), key,
+                                   [](const Cell& c, const CellKey& k) { return c.key < k; });
+        return (it != cells.end() && it->key == key) ? &*it : nullptr;
+    };
+
+    // Lay the fingerprints out in cell order so every cell is a contiguous
+    // block of matrix rows for the batch kernel
+    matrix.Clear();
+    for (const auto& entry : entries) {
+        matrix.Add(*fingerprints[entry.second]);
+    }
+
+    auto score_block = [&](size_t a, size_t b_begin, size_t b_end) {
+        if (b_begin >= b_end) return;
+        if (scores.size() < b_end - b_begin) {
+            scores.resize(b_end - b_begin);
+        }
+        matrix.ScoreOneVsMany(a, b_begin, b_end, scores.data());
+
+        for (size_t b = b_begin; b < b_end; ++b) {
+            double score = scores[b - b_begin];
+            if (score <= m_threshold - FingerprintMatrix::MAX_KERNEL_ERROR) continue;
+
+            size_t i = entries[a].second;
+            size_t j = entries[b].second;
+            // Too close to call with the vector exp(): settle it with the
+            // exact score so results never depend on the CPU
+            if (score <= m_threshold + FingerprintMatrix::MAX_KERNEL_ERROR &&
+                !(fingerprints[i]->CalculateSimilarity(*fingerprints[j]) > m_threshold)) {
+                continue;
+            }
+            pairs.emplace_back(std::min(i, j), std::max(i, j));
+        }
+    };
+
+    // Half of the 3x3 neighbourhood, so every adjacent cell pair is visited once
+    static const int64_t FORWARD[4][2] = {{0, 1}, {1, -1}, {1, 0}, {1, 1}};
+
+    for (const Cell& cell : cells) {
+        for (size_t a = cell.begin; a < cell.end; ++a) {
+            score_block(a, a + 1, cell.end);
+        }
+
+        for (const auto& offset : FORWARD) {
+            CellKey neighbour_key = cell.key;
+            neighbour_key.timing_cell += offset[0];
+            neighbour_key.variance_cell += offset[1];
+
+            const Cell* neighbour = find_cell(neighbour_key);
+            if (!neighbour) continue;
+
+            for (size_t a = cell.begin; a < cell.end; ++a) {
+                score_block(a, neighbour->begin, neighbour->end);
+            }
+        }
+    }
+
+    std::sort(pairs.begin(), pairs.end());
+}
+
+} // namespace PoDD
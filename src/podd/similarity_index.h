@@ -0,0 +1,69 @@
+// Copyright (c) 2024 SyntheticCoin Developers
+// Distributed under the MIT software license
+
+#ifndef SYNC_PODD_SIMILARITY_INDEX_H
+#define SYNC_PODD_SIMILARITY_INDEX_H
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "device_verifier.h"
+
+namespace PoDD {
+
+/**
+ * Near-linear search for fingerprint pairs above a similarity threshold.
+ *
+ * CalculateSimilarity is a weighted sum of bounded terms, so a pair can only
+ * exceed the threshold if the score it loses on each individual term stays
+ * within the total slack (1 - threshold). From that the index derives:
+ *  - whether both devices must share an IP address (the same-IP bonus alone
+ *    is worth more than the slack at the default 0.9 threshold),
+ *  - a maximum timing distance and a maximum variance distance.
+ * Fingerprints are bucketed on a grid keyed by (IP, timing cell, variance
+ * cell) with cells at least as wide as those distances, and only pairs in
+ * adjacent cells are scored, a block at a time through FingerprintMatrix.
+ * The result is identical to scoring every pair, without the O(n^2) cost.
+ */
+class SimilarityIndex {
+public:
+    explicit SimilarityIndex(double threshold = Similarity::SUSPICIOUS_THRESHOLD);
+
+    /**
+     * Find every pair whose similarity exceeds the threshold
+     * @param fingerprints Devices to search
+     * @return Index pairs (i < j), ordered as the pairwise i/j loop would emit them
+     */
+    std::vector<std::pair<size_t, size_t>> FindSimilarPairs(
+        const std::vector<const DeviceFingerprint*>& fingerprints) const;
+
+    /**
+     * Same as above, writing into a caller-owned vector (cleared first).
+     * Working buffers are kept per thread, so repeated searches do not
+     * allocate once they have warmed up.
+     */
+    void FindSimilarPairs(const std::vector<const DeviceFingerprint*>& fingerprints,
+                          std::vector<std::pair<size_t, size_t>>& pairs) const;
+
+    /**
+     * Reference O(n^2) implementation, kept for auditing the index
+     */
+    std::vector<std::pair<size_t, size_t>> FindSimilarPairsBruteForce(
+        const std::vector<const DeviceFingerprint*>& fingerprints) const;
+
+    double GetThreshold() const { return m_threshold; }
+
+    /** Whether only devices sharing an IP address can exceed the threshold */
+    bool RequiresSameIP() const { return m_require_same_ip; }
+
+private:
+    double m_threshold;
+    bool m_require_same_ip;
+    double m_timing_cell_us;    // 0 when timing cannot prune
+    double m_variance_cell_us;  // 0 when variance cannot prune
+};
+
+} // namespace PoDD
+
+#endif // SYNC_PODD_SIMILARITY_INDEX_H
@@ -0,0 +1,222 @@
+// Copyright (c) 2024 SyntheticCoin Developers
+// Distributed under the MIT software license
+
+#include "spoofing_auditor.h"
+#include <algorithm>
+#include <functional>
+#include <iterator>
+
+namespace PoDD {
+
+namespace {
+
+// Partitions per pool thread; more partitions than threads lets stealing
+// even out partitions of very different sizes
+constexpr size_t PARTITIONS_PER_THREAD = 4;
+
+using DevicePair = std::pair<std::string, std::string>;
+
+std::chrono::microseconds Elapsed(std::chrono::steady_clock::time_point from,
+                                  std::chrono::steady_clock::time_point to) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(to - from);
+}
+
+} // namespace
+
+SpoofingAuditor::SpoofingAuditor(DeviceVerifier& verifier, uint32_t interval, size_t thread_count)
+    : m_verifier(verifier),
+      m_interval(interval),
+      m_pool(thread_count) {
+    m_coordinator = std::thread([this] { CoordinatorLoop(); });
+}
+
+SpoofingAuditor::~SpoofingAuditor() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_cv.notify_all();
+    m_coordinator.join();
+}
+
+bool SpoofingAuditor::OnBlockConnected(uint32_t height) {
+    if (m_interval == 0 || height % m_interval != 0) {
+        return false;
+    }
+    return RequestAudit(height);
+}
+
+bool SpoofingAuditor::RequestAudit(uint32_t height) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_stopping || m_pending || m_running) {
+        return false; // Previous audit still in flight; catch up next interval
+    }
+    m_pending = true;
+    m_pending_height = height;
+    m_cv.notify_all();
+    return true;
+}
+
+void SpoofingAuditor::WaitForIdle() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait(lock, [this] { return !m_pending && !m_running; });
+}
+
+AuditProgress SpoofingAuditor::GetProgress() const {
+    AuditProgress progress;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        progress.running = m_running || m_pending;
+        progress.audits_completed = m_audits_completed;
+    }
+    progress.height = m_current_height.load(std::memory_order_relaxed);
+    progress.tasks_total = m_tasks_total.load(std::memory_order_relaxed);
+    progress.tasks_done = m_tasks_done.load(std::memory_order_relaxed);
+    progress.thread_count = m_pool.GetThreadCount();
+    return progress;
+}
+
+bool SpoofingAuditor::GetLastReport(AuditReport& report) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_audits_completed == 0) {
+        return false;
+    }
+    report = m_last_report;
+    return true;
+}
+
+void SpoofingAuditor::CoordinatorLoop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_cv.wait(lock, [this] { return m_stopping || m_pending; });
+        if (m_stopping) {
+            return;
+        }
+
+        uint32_t height = m_pending_height;
+        m_pending = false;
+        m_running = true;
+        m_current_height = height;
+        m_tasks_total = 0;
+        m_tasks_done = 0;
+
+        lock.unlock();
+        AuditReport report = RunAudit(height);
+        lock.lock();
+
+        // Report what changed since the previous audit
+        const auto& previous = m_last_report.suspicious_pairs;
+        std::set_difference(report.suspicious_pairs.begin(), report.suspicious_pairs.end(),
+                            previous.begin(), previous.end(),
+                            std::back_inserter(report.new_pairs));
+        std::set_difference(previous.begin(), previous.end(),
+                            report.suspicious_pairs.begin(), report.suspicious_pairs.end(),
+                            std::back_inserter(report.cleared_pairs));
+
+        m_last_report = std::move(report);
+        ++m_audits_completed;
+        m_running = false;
+        m_cv.notify_all();
+    }
+}
+
+AuditReport SpoofingAuditor::RunAudit(uint32_t height) {
+    using Clock = std::chrono::steady_clock;
+
+    AuditReport report;
+    report.height = height;
+
+    const uint64_t tasks_before = m_pool.GetTasksCompleted();
+    const uint64_t stolen_before = m_pool.GetTasksStolen();
+    const auto start = Clock::now();
+
+    // Phase 1: copy the registry out one shard at a time
+    const size_t shard_count = DeviceVerifier::GetShardCount();
+    std::vector<std::vector<std::pair<std::string, DeviceFingerprint>>> shards(shard_count);
+
+    m_tasks_total += shard_count;
+    for (size_t s = 0; s < shard_count; ++s) {
+        m_pool.Submit([this, &shards, s] {
+            m_verifier.SnapshotShard(s, shards[s]);
+            ++m_tasks_done;
+        });
+    }
+    m_pool.WaitIdle();
+    const auto snapshot_done = Clock::now();
+
+    // Phase 2: similarity search per IP partition
+    const size_t partition_count = m_index.RequiresSameIP()
+        ? m_pool.GetThreadCount() * PARTITIONS_PER_THREAD : 1;
+    std::vector<std::vector<const std::pair<std::string, DeviceFingerprint>*>> partitions(partition_count);
+
+    for (const auto& shard : shards) {
+        for (const auto& entry : shard) {
+            size_t p = std::hash<InternedString>{}(entry.second.ip_address) % partition_count;
+            partitions[p].push_back(&entry);
+        }
+        report.devices_audited += shard.size();
+    }
+    report.partitions = partition_count;
+
+    std::vector<std::vector<DevicePair>> found(partition_count);
+    for (size_t p = 0; p < partition_count; ++p) {
+        if (partitions[p].size() < 2) continue;
+
+        ++m_tasks_total;
+        m_pool.Submit([this, &partitions, &found, p] {
+            const auto& members = partitions[p];
+            std::vector<const DeviceFingerprint*> views;
+            views.reserve(members.size());
+            for (const auto* entry : members) {
+                views.push_back(&entry->second);
+            }
+
+            for (const auto& [i, j] : m_index.FindSimilarPairs(views)) {
+                const std::string& a = members[i]->first;
+                const std::string& b = members[j]->first;
+                found[p].emplace_back(std::min(a, b), std::max(a, b));
+            }
+            ++m_tasks_done;
+        });
+    }
+    m_pool.WaitIdle();
+
+    for (auto& pairs : found) {
+        std::move(pairs.begin(), pairs.end(), std::back_inserter(report.suspicious_pairs));
+    }
+    std::sort(report.suspicious_pairs.begin(), report.suspicious_pairs.end());
+    const auto similarity_done = Clock::now();
+
+    // Phase 3: re-verify every squad as a device set
+    auto squads = m_verifier.GetSquads();
+    std::vector<char> squad_failed(squads.size(), 0);
+
+    m_tasks_total += squads.size();
+    for (size_t k = 0; k < squads.size(); ++k) {
+        m_pool.Submit([this, &squads, &squad_failed, k] {
+            squad_failed[k] = m_verifier.DetectSpoofing(squads[k].second) ? 1 : 0;
+            ++m_tasks_done;
+        });
+    }
+    m_pool.WaitIdle();
+
+    for (size_t k = 0; k < squads.size(); ++k) {
+        if (squad_failed[k]) {
+            report.failed_squads.push_back(squads[k].first);
+        }
+    }
+    std::sort(report.failed_squads.begin(), report.failed_squads.end());
+    report.squads_audited = squads.size();
+    const auto done = Clock::now();
+
+    report.snapshot_time = Elapsed(start, snapshot_done);
+    report.similarity_time = Elapsed(snapshot_done, similarity_done);
+    report.squad_time = Elapsed(similarity_done, done);
+    report.total_time = Elapsed(start, done);
+    report.tasks_run = m_pool.GetTasksCompleted() - tasks_before;
+    report.tasks_stolen = m_pool.GetTasksStolen() - stolen_before;
+
+    return report;
+}
+
+} // namespace PoDD
@@ -0,0 +1,140 @@
+// Copyright (c) 2024 SyntheticCoin Developers
+// Distributed under the MIT software license
+
+#ifndef SYNC_PODD_SPOOFING_AUDITOR_H
+#define SYNC_PODD_SPOOFING_AUDITOR_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "device_verifier.h"
+#include "similarity_index.h"
+#include "thread_pool.h"
+
+namespace PoDD {
+
+/**
+ * Result of one whole-registry spoofing audit
+ */
+struct AuditReport {
+    uint32_t height = 0;                // Block height that triggered the audit
+    size_t devices_audited = 0;
+    size_t partitions = 0;
+    size_t squads_audited = 0;
+
+    // Findings, sorted
+    std::vector<std::pair<std::string, std::string>> suspicious_pairs;
+    std::vector<std::string> failed_squads;
+
+    // Changes since the previous audit
+    std::vector<std::pair<std::string, std::string>> new_pairs;
+    std::vector<std::pair<std::string, std::string>> cleared_pairs;
+
+    // Timings, for sizing the pool
+    std::chrono::microseconds snapshot_time{0};   // Copying fingerprints out of the registry
+    std::chrono::microseconds similarity_time{0}; // Pairwise similarity per partition
+    std::chrono::microseconds squad_time{0};      // Re-verifying every squad
+    std::chrono::microseconds total_time{0};
+    uint64_t tasks_run = 0;
+    uint64_t tasks_stolen = 0;
+};
+
+/**
+ * Live view of the auditor
+ */
+struct AuditProgress {
+    bool running = false;
+    uint32_t height = 0;            // Height of the running (or last) audit
+    size_t tasks_total = 0;         // Tasks scheduled so far in the running audit
+    size_t tasks_done = 0;
+    uint32_t audits_completed = 0;
+    size_t thread_count = 0;
+};
+
+/**
+ * Background re-verification of the whole device registry.
+ *
+ * Every Consensus::Params::PoDD::nVerificationInterval blocks the auditor
+ * re-checks every registered device for spoofing, without blocking share
+ * ingestion:
+ *  1. Snapshot: one task per registry shard copies that shard's fingerprints;
+ *     each shard is share-locked only while it is copied.
+ *  2. Similarity: devices are partitioned by IP address (only devices behind
+ *     the same IP can be flagged, see SimilarityIndex) and one task per
+ *     partition runs the similarity search.
+ *  3. Squads: every squad is re-verified as a device set.
+ * Tasks run on a work-stealing pool. The audit itself runs on a coordinator
+ * thread, so OnBlockConnected returns immediately; a trigger that arrives
+ * while an audit is still running is skipped rather than queued.
+ */
+class SpoofingAuditor {
+public:
+    /**
+     * @param verifier Registry to audit (must outlive the auditor)
+     * @param interval Blocks between audits
+     * @param thread_count Pool size (0 = one per hardware thread)
+     */
+    SpoofingAuditor(DeviceVerifier& verifier, uint32_t interval, size_t thread_count = 0);
+    ~SpoofingAuditor();
+
+    SpoofingAuditor(const SpoofingAuditor&) = delete;
+    SpoofingAuditor& operator=(const SpoofingAuditor&) = delete;
+
+    /**
+     * Notify the auditor of a new tip; starts an audit on interval boundaries
+     * @return True if an audit was started
+     */
+    bool OnBlockConnected(uint32_t height);
+
+    /**
+     * Start an audit now unless one is already running
+     * @return True if an audit was started
+     */
+    bool RequestAudit(uint32_t height);
+
+    /** Block until no audit is running or pending */
+    void WaitForIdle();
+
+    AuditProgress GetProgress() const;
+
+    /**
+     * Get the most recent completed report
+     * @return False if no audit has completed yet
+     */
+    bool GetLastReport(AuditReport& report) const;
+
+private:
+    void CoordinatorLoop();
+    AuditReport RunAudit(uint32_t height);
+
+    DeviceVerifier& m_verifier;
+    const uint32_t m_interval;
+    const SimilarityIndex m_index;
+    WorkStealingPool m_pool;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_stopping = false;
+    bool m_pending = false;         // Audit requested, coordinator not yet started it
+    bool m_running = false;
+    uint32_t m_pending_height = 0;
+    AuditReport m_last_report;
+    uint32_t m_audits_completed = 0;
+
+    std::atomic<uint32_t> m_current_height{0};
+    std::atomic<size_t> m_tasks_total{0};
+    std::atomic<size_t> m_tasks_done{0};
+
+    std::thread m_coordinator;
+};
+
+} // namespace PoDD
+
+#endif // SYNC_PODD_SPOOFING_AUDITOR_H
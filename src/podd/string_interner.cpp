@@ -0,0 +1,240 @@
+// Copyright (c) 2024 SyntheticCoin Developers
+// Distributed under the MIT software license
+
+#include "string_interner.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace PoDD {
+
+namespace {
+
+// Table size for a shard's first string
+constexpr size_t INITIAL_SLOTS = 16;
+
+// Entry of the empty string: a zero length and no bytes
+constexpr char EMPTY_ENTRY[sizeof(uint32_t)] = {};
+
+} // namespace
+
+StringInterner& StringInterner::Global() {
+    // Never destroyed, so handles stay readable from other static objects'
+    // destructors
+    static StringInterner* interner = new StringInterner();
+    return *interner;
+}
+
+StringInterner::StringInterner() {
+    const char** chunk = new const char*[CHUNK_SIZE];
+    chunk[EMPTY] = EMPTY_ENTRY;
+    m_entries[0].store(chunk, std::memory_order_release);
+    m_size.store(1, std::memory_order_relaxed);
+}
+
+StringInterner::~StringInterner() {
+    for (auto& chunk : m_entries) {
+        delete[] chunk.load(std::memory_order_relaxed);
+    }
+}
+
+StringInterner::Handle StringInterner::Intern(std::string_view s) {
+    if (s.empty()) return EMPTY;
+
+    uint64_t hash = Hash(s);
+    Shard& shard = m_shards[ShardOf(hash)];
+    size_t slot = 0;
+    size_t seen_used = 0;
+    size_t seen_slots = 0;
+    {
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        if (!shard.slots.empty()) {
+            slot = Probe(shard, s, hash);
+            if (shard.slots[slot].handle != EMPTY) return shard.slots[slot].handle;
+        }
+        seen_used = shard.used;
+        seen_slots = shard.slots.size();
+    }
+
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    if ((shard.used + 1) * 4 > shard.slots.size() * 3) {
+        Rehash(shard, shard.slots.empty() ? INITIAL_SLOTS : shard.slots.size() * 2);
+    }
+    // Entries are never removed, so unless a string was added or the table
+    // rehashed while we waited, the free slot found above is still s's place
+    if (shard.used != seen_used || shard.slots.size() != seen_slots) {
+        slot = Probe(shard, s, hash);
+        if (shard.slots[slot].handle != EMPTY) {
+            return shard.slots[slot].handle; // Added while we waited
+        }
+    }
+    return Add(shard, s, hash, slot);
+}
+
+void StringInterner::InternMany(const std::string_view* strings, size_t count, Handle* handles) {
+    // Bucket the strings by shard, keeping their order within each shard
+    std::vector<uint64_t> hashes(count);
+    std::array<size_t, SHARD_COUNT + 1> starts{};
+    for (size_t i = 0; i < count; ++i) {
+        hashes[i] = Hash(strings[i]);
+        ++starts[ShardOf(hashes[i]) + 1];
+    }
+    for (size_t shard = 0; shard < SHARD_COUNT; ++shard) {
+        starts[shard + 1] += starts[shard];
+    }
+    std::vector<size_t> order(count);
+    std::array<size_t, SHARD_COUNT> next;
+    std::copy(starts.begin(), starts.end() - 1, next.begin());
+    for (size_t i = 0; i < count; ++i) {
+        order[next[ShardOf(hashes[i])]++] = i;
+    }
+
+    for (size_t index = 0; index < SHARD_COUNT; ++index) {
+        if (starts[index] == starts[index + 1]) continue;
+
+        Shard& shard = m_shards[index];
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        for (size_t k = starts[index]; k < starts[index + 1]; ++k) {
+            size_t i = order[k];
+            if (strings[i].empty()) {
+                handles[i] = EMPTY;
+                continue;
+            }
+            if ((shard.used + 1) * 4 > shard.slots.size() * 3) {
+                Rehash(shard, shard.slots.empty() ? INITIAL_SLOTS : shard.slots.size() * 2);
+            }
+            size_t slot = Probe(shard, strings[i], hashes[i]);
+            handles[i] = shard.slots[slot].handle != EMPTY ? shard.slots[slot].handle
+                                                           : Add(shard, strings[i], hashes[i], slot);
+        }
+    }
+}
+
+bool StringInterner::Find(std::string_view s, Handle& handle) const {
+    if (s.empty()) {
+        handle = EMPTY;
+        return true;
+    }
+
+    uint64_t hash = Hash(s);
+    const Shard& shard = m_shards[ShardOf(hash)];
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    if (shard.slots.empty()) return false;
+    const Slot& slot = shard.slots[Probe(shard, s, hash)];
+    if (slot.handle == EMPTY) return false;
+    handle = slot.handle;
+    return true;
+}
+
+void StringInterner::Reserve(size_t count) {
+    // Strings spread evenly over the shards; allow for some imbalance
+    size_t per_shard = count / SHARD_COUNT + count / (SHARD_COUNT * 8) + 1;
+    for (Shard& shard : m_shards) {
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        size_t slots = std::max(shard.slots.size(), INITIAL_SLOTS);
+        while ((shard.used + per_shard) * 4 > slots * 3) {
+            slots *= 2;
+        }
+        if (slots != shard.slots.size()) {
+            Rehash(shard, slots);
+        }
+    }
+}
+
+size_t StringInterner::MemoryUsage() const {
+    size_t bytes = 0;
+    for (const Shard& shard : m_shards) {
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        bytes += shard.slots.capacity() * sizeof(Slot) + shard.bytes;
+    }
+    size_t chunks = (Size() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    return bytes + chunks * CHUNK_SIZE * sizeof(const char*);
+}
+
+size_t StringInterner::Probe(const Shard& shard, std::string_view s, uint64_t hash) const {
+    // Linear probing from the high half of the hash; the tag settles most
+    // mismatches without touching the string
+    size_t mask = shard.slots.size() - 1;
+    uint32_t tag = TagOf(hash);
+    size_t i = static_cast<size_t>(hash >> 32) & mask;
+    while (shard.slots[i].handle != EMPTY &&
+           (shard.slots[i].tag != tag || Get(shard.slots[i].handle) != s)) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+StringInterner::Handle StringInterner::Add(Shard& shard, std::string_view s, uint64_t hash,
+                                           size_t slot) {
+    if (s.size() > UINT32_MAX) {
+        throw std::length_error("StringInterner: string too long");
+    }
+    size_t index = m_size.fetch_add(1, std::memory_order_relaxed);
+    if (index >= CHUNK_COUNT * CHUNK_SIZE) {
+        m_size.fetch_sub(1, std::memory_order_relaxed);
+        throw std::length_error("StringInterner: handle space exhausted");
+    }
+
+    std::atomic<const char**>& chunk_slot = m_entries[index >> CHUNK_BITS];
+    const char** chunk = chunk_slot.load(std::memory_order_acquire);
+    if (!chunk) {
+        // Shards fill a chunk concurrently; the first to reach it allocates
+        std::lock_guard<std::mutex> lock(m_chunk_mutex);
+        chunk = chunk_slot.load(std::memory_order_relaxed);
+        if (!chunk) {
+            chunk = new const char*[CHUNK_SIZE];
+            chunk_slot.store(chunk, std::memory_order_release);
+        }
+    }
+
+    // Written before the handle is published in the shard, so anyone who
+    // obtains the handle sees the string
+    chunk[index & (CHUNK_SIZE - 1)] = Store(shard, s);
+    Handle handle = static_cast<Handle>(index);
+    shard.slots[slot] = Slot{TagOf(hash), handle};
+    ++shard.used;
+    return handle;
+}
+
+void StringInterner::Rehash(Shard& shard, size_t slots) {
+    std::vector<Slot> old;
+    old.swap(shard.slots);
+    shard.slots.assign(slots, Slot{0, EMPTY});
+
+    size_t mask = shard.slots.size() - 1;
+    for (const Slot& slot : old) {
+        if (slot.handle == EMPTY) continue;
+        size_t i = static_cast<size_t>(Hash(Get(slot.handle)) >> 32) & mask;
+        while (shard.slots[i].handle != EMPTY) {
+            i = (i + 1) & mask;
+        }
+        shard.slots[i] = slot;
+    }
+}
+
+const char* StringInterner::Store(Shard& shard, std::string_view s) {
+    uint32_t length = static_cast<uint32_t>(s.size());
+    size_t size = sizeof(length) + s.size();
+
+    char* entry;
+    if (size > BLOCK_SIZE / 4) {
+        // Long strings get a block of their own, so they waste no space
+        shard.blocks.emplace_back(new char[size]);
+        shard.bytes += size;
+        entry = shard.blocks.back().get();
+    } else {
+        if (!shard.block || shard.block_used + size > BLOCK_SIZE) {
+            shard.blocks.emplace_back(new char[BLOCK_SIZE]);
+            shard.bytes += BLOCK_SIZE;
+            shard.block = shard.blocks.back().get();
+            shard.block_used = 0;
+        }
+        entry = shard.block + shard.block_used;
+        shard.block_used += size;
+    }
+
+    std::memcpy(entry, &length, sizeof(length));
+    std::memcpy(entry + sizeof(length), s.data(), s.size());
+    return entry;
+}
+
+} // namespace PoDD
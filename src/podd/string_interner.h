@@ -0,0 +1,205 @@
+// Copyright (c) 2024 SyntheticCoin Developers
+// Distributed under the MIT software license
+
+#ifndef SYNC_PODD_STRING_INTERNER_H
+#define SYNC_PODD_STRING_INTERNER_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace PoDD {
+
+/**
+ * Append-only table mapping strings to dense 32-bit handles.
+ *
+ * Each distinct string is stored once and keeps its handle for the life of
+ * the process, so two handles are equal exactly when their strings are.
+ * Handle 0 is the empty string.
+ *
+ * Strings hash to one of SHARD_COUNT shards, each behind its own
+ * reader/writer lock. A shard keeps its strings' bytes, length-prefixed, in
+ * blocks that never move, plus an open-addressing table of
+ * {hash tag, handle} pairs. Get() takes no lock at all: it reads the
+ * string's address from a chunked handle table whose chunks never move
+ * either. A device ID of 20 characters costs about 50 bytes in total.
+ *
+ * Entries are never removed. The table grows with the number of distinct
+ * device IDs, IP addresses and firmware versions the node has seen, so only
+ * values from registered devices should be interned; plain lookups should go
+ * through Find().
+ */
+class StringInterner {
+public:
+    using Handle = uint32_t;
+
+    static constexpr Handle EMPTY = 0;
+
+    /** Table shared by every PoDD structure in the process */
+    static StringInterner& Global();
+
+    StringInterner();
+    ~StringInterner();
+
+    StringInterner(const StringInterner&) = delete;
+    StringInterner& operator=(const StringInterner&) = delete;
+
+    /** Handle of a string, adding it if it is new */
+    Handle Intern(std::string_view s);
+
+    /**
+     * Intern a batch: handles[i] becomes the handle of strings[i]. Shards are
+     * visited in turn, each locked once, so a bulk load probes one shard's
+     * table at a time instead of all of them at random.
+     */
+    void InternMany(const std::string_view* strings, size_t count, Handle* handles);
+
+    /**
+     * Handle of a string without adding it
+     * @return False if the string has never been interned
+     */
+    bool Find(std::string_view s, Handle& handle) const;
+
+    /** String of a handle returned by this table; valid for the table's life */
+    std::string_view Get(Handle handle) const {
+        const char* entry = m_entries[handle >> CHUNK_BITS].load(std::memory_order_acquire)
+                                [handle & (CHUNK_SIZE - 1)];
+        uint32_t length;
+        std::memcpy(&length, entry, sizeof(length));
+        return std::string_view(entry + sizeof(length), length);
+    }
+
+    /**
+     * Size the tables for about count more strings, so a bulk load does not
+     * rehash them a doubling at a time
+     */
+    void Reserve(size_t count);
+
+    /** Number of distinct strings, the empty string included */
+    size_t Size() const { return m_size.load(std::memory_order_relaxed); }
+
+    /** Bytes held by the shards and the handle table */
+    size_t MemoryUsage() const;
+
+private:
+    static constexpr size_t SHARD_COUNT = 64;
+    static constexpr uint32_t CHUNK_BITS = 16;
+    static constexpr size_t CHUNK_SIZE = size_t(1) << CHUNK_BITS;
+    static constexpr size_t CHUNK_COUNT = (size_t(1) << 32) / CHUNK_SIZE;
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    struct Slot {
+        uint32_t tag;                   // Low bits of the string's hash
+        Handle handle;                  // EMPTY marks a free slot
+    };
+
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mutex;
+        std::vector<Slot> slots;        // Power-of-two size, at most 3/4 full
+        size_t used = 0;
+        std::vector<std::unique_ptr<char[]>> blocks;
+        char* block = nullptr;          // Block short strings are appended to
+        size_t block_used = 0;
+        size_t bytes = 0;               // Block bytes allocated
+    };
+
+    static uint64_t Hash(std::string_view s) { return std::hash<std::string_view>{}(s); }
+    static size_t ShardOf(uint64_t hash) { return (hash ^ (hash >> 29)) % SHARD_COUNT; }
+    static uint32_t TagOf(uint64_t hash) { return static_cast<uint32_t>(hash); }
+
+    // Slot holding s, or the free slot where it would go; the caller holds
+    // the shard's lock
+    size_t Probe(const Shard& shard, std::string_view s, uint64_t hash) const;
+
+    // Store s under a new handle; the caller holds the shard exclusively
+    Handle Add(Shard& shard, std::string_view s, uint64_t hash, size_t slot);
+    // Move the shard's slots into a table of the given power-of-two size
+    void Rehash(Shard& shard, size_t slots);
+    const char* Store(Shard& shard, std::string_view s);
+
+    std::array<Shard, SHARD_COUNT> m_shards;
+    std::array<std::atomic<const char**>, CHUNK_COUNT> m_entries{};
+    std::mutex m_chunk_mutex;           // Serializes handle table chunk allocation
+    std::atomic<size_t> m_size{0};
+};
+
+/**
+ * A string held as its handle in the global StringInterner.
+ *
+ * Four bytes instead of a std::string, and equality is an integer compare.
+ * Building one from a string interns it, and interned strings are never
+ * freed, so the constructors are explicit: untrusted input stays a
+ * std::string, looked up with Find(), until it has been accepted. Ordering
+ * compares handles, which is consistent but not lexicographic.
+ */
+class InternedString {
+public:
+    InternedString() = default;
+    explicit InternedString(std::string_view s) : m_handle(StringInterner::Global().Intern(s)) {}
+    explicit InternedString(const std::string& s) : InternedString(std::string_view(s)) {}
+    explicit InternedString(const char* s) : InternedString(std::string_view(s)) {}
+
+    /** Intern a string, adding it to the table if it is new */
+    static InternedString Intern(std::string_view s) { return InternedString(s); }
+
+    /**
+     * Look up a string without interning it
+     * @return False if no InternedString of s has ever been made
+     */
+    static bool Find(std::string_view s, InternedString& out) {
+        return StringInterner::Global().Find(s, out.m_handle);
+    }
+
+    /** Intern a batch of strings; see StringInterner::InternMany() */
+    static void InternMany(const std::string_view* strings, size_t count, InternedString* out) {
+        std::vector<StringInterner::Handle> handles(count);
+        StringInterner::Global().InternMany(strings, count, handles.data());
+        for (size_t i = 0; i < count; ++i) {
+            out[i].m_handle = handles[i];
+        }
+    }
+
+    std::string_view View() const { return StringInterner::Global().Get(m_handle); }
+    std::string Str() const { return std::string(View()); }
+    explicit operator std::string() const { return Str(); }
+
+    bool Empty() const { return m_handle == StringInterner::EMPTY; }
+    StringInterner::Handle GetHandle() const { return m_handle; }
+
+    friend bool operator==(InternedString a, InternedString b) { return a.m_handle == b.m_handle; }
+    friend bool operator!=(InternedString a, InternedString b) { return a.m_handle != b.m_handle; }
+    friend bool operator<(InternedString a, InternedString b) { return a.m_handle < b.m_handle; }
+
+    // Comparing with a plain string never interns it
+    friend bool operator==(InternedString a, const std::string& b) { return a.View() == b; }
+    friend bool operator==(const std::string& a, InternedString b) { return a == b.View(); }
+    friend bool operator!=(InternedString a, const std::string& b) { return a.View() != b; }
+    friend bool operator!=(const std::string& a, InternedString b) { return a != b.View(); }
+
+private:
+    StringInterner::Handle m_handle = StringInterner::EMPTY;
+};
+
+} // namespace PoDD
+
+namespace std {
+template <>
+struct hash<PoDD::InternedString> {
+    size_t operator()(PoDD::InternedString s) const {
+        // Handles are sequential; multiply so they also spread over the
+        // high bits
+        return static_cast<size_t>(s.GetHandle() * 0x9E3779B97F4A7C15ULL);
+    }
+};
+} // namespace std
+
+#endif // SYNC_PODD_STRING_INTERNER_H
@@ -0,0 +1,124 @@
+// Copyright (c) 2024 SyntheticCoin Developers
+// Distributed under the MIT software license
+
+#include "thread_pool.h"
+#include <algorithm>
+
+namespace PoDD {
+
+WorkStealingPool::WorkStealingPool(size_t thread_count) {
+    if (thread_count == 0) {
+        thread_count = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+
+    m_queues.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        m_queues.push_back(std::make_unique<Queue>());
+    }
+
+    m_workers.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        m_workers.emplace_back([this, i] { WorkerLoop(i); });
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_work_cv.notify_all();
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+}
+
+void WorkStealingPool::Submit(Task task) {
+    size_t index = m_next_queue.fetch_add(1, std::memory_order_relaxed) % m_queues.size();
+
+    // Count the task before any worker can see it: a worker that pops and
+    // finishes it first would otherwise take both counters below zero and
+    // wake WaitIdle() while other tasks are still running
+    m_pending.fetch_add(1);
+    m_queued.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> queue_lock(m_queues[index]->mutex);
+        m_queues[index]->tasks.push_back(std::move(task));
+    }
+
+    // A worker counts itself sleeping before it checks m_queued, and both
+    // sides use sequentially consistent operations, so either this sees the
+    // sleeper or the sleeper sees the task. Taking m_mutex makes sure a
+    // sleeper seen here is already waiting when it is notified.
+    if (m_sleeping.load() > 0) {
+        { std::lock_guard<std::mutex> lock(m_mutex); }
+        m_work_cv.notify_one();
+    }
+}
+
+void WorkStealingPool::WaitIdle() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle_cv.wait(lock, [this] { return m_pending.load() == 0; });
+}
+
+bool WorkStealingPool::TryPopLocal(size_t index, Task& task) {
+    Queue& queue = *m_queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) {
+        return false;
+    }
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    return true;
+}
+
+bool WorkStealingPool::TrySteal(size_t thief, Task& task) {
+    for (size_t offset = 1; offset < m_queues.size(); ++offset) {
+        Queue& victim = *m_queues[(thief + offset) % m_queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            m_stolen.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::WorkerLoop(size_t index) {
+    while (true) {
+        Task task;
+        if (TryPopLocal(index, task) || TrySteal(index, task)) {
+            m_queued.fetch_sub(1);
+
+            try {
+                task();
+            } catch (...) {
+                // A failing task must not take the worker down with it
+            }
+            m_completed.fetch_add(1, std::memory_order_relaxed);
+
+            // Only the last task out wakes WaitIdle(); the lock orders this
+            // against a waiter that has checked m_pending but not yet slept
+            if (m_pending.fetch_sub(1) == 1) {
+                { std::lock_guard<std::mutex> lock(m_mutex); }
+                m_idle_cv.notify_all();
+            }
+            continue;
+        }
+
+        // Nothing to run anywhere: sleep until a submit or shutdown. Queued
+        // work is drained before a stopping worker exits. A task counted in
+        // m_queued but not pushed yet is retried until it lands.
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_sleeping.fetch_add(1);
+        m_work_cv.wait(lock, [this] { return m_stopping || m_queued.load() > 0; });
+        m_sleeping.fetch_sub(1);
+        if (m_stopping && m_queued.load() == 0) {
+            return;
+        }
+    }
+}
+
+} // namespace PoDD
@@ -0,0 +1,85 @@
+// Copyright (c) 2024 SyntheticCoin Developers
+// Distributed under the MIT software license
+
+#ifndef SYNC_PODD_THREAD_POOL_H
+#define SYNC_PODD_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace PoDD {
+
+/**
+ * Fixed-size thread pool with per-worker task queues and work stealing.
+ *
+ * Submitted tasks are dealt round-robin onto the workers' own queues. A
+ * worker pops from the back of its queue (most recently pushed, still warm in
+ * cache) and, once that is empty, steals from the front of the other queues,
+ * so a partition that turns out to be expensive does not leave the rest of
+ * the pool idle.
+ */
+class WorkStealingPool {
+public:
+    using Task = std::function<void()>;
+
+    /**
+     * @param thread_count Number of workers (0 = one per hardware thread)
+     */
+    explicit WorkStealingPool(size_t thread_count = 0);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    void Submit(Task task);
+
+    /** Block until every submitted task has finished */
+    void WaitIdle();
+
+    size_t GetThreadCount() const { return m_workers.size(); }
+
+    /** Tasks completed since construction */
+    uint64_t GetTasksCompleted() const { return m_completed.load(std::memory_order_relaxed); }
+
+    /** Tasks that ran on a worker other than the one they were queued on */
+    uint64_t GetTasksStolen() const { return m_stolen.load(std::memory_order_relaxed); }
+
+private:
+    struct alignas(64) Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void WorkerLoop(size_t index);
+    bool TryPopLocal(size_t index, Task& task);
+    bool TrySteal(size_t thief, Task& task);
+
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread> m_workers;
+
+    // Taken only to sleep and to wake a sleeper: submitting and finishing a
+    // task touch the atomic counters alone unless a thread is waiting
+    std::mutex m_mutex;
+    std::condition_variable m_work_cv;
+    std::condition_variable m_idle_cv;
+    std::atomic<size_t> m_queued{0};    // Submitted but not yet picked up
+    std::atomic<size_t> m_pending{0};   // Submitted but not yet finished
+    std::atomic<size_t> m_sleeping{0};  // Workers in, or about to enter, m_work_cv
+    bool m_stopping = false;            // Guarded by m_mutex
+
+    std::atomic<size_t> m_next_queue{0};
+    std::atomic<uint64_t> m_completed{0};
+    std::atomic<uint64_t> m_stolen{0};
+};
+
+} // namespace PoDD
+
+#endif // SYNC_PODD_THREAD_POOL_H
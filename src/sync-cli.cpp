@@ -1,14 +1,34 @@
 // Copyright (c) 2024 SyntheticCoin Developers
 // Distributed under the MIT software license
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 #include <boost/program_options.hpp>
 #include <boost/format.hpp>
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+#include <sys/resource.h>
 
 #include "consensus/params.h"
 #include "podd/device_verifier.h"
+#include "podd/ring_buffer.h"
+#include "podd/similarity_index.h"
+#include "podd/thread_pool.h"
+#include "mining/network_metrics.h"
 #include "mining/reward_calculator.h"
 
 namespace po = boost::program_options;
@@ -64,6 +84,16 @@ private:
         std::cout << "  calcrweard <hashrate>      Calculate reward for hashrate" << std::endl;
         std::cout << "  formsquad <devices...>     Form a mining squad" << std::endl;
         std::cout << "  getdecentralization        Get network decentralization score" << std::endl;
+        std::cout << "  benchstore [devices]       Time concurrent share updates against thread count" << std::endl;
+        std::cout << "  benchwindow [shares]       Time per-share sample window updates, ring buffer vs vector" << std::endl;
+        std::cout << "  benchsimilarity [devices]  Check the similarity index against the pairwise loop" << std::endl;
+        std::cout << "  benchregistry [readers]    Stress concurrent registrations, transfers and reads" << std::endl;
+        std::cout << "  benchreward [miners]       Time per-miner vs batched reward calculation" << std::endl;
+        std::cout << "  benchsoak [rewards]        Record rewards and report memory as they accumulate" << std::endl;
+        std::cout << "  benchregister [devices]    Time batch registration against thread count" << std::endl;
+        std::cout << "  benchverify [devices]      Time device set verification on cache hits and misses" << std::endl;
+        std::cout << "  benchsubsidy [threads]     Check concurrent subsidy lookups against the halving formula" << std::endl;
+        std::cout << "  benchmetrics [blocks]      Time per-block network metric updates, with reorgs" << std::endl;
         std::cout << std::endl;
         std::cout << "Examples:" << std::endl;
         std::cout << "  sync-cli getinfo" << std::endl;
@@ -110,6 +140,40 @@ private:
             FormSquad(args);
         } else if (command == "getdecentralization") {
             GetDecentralization();
+        } else if (command == "benchstore") {
+            size_t devices = args.empty() ? 20000 : std::stoul(args[0]);
+            size_t updates = args.size() < 2 ? 400000 : std::stoul(args[1]);
+            BenchStore(devices, updates);
+        } else if (command == "benchwindow") {
+            size_t shares = args.empty() ? 2000000 : std::stoul(args[0]);
+            BenchWindow(shares);
+        } else if (command == "benchsimilarity") {
+            size_t devices = args.empty() ? 100000 : std::stoul(args[0]);
+            BenchSimilarity(devices);
+        } else if (command == "benchregistry") {
+            size_t readers = args.empty() ? 4 : std::stoul(args[0]);
+            size_t devices = args.size() < 2 ? 2000 : std::stoul(args[1]);
+            BenchRegistry(readers, devices);
+        } else if (command == "benchreward") {
+            size_t miners = args.empty() ? 50000 : std::stoul(args[0]);
+            BenchReward(miners);
+        } else if (command == "benchsoak") {
+            size_t rewards = args.empty() ? 10000000 : std::stoul(args[0]);
+            BenchSoak(rewards);
+        } else if (command == "benchregister") {
+            size_t devices = args.empty() ? 2000 : std::stoul(args[0]);
+            BenchRegister(devices);
+        } else if (command == "benchverify") {
+            size_t devices = args.empty() ? 8 : std::stoul(args[0]);
+            size_t calls = args.size() < 2 ? 20000 : std::stoul(args[1]);
+            BenchVerify(devices, calls);
+        } else if (command == "benchsubsidy") {
+            size_t threads = args.empty() ? 8 : std::stoul(args[0]);
+            size_t calls = args.size() < 2 ? 1000000 : std::stoul(args[1]);
+            BenchSubsidy(threads, calls);
+        } else if (command == "benchmetrics") {
+            size_t blocks = args.empty() ? 100000 : std::stoul(args[0]);
+            BenchMetrics(blocks);
         } else {
             std::cerr << "Unknown command: " << command << std::endl;
             std::cerr << "Use 'sync-cli help' for list of commands" << std::endl;
@@ -168,6 +232,12 @@ private:
         reg.max_hashrate_ghs = 500; // 500 GH/s typical
         reg.owner_address = "sync1qexample...";
         
+        KeyPtr key = GenerateKey();
+        if (!key || !SignRegistration(reg, key.get())) {
+            std::cerr << "Failed to sign device registration" << std::endl;
+            return;
+        }
+        
         if (PoDD::DeviceRegistry::GetInstance().RegisterDevice(reg)) {
             std::cout << "Device registered successfully!" << std::endl;
             std::cout << "Device ID: " << device_id << std::endl;
@@ -178,6 +248,51 @@ private:
         }
     }
     
+    using KeyPtr = std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)>;
+    
+    /** A fresh secp256k1 key (would be the owner's wallet key); null on failure */
+    static KeyPtr GenerateKey() {
+        std::unique_ptr<EVP_PKEY_CTX, decltype(&EVP_PKEY_CTX_free)> keygen(
+            EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr), EVP_PKEY_CTX_free);
+        EVP_PKEY* raw_key = nullptr;
+        if (!keygen || EVP_PKEY_keygen_init(keygen.get()) != 1 ||
+            EVP_PKEY_CTX_set_ec_paramgen_curve_nid(keygen.get(), NID_secp256k1) != 1 ||
+            EVP_PKEY_keygen(keygen.get(), &raw_key) != 1) {
+            return KeyPtr(nullptr, EVP_PKEY_free);
+        }
+        return KeyPtr(raw_key, EVP_PKEY_free);
+    }
+    
+    /** Set a registration's owner key to key and sign it */
+    static bool SignRegistration(PoDD::DeviceRegistration& reg, EVP_PKEY* key) {
+        // The SEC1 point is the tail of the DER SubjectPublicKeyInfo
+        unsigned char* der = nullptr;
+        int der_size = i2d_PUBKEY(key, &der);
+        if (der_size < 65) {
+            OPENSSL_free(der);
+            return false;
+        }
+        reg.owner_pubkey.assign(der + der_size - 65, der + der_size);
+        OPENSSL_free(der);
+        
+        std::string message = reg.GetSigningMessage();
+        std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> context(EVP_MD_CTX_new(), EVP_MD_CTX_free);
+        size_t signature_size = 0;
+        if (!context ||
+            EVP_DigestSignInit(context.get(), nullptr, EVP_sha256(), nullptr, key) != 1 ||
+            EVP_DigestSign(context.get(), nullptr, &signature_size,
+                           reinterpret_cast<const unsigned char*>(message.data()), message.size()) != 1) {
+            return false;
+        }
+        reg.signature.resize(signature_size);
+        if (EVP_DigestSign(context.get(), reg.signature.data(), &signature_size,
+                           reinterpret_cast<const unsigned char*>(message.data()), message.size()) != 1) {
+            return false;
+        }
+        reg.signature.resize(signature_size);
+        return true;
+    }
+    
     void ListDevices() {
         auto& registry = PoDD::DeviceRegistry::GetInstance();
         uint32_t total = registry.GetTotalRegisteredDevices();
@@ -206,10 +321,10 @@ private:
         // Register devices for verification (in real impl, would check existing)
         for (const auto& device_id : devices) {
             PoDD::DeviceFingerprint fp;
-            fp.device_id = device_id;
+            fp.device_id = PoDD::InternedString::Intern(device_id);
             fp.avg_nonce_time_us = 1000000 + (rand() % 100000); // Simulate variation
             fp.timing_variance_us = 5000 + (rand() % 5000);
-            fp.ip_address = "192.168.1." + std::to_string(rand() % 255);
+            fp.ip_address = PoDD::InternedString::Intern("192.168.1." + std::to_string(rand() % 255));
             
             verifier.RegisterDevice(device_id, fp);
         }
@@ -314,6 +429,390 @@ private:
         std::cout << "  • Community support" << std::endl;
     }
     
+    void BenchReward(size_t miner_count) {
+        if (miner_count == 0) {
+            std::cerr << "Error: Miner count must be positive" << std::endl;
+            return;
+        }
+        
+        Consensus::Params params;
+        Mining::RewardCalculator calculator(params);
+        const int32_t height = 5000;    // Every feature active
+        const int64_t tx_fees = 25000;
+        
+        // A pool's worth of miners spread over all tiers
+        std::mt19937_64 rng(42);
+        std::vector<Mining::MinerInfo> miners(miner_count);
+        for (auto& miner : miners) {
+            miner.hashrate_ths = std::exp2(std::uniform_real_distribution<double>(-4.0, 8.0)(rng));
+            miner.is_podd_verified = rng() % 4 != 0;
+            miner.device_ids.resize(rng() % 12);
+            miner.is_squad_member = false;
+            miner.efficiency_score = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+            miner.consecutive_blocks = rng() % 8;
+            miner.total_shares_submitted = rng() % 100000;
+        }
+        
+        std::vector<Mining::RewardBreakdown> single(miner_count);
+        std::vector<Mining::RewardBreakdown> batch(miner_count);
+        auto time_runs = [&](const std::function<void()>& run) {
+            const int runs = 5;
+            run(); // Warm up
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < runs; ++i) {
+                run();
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            return runs * miner_count / elapsed.count();
+        };
+        
+        double single_rate = time_runs([&] {
+            for (size_t i = 0; i < miner_count; ++i) {
+                single[i] = calculator.CalculateReward(height, miners[i], tx_fees);
+            }
+        });
+        double batch_rate = time_runs([&] {
+            calculator.CalculateRewardBatch(height, miners.data(), miner_count, tx_fees, batch.data());
+        });
+        
+        size_t mismatches = 0;
+        for (size_t i = 0; i < miner_count; ++i) {
+            const auto& a = single[i];
+            const auto& b = batch[i];
+            if (a.base_reward != b.base_reward || a.small_miner_bonus != b.small_miner_bonus ||
+                a.podd_bonus != b.podd_bonus || a.efficiency_bonus != b.efficiency_bonus ||
+                a.squad_bonus != b.squad_bonus || a.total_reward != b.total_reward ||
+                a.community_fund != b.community_fund || a.development_fund != b.development_fund ||
+                a.miner_fees != b.miner_fees) {
+                ++mismatches;
+            }
+        }
+        
+        std::cout << "Reward Calculation Benchmark" << std::endl;
+        std::cout << "============================" << std::endl;
+        std::cout << "Miners: " << miner_count << std::endl;
+        std::cout << "Per-miner: " << boost::format("%12.0f miners/s") % single_rate << std::endl;
+        std::cout << "Batch:     " << boost::format("%12.0f miners/s") % batch_rate << std::endl;
+        std::cout << "Speedup:   " << boost::format("%.2fx") % (batch_rate / single_rate) << std::endl;
+        std::cout << "Mismatched breakdowns: " << mismatches << std::endl;
+    }
+    
+    void BenchRegister(size_t device_count) {
+        if (device_count == 0) {
+            std::cerr << "Error: Device count must be positive" << std::endl;
+            return;
+        }
+        
+        // One owner onboarding a fleet; signing is not part of the timing
+        KeyPtr key = GenerateKey();
+        if (!key) {
+            std::cerr << "Failed to generate owner key" << std::endl;
+            return;
+        }
+        std::vector<PoDD::DeviceRegistration> fleet(device_count);
+        for (size_t i = 0; i < device_count; ++i) {
+            auto& reg = fleet[i];
+            std::string device_id = "BENCH_" + std::to_string(i);
+            reg.device_id = device_id;
+            reg.manufacturer = "Bitaxe";
+            reg.model = "Gamma";
+            reg.serial_number = device_id;
+            reg.firmware_version = "2.1.0";
+            reg.chip_count = 1;
+            reg.max_hashrate_ghs = 1200;
+            reg.owner_address = "sync1qbenchfleet";
+            if (!SignRegistration(reg, key.get())) {
+                std::cerr << "Failed to sign device registration" << std::endl;
+                return;
+            }
+        }
+        
+        auto& registry = PoDD::DeviceRegistry::GetInstance();
+        size_t max_threads = std::max<size_t>(4, std::thread::hardware_concurrency());
+        
+        std::cout << "Batch Registration Benchmark" << std::endl;
+        std::cout << "============================" << std::endl;
+        std::cout << "Devices: " << device_count << std::endl;
+        std::cout << "Hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+        std::cout << std::endl;
+        std::cout << "Threads  Registrations/s  Speedup" << std::endl;
+        
+        double serial_rate = 0;
+        for (size_t threads = 0; threads <= max_threads; threads = threads == 0 ? 1 : threads * 2) {
+            // Thread count 0 verifies on the calling thread
+            std::unique_ptr<PoDD::WorkStealingPool> pool;
+            if (threads > 0) {
+                pool = std::make_unique<PoDD::WorkStealingPool>(threads);
+            }
+            registry.Restore({}, 0);
+            
+            auto start = std::chrono::steady_clock::now();
+            auto result = registry.RegisterDevices(fleet, pool.get());
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            
+            if (!result.committed || registry.GetTotalRegisteredDevices() != device_count) {
+                std::cerr << "Batch not committed: " << result.reason << std::endl;
+                return;
+            }
+            double rate = device_count / elapsed.count();
+            if (threads == 0) {
+                serial_rate = rate;
+            }
+            std::cout << boost::format("%7s  %15.0f  %6.2fx") %
+                         (threads == 0 ? std::string("caller") : std::to_string(threads)) %
+                         rate % (rate / serial_rate) << std::endl;
+        }
+    }
+    
+    void BenchVerify(size_t device_count, size_t calls) {
+        if (device_count < 2 || calls == 0) {
+            std::cerr << "Error: Need at least 2 devices and a call" << std::endl;
+            return;
+        }
+        
+        // A genuine fleet: distinct addresses, timings and power draw, with
+        // a full window of irregular shares each
+        PoDD::DeviceVerifier verifier;
+        std::mt19937_64 rng(7);
+        std::vector<std::string> device_ids;
+        std::vector<PoDD::ShareData> shares(device_count);
+        for (size_t i = 0; i < device_count; ++i) {
+            std::string device_id = "VERIFY_" + std::to_string(i);
+            PoDD::DeviceFingerprint fp{};
+            fp.device_id = PoDD::InternedString::Intern(device_id);
+            fp.avg_nonce_time_us = 500000 + 100000 * i;
+            fp.timing_variance_us = 5000 + 7000 * i;
+            fp.ip_address = PoDD::InternedString::Intern("10.7.0." + std::to_string(i % 250));
+            fp.avg_latency_ms = static_cast<uint32_t>(20 + 15 * i);
+            fp.firmware_version = PoDD::InternedString::Intern("2.1.0");
+            fp.chip_count = 1;
+            fp.power_consumption_watts = 12.0 + 4.0 * i;
+            verifier.RegisterDevice(device_id, fp);
+            device_ids.push_back(device_id);
+            
+            auto& share = shares[i];
+            share.device_id = device_id;
+            share.difficulty = 1;
+            share.hashrate = 1200;
+            share.temperature = 55;
+            share.power_watts = fp.power_consumption_watts;
+            share.latency_ms = fp.avg_latency_ms;
+        }
+        // Share timings spread widely, as independent hardware gives
+        auto send_share = [&](size_t i) {
+            shares[i].timestamp_us = 1000 + rng() % 2000000;
+            shares[i].nonce = rng();
+            verifier.UpdateDeviceFingerprint(device_ids[i], shares[i]);
+        };
+        for (size_t n = 0; n < 16 * device_count; ++n) {
+            send_share(n % device_count);
+        }
+        
+        // Warm up the per-thread buffers and the set's cache entry
+        auto expected = verifier.VerifyDeviceDistribution(device_ids);
+        
+        // Only the verification calls are timed; a miss is forced by a share
+        // that bumps one member's generation
+        auto measure = [&](bool miss, size_t& mismatched) {
+            std::chrono::duration<double> elapsed{0};
+            for (size_t n = 0; n < calls; ++n) {
+                if (miss) {
+                    send_share(n % device_count);
+                }
+                auto start = std::chrono::steady_clock::now();
+                auto result = verifier.VerifyDeviceDistribution(device_ids);
+                elapsed += std::chrono::steady_clock::now() - start;
+                mismatched += result.is_valid != expected.is_valid;
+            }
+            return elapsed.count() * 1e6 / calls;
+        };
+        size_t mismatched = 0;
+        auto hit = measure(false, mismatched);
+        auto before = verifier.GetVerificationCacheStats();
+        auto miss = measure(true, mismatched);
+        auto after = verifier.GetVerificationCacheStats();
+        
+        std::cout << "Verification Benchmark" << std::endl;
+        std::cout << "======================" << std::endl;
+        std::cout << "Devices: " << device_count << ", calls: " << calls << " per case" << std::endl;
+        std::cout << "Set is " << (expected.is_valid ? "valid" : "invalid: " + expected.reason) << std::endl;
+        std::cout << "Cache hit:  " << boost::format("%8.2f us/call") % hit << std::endl;
+        std::cout << "Cache miss: " << boost::format("%8.2f us/call") % miss << std::endl;
+        std::cout << "Misses counted: " << after.misses - before.misses << " of " << calls << std::endl;
+        std::cout << "Mismatched results: " << mismatched << std::endl;
+    }
+    
+    void BenchSubsidy(size_t thread_count, size_t calls_per_thread) {
+        if (thread_count == 0) {
+            std::cerr << "Error: Thread count must be positive" << std::endl;
+            return;
+        }
+        
+        Consensus::Params params;
+        Mining::RewardCalculator calculator(params);
+        // Cover every epoch of the schedule and a few past its end
+        const int32_t max_height = (static_cast<int32_t>(Consensus::SUBSIDY_EPOCHS) + 4) *
+                                   params.nSubsidyHalvingInterval;
+        
+        // The halving formula, shifting the initial subsidy once per epoch
+        auto expected = [&](int32_t height) -> int64_t {
+            int32_t halvings = height / params.nSubsidyHalvingInterval;
+            return halvings >= 64 ? 0 : params.nInitialSubsidy >> halvings;
+        };
+        
+        std::atomic<size_t> mismatches{0};
+        std::vector<std::thread> threads;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t t = 0; t < thread_count; ++t) {
+            threads.emplace_back([&, t] {
+                std::mt19937 rng(static_cast<uint32_t>(t + 1));
+                std::uniform_int_distribution<int32_t> heights(0, max_height);
+                size_t local = 0;
+                for (size_t i = 0; i < calls_per_thread; ++i) {
+                    int32_t height = heights(rng);
+                    local += calculator.GetBaseSubsidy(height) != expected(height);
+                }
+                mismatches += local;
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        
+        std::cout << "Subsidy Stress Test" << std::endl;
+        std::cout << "===================" << std::endl;
+        std::cout << "Threads: " << thread_count << std::endl;
+        std::cout << "Lookups: " << thread_count * calls_per_thread << " at heights 0-" << max_height << std::endl;
+        std::cout << "Rate:    " << boost::format("%.0f lookups/s") %
+                                    (thread_count * calls_per_thread / elapsed.count()) << std::endl;
+        std::cout << "Mismatched subsidies: " << mismatches << std::endl;
+    }
+    
+    void BenchMetrics(size_t block_count) {
+        if (block_count == 0) {
+            std::cerr << "Error: Block count must be positive" << std::endl;
+            return;
+        }
+        using Mining::NetworkMetrics;
+        
+        // Producers from small to large, a few of them mining most blocks
+        Consensus::Params params;
+        std::mt19937_64 rng(25);
+        const size_t producer_count = 10000;
+        std::vector<Mining::MinerInfo> producers(producer_count);
+        for (size_t i = 0; i < producer_count; ++i) {
+            auto& producer = producers[i];
+            producer.address = "sync1qproducer" + std::to_string(i);
+            producer.hashrate_ths = std::exp2(std::uniform_real_distribution<double>(-4.0, 8.0)(rng));
+            producer.is_podd_verified = rng() % 3 != 0;
+            for (size_t d = rng() % 12; d > 0; --d) {
+                producer.device_ids.emplace_back("BENCH_" + std::to_string(i) + "_" + std::to_string(d));
+            }
+        }
+        auto pick = [&] {
+            std::uniform_int_distribution<size_t> any(0, producer_count - 1);
+            return std::min({any(rng), any(rng), any(rng)});
+        };
+        
+        // The blocks the metrics should hold, rebuilt from scratch to check them
+        std::deque<size_t> window;
+        auto rebuild = [&] {
+            std::unordered_map<std::string, uint32_t> blocks_by;
+            std::unordered_map<PoDD::InternedString, uint32_t> devices;
+            NetworkMetrics::Snapshot s = {};
+            for (size_t index : window) {
+                const auto& producer = producers[index];
+                ++blocks_by[producer.address];
+                double hashrate = producer.hashrate_ths;
+                ++s.tier_blocks[(hashrate >= params.minerBoost.tier1_hashrate) +
+                                (hashrate >= params.minerBoost.tier2_hashrate) +
+                                (hashrate >= params.minerBoost.tier3_hashrate)];
+                s.small_miner_blocks += hashrate < Mining::RewardHistory::SMALL_MINER_THS;
+                if (producer.is_podd_verified) {
+                    ++s.verified_blocks;
+                    for (const auto& device : producer.device_ids) {
+                        ++devices[device];
+                    }
+                }
+            }
+            s.blocks = static_cast<uint32_t>(window.size());
+            s.producers = static_cast<uint32_t>(blocks_by.size());
+            s.active_verified_devices = static_cast<uint32_t>(devices.size());
+            uint32_t top = 0;
+            uint64_t sum_squares = 0;
+            for (const auto& entry : blocks_by) {
+                top = std::max(top, entry.second);
+                sum_squares += static_cast<uint64_t>(entry.second) * entry.second;
+            }
+            if (s.blocks > 0) {
+                s.top_producer_share = static_cast<double>(top) / s.blocks;
+                s.herfindahl_index = static_cast<double>(sum_squares) / (static_cast<double>(s.blocks) * s.blocks);
+            }
+            return s;
+        };
+        
+        NetworkMetrics metrics(params);
+        int32_t height = -1;
+        size_t disconnects = 0;
+        size_t checks = 0;
+        size_t mismatches = 0;
+        double score_sum = 0;
+        std::chrono::duration<double> update_time{0};
+        std::chrono::duration<double> rebuild_time{0};
+        
+        for (size_t n = 0; n < block_count; ++n) {
+            // Now and then a reorg takes a few blocks off the tip first
+            size_t depth = rng() % 500 == 0 ? 1 + rng() % 6 : 0;
+            size_t index = pick();
+            auto start = std::chrono::steady_clock::now();
+            for (size_t d = 0; d < depth && height >= 0; ++d) {
+                metrics.OnBlockDisconnected(height--);
+            }
+            metrics.OnBlockConnected(++height, producers[index]);
+            score_sum += metrics.GetDecentralizationScore();
+            update_time += std::chrono::steady_clock::now() - start;
+            
+            for (size_t d = 0; d < depth && !window.empty(); ++d) {
+                window.pop_back();
+                ++disconnects;
+            }
+            window.push_back(index);
+            if (window.size() > NetworkMetrics::WINDOW) {
+                window.pop_front();
+            }
+            
+            if (n % 97 == 0 || n + 1 == block_count) {
+                auto rebuild_start = std::chrono::steady_clock::now();
+                NetworkMetrics::Snapshot expected = rebuild();
+                rebuild_time += std::chrono::steady_clock::now() - rebuild_start;
+                
+                NetworkMetrics::Snapshot actual = metrics.GetSnapshot();
+                ++checks;
+                if (actual.blocks != expected.blocks || actual.producers != expected.producers ||
+                    actual.top_producer_share != expected.top_producer_share ||
+                    std::abs(actual.herfindahl_index - expected.herfindahl_index) > 1e-12 ||
+                    actual.active_verified_devices != expected.active_verified_devices ||
+                    actual.verified_blocks != expected.verified_blocks ||
+                    actual.small_miner_blocks != expected.small_miner_blocks ||
+                    actual.tier_blocks != expected.tier_blocks) {
+                    ++mismatches;
+                }
+            }
+        }
+        
+        std::cout << "Network Metrics Benchmark" << std::endl;
+        std::cout << "=========================" << std::endl;
+        std::cout << "Blocks: " << block_count << " from " << producer_count << " producers, "
+                  << disconnects << " disconnected by reorgs" << std::endl;
+        std::cout << "Update and score: " << boost::format("%8.0f ns/block") %
+                     (update_time.count() * 1e9 / block_count) << std::endl;
+        std::cout << "Window rescan:    " << boost::format("%8.0f ns/block") %
+                     (rebuild_time.count() * 1e9 / checks) << std::endl;
+        std::cout << "Mean score: " << boost::format("%.4f") % (score_sum / block_count) << std::endl;
+        std::cout << "Mismatched snapshots: " << mismatches << " of " << checks << std::endl;
+    }
+    
     void GetDecentralization() {
         Mining::RewardCalculator calculator(Consensus::Params{});
         double score = calculator.CalculateDecentralizationScore();
@@ -343,6 +842,594 @@ private:
             std::cout << "Status: WARNING - High centralization risk" << std::endl;
         }
     }
+    
+    void BenchStore(size_t device_count, size_t update_count) {
+        if (device_count < 8 || update_count == 0) {
+            std::cerr << "Error: Need at least 8 devices and an update" << std::endl;
+            return;
+        }
+        
+        std::vector<std::string> device_ids;
+        for (size_t i = 0; i < device_count; ++i) {
+            device_ids.push_back("STORE_" + std::to_string(i));
+        }
+        size_t max_threads = std::max<size_t>(8, std::thread::hardware_concurrency());
+        
+        std::cout << "Device Store Contention Benchmark" << std::endl;
+        std::cout << "=================================" << std::endl;
+        std::cout << "Devices: " << device_count << ", updates: " << update_count << " per run" << std::endl;
+        std::cout << "Hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+        std::cout << "One more thread verifies random 8-device sets throughout" << std::endl;
+        std::cout << std::endl;
+        std::cout << "Threads  Updates/s  Speedup  Verifications" << std::endl;
+        
+        size_t mismatches = 0;
+        double serial_rate = 0;
+        for (size_t thread_count = 1; thread_count <= max_threads; thread_count *= 2) {
+            PoDD::DeviceVerifier verifier;
+            for (const auto& device_id : device_ids) {
+                verifier.RegisterDevice(device_id, PoDD::DeviceFingerprint{});
+            }
+            
+            std::atomic<bool> stop{false};
+            std::atomic<size_t> verifications{0};
+            std::thread checker([&] {
+                std::mt19937_64 rng(1);
+                std::vector<std::string> set(8);
+                size_t local = 0;
+                while (!stop.load(std::memory_order_acquire)) {
+                    for (auto& device_id : set) {
+                        device_id = device_ids[rng() % device_count];
+                    }
+                    verifier.VerifyDeviceDistribution(set);
+                    ++local;
+                }
+                verifications = local;
+            });
+            
+            // Updater t owns the devices numbered t modulo the thread count,
+            // so the devices are private but their shards are shared. Each
+            // share reports how many the device has sent, which the device's
+            // hashrate must show once the run is over.
+            std::vector<uint32_t> sent(device_count);
+            std::vector<std::thread> threads;
+            auto start = std::chrono::steady_clock::now();
+            for (size_t t = 0; t < thread_count; ++t) {
+                threads.emplace_back([&, t] {
+                    std::mt19937_64 rng(t + 2);
+                    const size_t owned = (device_count - t + thread_count - 1) / thread_count;
+                    PoDD::ShareData share{};
+                    share.difficulty = 1;
+                    for (size_t n = t; n < update_count; n += thread_count) {
+                        size_t device = t + (rng() % owned) * thread_count;
+                        share.nonce = rng();
+                        share.timestamp_us = 1000 + rng() % 2000000;
+                        share.hashrate = ++sent[device];
+                        verifier.UpdateDeviceFingerprint(device_ids[device], share);
+                    }
+                });
+            }
+            for (auto& thread : threads) {
+                thread.join();
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            stop.store(true, std::memory_order_release);
+            checker.join();
+            
+            for (size_t i = 0; i < device_count; ++i) {
+                mismatches += verifier.GetDeviceHashrate(device_ids[i]) != sent[i];
+            }
+            
+            double rate = update_count / elapsed.count();
+            if (thread_count == 1) {
+                serial_rate = rate;
+            }
+            std::cout << boost::format("%7d  %9.0f  %6.2fx  %13d") % thread_count % rate %
+                         (rate / serial_rate) % verifications << std::endl;
+        }
+        std::cout << std::endl;
+        std::cout << "Mismatched device hashrates: " << mismatches << std::endl;
+    }
+    
+    void BenchWindow(size_t share_count) {
+        if (share_count == 0) {
+            std::cerr << "Error: Share count must be positive" << std::endl;
+            return;
+        }
+        
+        std::cout << "Sample Window Benchmark" << std::endl;
+        std::cout << "=======================" << std::endl;
+        std::cout << "Shares: " << share_count << "; each pushes a timing sample, reads the average" << std::endl;
+        std::cout << "and pushes a nonce, as a fingerprint update does" << std::endl;
+        std::cout << std::endl;
+        std::cout << "Window  Vector ns/share  Ring ns/share  Speedup" << std::endl;
+        
+        size_t mismatches = 0;
+        mismatches += BenchWindowSize<10>(share_count);
+        mismatches += BenchWindowSize<100>(share_count);
+        mismatches += BenchWindowSize<1000>(share_count);
+        std::cout << std::endl;
+        std::cout << "Mismatched window statistics: " << mismatches << std::endl;
+    }
+    
+    /** One row of benchwindow; returns the mismatched checks */
+    template <size_t N>
+    size_t BenchWindowSize(size_t share_count) {
+        // Timestamps on a microsecond clock, the input that made running
+        // moments drift before they were resynced once per lap
+        std::mt19937_64 rng(N);
+        std::vector<uint64_t> timestamps(share_count);
+        std::vector<uint64_t> nonces(share_count);
+        uint64_t clock_us = 1700000000000000ULL;
+        for (size_t i = 0; i < share_count; ++i) {
+            clock_us += 1000 + rng() % 2000000;
+            timestamps[i] = clock_us;
+            nonces[i] = rng();
+        }
+        
+        // The vector windows shift out their oldest sample and rescan for
+        // the average, as fingerprints did before the ring buffers
+        double vector_checksum = 0;
+        std::vector<uint64_t> vector_timing;
+        std::vector<uint64_t> vector_nonces;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < share_count; ++i) {
+            if (vector_timing.size() >= N) {
+                vector_timing.erase(vector_timing.begin());
+            }
+            vector_timing.push_back(timestamps[i]);
+            vector_checksum += std::accumulate(vector_timing.begin(), vector_timing.end(), uint64_t{0}) /
+                               vector_timing.size();
+            if (vector_nonces.size() >= N) {
+                vector_nonces.erase(vector_nonces.begin());
+            }
+            vector_nonces.push_back(nonces[i]);
+        }
+        std::chrono::duration<double> vector_time = std::chrono::steady_clock::now() - start;
+        
+        double ring_checksum = 0;
+        PoDD::RingBuffer<uint64_t, N> ring_timing;
+        PoDD::RingBuffer<uint64_t, N> ring_nonces;
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < share_count; ++i) {
+            ring_timing.Push(timestamps[i]);
+            ring_checksum += ring_timing.Sum() / ring_timing.Size();
+            ring_nonces.Push(nonces[i]);
+        }
+        std::chrono::duration<double> ring_time = std::chrono::steady_clock::now() - start;
+        
+        // Same averages share by share, then the same window at the end,
+        // with the running variance within rounding of a fresh two-pass one
+        size_t mismatches = ring_checksum != vector_checksum;
+        mismatches += !std::equal(ring_timing.begin(), ring_timing.end(), vector_timing.begin(), vector_timing.end());
+        mismatches += !std::equal(ring_nonces.begin(), ring_nonces.end(), vector_nonces.begin(), vector_nonces.end());
+        double mean = static_cast<double>(std::accumulate(vector_timing.begin(), vector_timing.end(), uint64_t{0})) /
+                      vector_timing.size();
+        double squares = 0;
+        for (uint64_t t : vector_timing) {
+            squares += (t - mean) * (t - mean);
+        }
+        double variance = squares / vector_timing.size();
+        mismatches += std::abs(ring_timing.Variance() - variance) > 1e-9 * std::max(1.0, variance);
+        
+        double vector_ns = vector_time.count() * 1e9 / share_count;
+        double ring_ns = ring_time.count() * 1e9 / share_count;
+        std::cout << boost::format("%6d  %15.1f  %12.1f  %6.2fx") % N % vector_ns % ring_ns %
+                     (vector_ns / ring_ns) << std::endl;
+        return mismatches;
+    }
+    
+    void BenchSimilarity(size_t max_devices) {
+        if (max_devices < 2) {
+            std::cerr << "Error: At least 2 devices required" << std::endl;
+            return;
+        }
+        
+        // Honest devices spread over the timing range, plus farms of clones
+        // that copy one device's timing with a little jitter, behind shared
+        // addresses so both the IP and the timing grid are exercised
+        std::mt19937_64 rng(3);
+        std::vector<PoDD::DeviceFingerprint> fleet(max_devices);
+        std::vector<PoDD::InternedString> addresses(std::max<size_t>(1, max_devices / 8));
+        for (size_t i = 0; i < addresses.size(); ++i) {
+            addresses[i] = PoDD::InternedString::Intern("10." + std::to_string(i >> 16) + "." +
+                                                        std::to_string((i >> 8) & 0xFF) + "." +
+                                                        std::to_string(i & 0xFF));
+        }
+        const PoDD::InternedString firmware[] = {
+            PoDD::InternedString::Intern("2.0.0"), PoDD::InternedString::Intern("2.1.0"),
+            PoDD::InternedString::Intern("2.2.0"), PoDD::InternedString::Intern("2.3.0"),
+        };
+        std::uniform_int_distribution<uint64_t> jitter(0, 4000);
+        for (size_t i = 0; i < max_devices; ++i) {
+            auto& fp = fleet[i];
+            if (i > 0 && rng() % 4 == 0) {
+                const auto& original = fleet[rng() % i];
+                fp = original;
+                fp.avg_nonce_time_us = original.avg_nonce_time_us + jitter(rng);
+                fp.timing_variance_us = original.timing_variance_us + jitter(rng);
+                fp.power_consumption_watts = original.power_consumption_watts + (rng() % 5);
+            } else {
+                fp.avg_nonce_time_us = 500000 + rng() % 1000000;
+                fp.timing_variance_us = 2000 + rng() % 20000;
+                fp.ip_address = addresses[rng() % addresses.size()];
+                fp.avg_latency_ms = 10 + rng() % 190;
+                fp.firmware_version = firmware[rng() % 4];
+                fp.chip_count = 1 + rng() % 4;
+                fp.power_consumption_watts = 10 + rng() % 20;
+            }
+        }
+        
+        std::cout << "Similarity Index Benchmark" << std::endl;
+        std::cout << "==========================" << std::endl;
+        std::cout << "Up to 10000 devices every pair is checked against the pairwise loop;" << std::endl;
+        std::cout << "above that, every pair of 100 sampled devices." << std::endl;
+        std::cout << std::endl;
+        std::cout << "Devices  Threshold     Pairs   Index ms  Pairwise ms  Mismatched" << std::endl;
+        
+        const size_t full_check_limit = 10000;
+        const size_t sampled_rows = 100;
+        size_t total_mismatches = 0;
+        for (size_t devices = 1000; ; devices *= 10) {
+            devices = std::min(devices, max_devices);
+            std::vector<const PoDD::DeviceFingerprint*> views;
+            for (size_t i = 0; i < devices; ++i) {
+                views.push_back(&fleet[i]);
+            }
+            
+            // Below 0.85 the same-IP bonus no longer prunes on its own
+            for (double threshold : {0.8, PoDD::Similarity::SUSPICIOUS_THRESHOLD}) {
+                PoDD::SimilarityIndex index(threshold);
+                auto start = std::chrono::steady_clock::now();
+                auto pairs = index.FindSimilarPairs(views);
+                std::chrono::duration<double, std::milli> index_ms = std::chrono::steady_clock::now() - start;
+                
+                size_t mismatches = 0;
+                std::string pairwise_ms = "-";
+                if (devices <= full_check_limit) {
+                    start = std::chrono::steady_clock::now();
+                    auto expected = index.FindSimilarPairsBruteForce(views);
+                    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+                    pairwise_ms = (boost::format("%.1f") % elapsed.count()).str();
+                    // Both lists are in pairwise loop order, so they must match entry for entry
+                    size_t common = std::min(pairs.size(), expected.size());
+                    for (size_t k = 0; k < common; ++k) {
+                        mismatches += pairs[k] != expected[k];
+                    }
+                    mismatches += std::max(pairs.size(), expected.size()) - common;
+                } else {
+                    // Every pair of a sampled device, scored directly
+                    std::vector<std::vector<size_t>> found(devices);
+                    for (const auto& [i, j] : pairs) {
+                        found[i].push_back(j);
+                        found[j].push_back(i);
+                    }
+                    for (size_t s = 0; s < sampled_rows; ++s) {
+                        size_t row = rng() % devices;
+                        std::vector<size_t> expected;
+                        for (size_t j = 0; j < devices; ++j) {
+                            if (j != row && views[std::min(row, j)]->CalculateSimilarity(
+                                                *views[std::max(row, j)]) > threshold) {
+                                expected.push_back(j);
+                            }
+                        }
+                        std::sort(found[row].begin(), found[row].end());
+                        mismatches += found[row] != expected;
+                    }
+                }
+                total_mismatches += mismatches;
+                std::cout << boost::format("%7d  %9.2f  %8d  %9.1f  %11s  %10d") % devices % threshold %
+                             pairs.size() % index_ms.count() % pairwise_ms % mismatches << std::endl;
+            }
+            if (devices == max_devices) {
+                break;
+            }
+        }
+        
+        // The same through DeviceVerifier: a device list in any order and
+        // with repeated IDs must report exactly the pairs, in the same order,
+        // that scoring every pair of the list as given does
+        const size_t set_devices = std::min<size_t>(max_devices, 200);
+        const size_t set_trials = 1000;
+        PoDD::DeviceVerifier verifier;
+        std::vector<std::string> set_ids(set_devices);
+        for (size_t i = 0; i < set_devices; ++i) {
+            set_ids[i] = "SIMILARITY_" + std::to_string(i);
+            PoDD::DeviceFingerprint fp = fleet[i];
+            fp.device_id = PoDD::InternedString::Intern(set_ids[i]);
+            verifier.RegisterDevice(set_ids[i], fp);
+        }
+        size_t set_mismatches = 0;
+        size_t set_pairs = 0;
+        for (size_t trial = 0; trial < set_trials; ++trial) {
+            std::vector<size_t> picks(2 + rng() % 30);
+            for (auto& pick : picks) {
+                pick = rng() % set_devices;
+            }
+            for (size_t repeats = rng() % 3; repeats > 0; --repeats) {
+                picks.push_back(picks[rng() % picks.size()]);
+            }
+            std::shuffle(picks.begin(), picks.end(), rng);
+            
+            std::vector<std::string> list;
+            std::vector<std::pair<std::string, std::string>> expected;
+            for (size_t pick : picks) {
+                list.push_back(set_ids[pick]);
+            }
+            for (size_t i = 0; i < picks.size(); ++i) {
+                for (size_t j = i + 1; j < picks.size(); ++j) {
+                    double similarity = fleet[picks[i]].CalculateSimilarity(fleet[picks[j]]);
+                    if (similarity > PoDD::Similarity::SUSPICIOUS_THRESHOLD) {
+                        expected.emplace_back(list[i], list[j]);
+                    }
+                }
+            }
+            // The second call is answered from the cache
+            for (int call = 0; call < 2; ++call) {
+                set_mismatches += verifier.VerifyDeviceDistribution(list).suspicious_pairs != expected;
+            }
+            set_pairs += expected.size();
+        }
+        
+        std::cout << std::endl;
+        std::cout << "Mismatched pair lists: " << total_mismatches << std::endl;
+        std::cout << "Shuffled device lists with repeats: " << set_trials << " through VerifyDeviceDistribution, "
+                  << set_pairs << " pairs, " << set_mismatches << " mismatched" << std::endl;
+    }
+    
+    void BenchRegistry(size_t reader_count, size_t device_count) {
+        const size_t writer_count = 2;
+        if (reader_count == 0 || device_count < 2 * writer_count) {
+            std::cerr << "Error: Need a reader and at least " << 2 * writer_count << " devices" << std::endl;
+            return;
+        }
+        
+        // Each writer registers its own slice of the devices to its first
+        // owner. Devices at even positions in a slice are then passed back
+        // and forth between its two owners by a transfer thread; the others
+        // never move, so readers know who owns them.
+        KeyPtr key = GenerateKey();
+        if (!key) {
+            std::cerr << "Failed to generate owner key" << std::endl;
+            return;
+        }
+        const size_t per_writer = device_count / writer_count;
+        std::vector<std::array<std::string, 2>> owners(writer_count);
+        std::vector<std::vector<PoDD::DeviceRegistration>> slices(writer_count);
+        for (size_t w = 0; w < writer_count; ++w) {
+            owners[w] = {"sync1qstress" + std::to_string(w) + "a", "sync1qstress" + std::to_string(w) + "b"};
+            for (size_t i = 0; i < per_writer; ++i) {
+                PoDD::DeviceRegistration reg;
+                reg.device_id = "STRESS_" + std::to_string(w) + "_" + std::to_string(i);
+                reg.manufacturer = "Bitaxe";
+                reg.model = "Gamma";
+                reg.serial_number = reg.device_id;
+                reg.firmware_version = "2.1.0";
+                reg.chip_count = 1;
+                reg.max_hashrate_ghs = 1200;
+                reg.owner_address = owners[w][0];
+                if (!SignRegistration(reg, key.get())) {
+                    std::cerr << "Failed to sign device registration" << std::endl;
+                    return;
+                }
+                slices[w].push_back(std::move(reg));
+            }
+        }
+        
+        auto& registry = PoDD::DeviceRegistry::GetInstance();
+        registry.Restore({}, 0);
+        
+        const size_t batch_size = 16;
+        const size_t min_passes = 20;
+        std::vector<std::atomic<size_t>> registered(writer_count);     // Committed prefix of each slice
+        std::vector<std::atomic<bool>> writer_done(writer_count);
+        std::atomic<bool> stop{false};
+        std::atomic<size_t> transfers{0};
+        std::atomic<size_t> reads{0};
+        std::atomic<size_t> mismatches{0};
+        std::vector<std::vector<uint8_t>> final_owner(writer_count, std::vector<uint8_t>(per_writer, 0));
+        
+        std::vector<std::thread> threads;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t w = 0; w < writer_count; ++w) {
+            threads.emplace_back([&, w] {
+                const auto& slice = slices[w];
+                for (size_t begin = 0; begin < per_writer; begin += batch_size) {
+                    size_t end = std::min(begin + batch_size, per_writer);
+                    std::vector<PoDD::DeviceRegistration> batch(slice.begin() + begin, slice.begin() + end);
+                    if (!registry.RegisterDevices(batch).committed) {
+                        ++mismatches;
+                    }
+                    registered[w].store(end, std::memory_order_release);
+                }
+                writer_done[w].store(true, std::memory_order_release);
+            });
+            threads.emplace_back([&, w] {
+                auto& owner_of = final_owner[w];
+                size_t passes = 0;
+                size_t last_count = 0;
+                size_t local = 0;
+                // Pass over the registered devices each time a batch lands,
+                // then a few more times once the slice is complete
+                while (passes < min_passes) {
+                    bool complete = writer_done[w].load(std::memory_order_acquire);
+                    size_t count = registered[w].load(std::memory_order_acquire);
+                    if (!complete && count == last_count) {
+                        std::this_thread::yield();
+                        continue;
+                    }
+                    last_count = count;
+                    for (size_t i = 0; i < count; i += 2) {
+                        uint8_t from = owner_of[i];
+                        if (registry.TransferDevice(slices[w][i].device_id, owners[w][from], owners[w][1 - from])) {
+                            owner_of[i] = 1 - from;
+                            ++local;
+                        } else {
+                            ++mismatches;
+                        }
+                    }
+                    passes += complete;
+                }
+                transfers += local;
+            });
+        }
+        for (size_t r = 0; r < reader_count; ++r) {
+            threads.emplace_back([&, r] {
+                std::mt19937 rng(static_cast<uint32_t>(r + 1));
+                uint64_t last_sequence = 0;
+                uint32_t last_total = 0;
+                size_t local = 0;
+                size_t bad = 0;
+                while (!stop.load(std::memory_order_acquire)) {
+                    // The registry only grows, and every change advances the sequence
+                    uint64_t sequence = registry.GetSequence();
+                    uint32_t total = registry.GetTotalRegisteredDevices();
+                    bad += sequence < last_sequence || total < last_total;
+                    last_sequence = sequence;
+                    last_total = total;
+                    
+                    // A committed device that never moves is owned by its first owner
+                    size_t w = rng() % writer_count;
+                    size_t count = registered[w].load(std::memory_order_acquire);
+                    if (count > 1) {
+                        size_t i = (rng() % (count / 2)) * 2 + 1;
+                        bad += !registry.VerifyDeviceOwnership(slices[w][i].device_id, owners[w][0]);
+                    }
+                    
+                    // An owner's list never names a device twice
+                    auto owned = registry.GetOwnerDevices(owners[w][rng() % 2]);
+                    std::sort(owned.begin(), owned.end());
+                    bad += std::adjacent_find(owned.begin(), owned.end()) != owned.end() ||
+                           owned.size() > per_writer;
+                    local += 5;
+                }
+                reads += local;
+                mismatches += bad;
+            });
+        }
+        for (size_t t = 0; t < 2 * writer_count; ++t) {
+            threads[t].join();
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        stop.store(true, std::memory_order_release);
+        for (size_t t = 2 * writer_count; t < threads.size(); ++t) {
+            threads[t].join();
+        }
+        
+        // Every device ends up with the owner its transfer thread left it with
+        size_t final_mismatches = 0;
+        for (size_t w = 0; w < writer_count; ++w) {
+            size_t owned = 0;
+            for (size_t o = 0; o < 2; ++o) {
+                owned += registry.GetOwnerDevices(owners[w][o]).size();
+            }
+            final_mismatches += owned != per_writer;
+            for (size_t i = 0; i < per_writer; ++i) {
+                final_mismatches += !registry.VerifyDeviceOwnership(slices[w][i].device_id,
+                                                                    owners[w][final_owner[w][i]]);
+            }
+        }
+        final_mismatches += registry.GetTotalRegisteredDevices() != writer_count * per_writer;
+        final_mismatches += registry.GetSequence() != writer_count * per_writer + transfers;
+        
+        std::cout << "Registry Stress Test" << std::endl;
+        std::cout << "====================" << std::endl;
+        std::cout << "Devices: " << writer_count * per_writer << " registered by " << writer_count
+                  << " writers in batches of " << batch_size << std::endl;
+        std::cout << "Transfers: " << transfers << " on " << writer_count << " threads" << std::endl;
+        std::cout << "Reads: " << reads << " on " << reader_count << " threads" << std::endl;
+        std::cout << "Elapsed: " << boost::format("%.2f s") % elapsed.count() << std::endl;
+        std::cout << "Mismatched reads and writes: " << mismatches << std::endl;
+        std::cout << "Mismatched final state: " << final_mismatches << std::endl;
+    }
+    
+    void BenchSoak(size_t reward_count) {
+        if (reward_count == 0) {
+            std::cerr << "Error: Reward count must be positive" << std::endl;
+            return;
+        }
+        using Mining::RewardStatistics;
+        
+        // A steady pool: 20 payouts a block from 20000 miners, a few large
+        // ones paid far more often
+        std::mt19937_64 rng(22);
+        const size_t miner_count = 20000;
+        const size_t rewards_per_block = 20;
+        std::vector<Mining::MinerInfo> miners(miner_count);
+        for (size_t i = 0; i < miner_count; ++i) {
+            auto& miner = miners[i];
+            miner.address = "sync1qsoak" + std::to_string(i);
+            miner.hashrate_ths = std::exp2(std::uniform_real_distribution<double>(-4.0, 8.0)(rng));
+            miner.is_podd_verified = rng() % 2 == 0;
+            miner.is_squad_member = false;
+        }
+        
+        // Paid per height, to check the window's totals against
+        std::vector<uint64_t> paid(RewardStatistics::WINDOW);
+        std::vector<uint64_t> small_paid(RewardStatistics::WINDOW);
+        auto peak_rss_kb = [] {
+            rusage usage;
+            getrusage(RUSAGE_SELF, &usage);
+            return usage.ru_maxrss;
+        };
+        
+        std::cout << "Reward Soak Test" << std::endl;
+        std::cout << "================" << std::endl;
+        std::cout << rewards_per_block << " rewards a block from " << miner_count << " miners, window of "
+                  << RewardStatistics::WINDOW << " blocks" << std::endl;
+        std::cout << std::endl;
+        std::cout << "   Rewards    Height  Peak RSS (kB)  Window paid" << std::endl;
+        
+        RewardStatistics statistics;
+        const size_t checkpoint = std::max<size_t>(1, reward_count / 10);
+        size_t mismatches = 0;
+        long first_rss = 0;
+        long last_rss = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t n = 0; n < reward_count; ++n) {
+            int32_t height = static_cast<int32_t>(n / rewards_per_block);
+            size_t slot = height % RewardStatistics::WINDOW;
+            if (n % rewards_per_block == 0) {
+                paid[slot] = 0;
+                small_paid[slot] = 0;
+            }
+            
+            std::uniform_int_distribution<size_t> any(0, miner_count - 1);
+            const auto& miner = miners[std::min(any(rng), any(rng))];
+            Mining::RewardBreakdown reward;
+            reward.total_reward = 100000 + static_cast<int64_t>(rng() % 5000000000ULL);
+            statistics.RecordReward(height, miner, reward);
+            paid[slot] += reward.total_reward;
+            if (miner.hashrate_ths < 10.0) {      // RecordReward()'s small-miner cutoff
+                small_paid[slot] += reward.total_reward;
+            }
+            
+            if ((n + 1) % checkpoint == 0 || n + 1 == reward_count) {
+                auto stats = statistics.GetStatistics();
+                uint64_t expected_paid = 0;
+                uint64_t expected_small = 0;
+                for (size_t s = 0; s < RewardStatistics::WINDOW; ++s) {
+                    expected_paid += paid[s];
+                    expected_small += small_paid[s];
+                }
+                mismatches += stats.total_rewards_paid != expected_paid ||
+                              stats.rewards_to_small_miners != expected_small;
+                
+                last_rss = peak_rss_kb();
+                if (first_rss == 0) {
+                    first_rss = last_rss;
+                }
+                std::cout << boost::format("%10d  %8d  %13d  %11.0f") % (n + 1) % height % last_rss %
+                             (stats.total_rewards_paid / 1e8) << std::endl;
+            }
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        
+        std::cout << std::endl;
+        std::cout << "Rate: " << boost::format("%.0f rewards/s") % (reward_count / elapsed.count()) << std::endl;
+        std::cout << "Peak RSS growth after the first checkpoint: " << last_rss - first_rss << " kB" << std::endl;
+        std::cout << "Mismatched window totals: " << mismatches << std::endl;
+    }
 };
 
 int main(int argc, char* argv[]) {
@@ -5,12 +5,17 @@
 #include <string>
 #include <thread>
 #include <csignal>
+#include <memory>
 #include <boost/program_options.hpp>
 #include <boost/filesystem.hpp>
 
 #include "consensus/params.h"
 #include "podd/device_verifier.h"
+#include "podd/registry_store.h"
+#include "podd/spoofing_auditor.h"
+#include "mining/network_metrics.h"
 #include "mining/reward_calculator.h"
+#include "mining/reward_history.h"
 
 namespace po = boost::program_options;
 namespace fs = boost::filesystem;
@@ -28,7 +33,8 @@ public:
     SyncNode(const Consensus::Params& params) 
         : m_params(params), 
           m_device_verifier(),
-          m_reward_calculator(params) {
+          m_network_metrics(params),
+          m_reward_calculator(params, &m_device_verifier, &m_network_metrics) {
     }
     
     bool Initialize(const po::variables_map& vm) {
@@ -50,6 +56,16 @@ public:
             fs::create_directories(m_datadir);
         }
         
+        // Restore the PoDD registry and journal every change from here on
+        if (!LoadRegistry()) {
+            return false;
+        }
+        
+        // Reopen the reward history kept column by column on disk
+        if (!LoadRewardHistory()) {
+            return false;
+        }
+        
         // Initialize network
         if (vm.count("testnet")) {
             std::cout << "Running on TESTNET" << std::endl;
@@ -76,6 +92,16 @@ public:
             std::cout << "  • Small miner bonuses active" << std::endl;
         }
         
+        // Start the periodic registry audit (runs on its own threads)
+        size_t audit_threads = 0;
+        if (vm.count("auditthreads")) {
+            audit_threads = vm["auditthreads"].as<size_t>();
+        }
+        m_auditor = std::make_unique<PoDD::SpoofingAuditor>(
+            m_device_verifier, m_params.podd.nVerificationInterval, audit_threads);
+        std::cout << "PoDD audit every " << m_params.podd.nVerificationInterval << " blocks on "
+                  << m_auditor->GetProgress().thread_count << " threads" << std::endl;
+        
         // Initialize PoDD if devices provided
         if (vm.count("devices")) {
             auto devices = vm["devices"].as<std::vector<std::string>>();
@@ -83,8 +109,8 @@ public:
             
             for (const auto& device_id : devices) {
                 PoDD::DeviceFingerprint fp;
-                fp.device_id = device_id;
-                fp.firmware_version = "1.0.0"; // Would get from device
+                fp.device_id = PoDD::InternedString::Intern(device_id);
+                fp.firmware_version = PoDD::InternedString::Intern("1.0.0"); // Would get from device
                 fp.chip_count = 1; // Bitaxe typically has 1 chip
                 
                 if (m_device_verifier.RegisterDevice(device_id, fp)) {
@@ -113,6 +139,19 @@ public:
         std::cout << "  • 10-100 TH/s: " << m_params.minerBoost.tier3_multiplier << "x" << std::endl;
         std::cout << "  • >100 TH/s:   " << m_params.minerBoost.tier4_multiplier << "x" << std::endl;
         
+        // Audit whatever was registered at startup
+        if (m_device_verifier.GetDeviceCount() > 0) {
+            m_auditor->RequestAudit(m_tip_height);
+        }
+        
+        // Nothing calls OnBlockConnected until block validation exists, so
+        // the loop re-audits once the audit interval's worth of block time
+        // has passed. The first connected block hands the schedule over to
+        // the block hooks.
+        const auto audit_period = std::chrono::seconds(
+            m_params.nPowTargetSpacing * m_params.podd.nVerificationInterval);
+        auto last_audit = std::chrono::steady_clock::now();
+        
         // Main loop
         while (!g_shutdown) {
             // Simulate node operations
@@ -120,12 +159,147 @@ public:
             
             // In real implementation:
             // - Process network messages
-            // - Validate blocks
-            // - Update PoDD verifications
+            // - Validate blocks (calling OnBlockConnected)
             // - Handle mining if enabled
+            
+            auto now = std::chrono::steady_clock::now();
+            if (!m_blocks_connected && now - last_audit >= audit_period) {
+                m_auditor->RequestAudit(m_tip_height);
+                last_audit = now;
+            }
+            
+            ReportAuditResults();
+            PersistRegistry();
+            if (!m_reward_history->Flush()) {
+                std::cerr << "Reward history write failed" << std::endl;
+            }
         }
         
         std::cout << "Node shutting down..." << std::endl;
+        m_auditor.reset(); // Let a running audit finish before teardown
+        
+        std::string error;
+        if (!m_registry_store->Checkpoint(error)) {
+            std::cerr << "PoDD registry checkpoint failed: " << error << std::endl;
+        }
+        m_registry_store->Detach();
+        m_reward_history->Close();
+    }
+    
+    bool LoadRegistry() {
+        m_registry_store = std::make_unique<PoDD::RegistryStore>((m_datadir / "podd").string());
+        
+        PoDD::RegistryLoadStats stats;
+        std::string error;
+        PoDD::DeviceRegistry& registry = PoDD::DeviceRegistry::GetInstance();
+        if (!m_registry_store->Load(m_device_verifier, registry, stats, error) ||
+            !m_registry_store->Attach(m_device_verifier, registry, error)) {
+            std::cerr << "Cannot load PoDD registry: " << error << std::endl;
+            return false;
+        }
+        
+        if (stats.snapshot_found || stats.journal_entries > 0) {
+            std::cout << "PoDD registry: " << stats.devices_restored << " devices, "
+                      << stats.registrations_restored << " registrations, "
+                      << stats.journal_entries_applied << " journal entries in "
+                      << (stats.snapshot_time + stats.journal_time).count() / 1000.0 << " ms"
+                      << std::endl;
+            if (stats.journal_truncated) {
+                std::cout << "  Journal ended in a torn entry; it was ignored" << std::endl;
+            }
+        }
+        return true;
+    }
+    
+    bool LoadRewardHistory() {
+        m_reward_history = std::make_unique<Mining::RewardHistory>((m_datadir / "rewards").string(), m_params);
+        
+        std::string error;
+        if (!m_reward_history->Open(error)) {
+            std::cerr << "Cannot open reward history: " << error << std::endl;
+            return false;
+        }
+        m_reward_statistics = std::make_unique<Mining::RewardStatistics>(m_reward_history.get());
+        
+        if (m_reward_history->Size() > 0) {
+            std::cout << "Reward history: " << m_reward_history->Size() << " rewards to "
+                      << m_reward_history->GetAddressCount() << " addresses, up to height "
+                      << m_reward_history->GetTipHeight() << std::endl;
+        }
+        return true;
+    }
+    
+    /** Write journaled changes out and checkpoint once the journal is large */
+    void PersistRegistry() {
+        std::string error;
+        if (!m_registry_store->Flush()) {
+            std::cerr << "PoDD registry journal write failed" << std::endl;
+        }
+        if (m_registry_store->GetJournalSize() >= PoDD::RegistryStore::CHECKPOINT_JOURNAL_BYTES &&
+            !m_registry_store->Checkpoint(error)) {
+            std::cerr << "PoDD registry checkpoint failed: " << error << std::endl;
+        }
+    }
+    
+    /**
+     * Hook for block validation: advances the tip and schedules the
+     * periodic PoDD re-verification
+     */
+    void OnBlockConnected(uint32_t height) {
+        m_tip_height = height;
+        m_blocks_connected = true;
+        m_auditor->OnBlockConnected(height);
+    }
+    
+    /**
+     * Hook for block validation: records the reward paid by a connected block
+     * and counts its producer in the decentralization metrics
+     */
+    void OnRewardPaid(int32_t height, const Mining::MinerInfo& miner,
+                      const Mining::RewardBreakdown& reward) {
+        if (!m_reward_statistics->RecordReward(height, miner, reward)) {
+            std::cerr << "Reward history rejected the reward at height " << height << std::endl;
+        }
+        m_network_metrics.OnBlockConnected(height, miner);
+    }
+    
+    /**
+     * Hook for block validation: takes the reward of a block disconnected
+     * from the tip back out of the statistics, the on-disk history and the
+     * decentralization metrics
+     */
+    void OnBlockDisconnected(uint32_t height) {
+        m_tip_height = height > 0 ? height - 1 : 0;
+        if (!m_reward_statistics->DisconnectBlock(static_cast<int32_t>(height))) {
+            std::cerr << "Reward history rewind failed at height " << height << std::endl;
+        }
+        m_network_metrics.OnBlockDisconnected(static_cast<int32_t>(height));
+    }
+    
+    void ReportAuditResults() {
+        PoDD::AuditProgress progress = m_auditor->GetProgress();
+        if (progress.audits_completed == m_audits_reported) {
+            return;
+        }
+        m_audits_reported = progress.audits_completed;
+        
+        PoDD::AuditReport report;
+        if (!m_auditor->GetLastReport(report)) {
+            return;
+        }
+        
+        std::cout << "PoDD audit at height " << report.height << ": "
+                  << report.devices_audited << " devices in " << report.partitions << " partitions, "
+                  << report.squads_audited << " squads" << std::endl;
+        std::cout << "  Suspicious pairs: " << report.suspicious_pairs.size()
+                  << " (+" << report.new_pairs.size() << " / -" << report.cleared_pairs.size() << ")"
+                  << ", failed squads: " << report.failed_squads.size() << std::endl;
+        std::cout << "  Time: " << report.total_time.count() / 1000.0 << " ms"
+                  << " (snapshot " << report.snapshot_time.count() / 1000.0
+                  << ", similarity " << report.similarity_time.count() / 1000.0
+                  << ", squads " << report.squad_time.count() / 1000.0 << ")"
+                  << ", tasks " << report.tasks_run << " (" << report.tasks_stolen << " stolen)"
+                  << std::endl;
     }
     
     void ShowExampleReward() {
@@ -134,7 +308,7 @@ public:
         Mining::MinerInfo miner;
         miner.address = "sync1qexample...";
         miner.hashrate_ths = 0.5; // 500 GH/s (typical Bitaxe)
-        miner.device_ids = {"BITAXE_001"};
+        miner.device_ids = {PoDD::InternedString::Intern("BITAXE_001")};
         miner.is_podd_verified = true;
         miner.efficiency_score = 0.8;
         
@@ -152,7 +326,16 @@ public:
 private:
     Consensus::Params m_params;
     PoDD::DeviceVerifier m_device_verifier;
+    std::unique_ptr<PoDD::SpoofingAuditor> m_auditor;
+    std::unique_ptr<PoDD::RegistryStore> m_registry_store;
+    Mining::NetworkMetrics m_network_metrics;
     Mining::RewardCalculator m_reward_calculator;
+    std::unique_ptr<Mining::RewardHistory> m_reward_history;
+    std::unique_ptr<Mining::RewardStatistics> m_reward_statistics;
+    
+    uint32_t m_tip_height = 0;
+    bool m_blocks_connected = false;    // Block hooks drive the audit schedule once set
+    uint32_t m_audits_reported = 0;
     
     fs::path m_datadir;
     std::string m_miner_address;
@@ -171,11 +354,14 @@ int main(int argc, char* argv[]) {
             ("datadir", po::value<std::string>(), "Data directory path")
             ("testnet", "Use testnet")
             ("regtest", "Use regtest mode")
+            ("activationheight", po::value<std::vector<std::string>>()->multitoken(),
+             "Activate a feature at a height, as name@height (regtest only)")
             ("bitaxe", "Enable Bitaxe optimization mode")
             ("mineraddress", po::value<std::string>(), "Address to mine to")
             ("devices", po::value<std::vector<std::string>>()->multitoken(), 
              "Device IDs to register for PoDD")
             ("showreward", "Show example reward calculation")
+            ("auditthreads", po::value<size_t>(), "Threads for the periodic PoDD audit (default: all cores)")
             ("daemon", "Run in background")
             ("rpcport", po::value<int>()->default_value(8332), "RPC port")
             ("p2pport", po::value<int>()->default_value(8333), "P2P port");
@@ -210,6 +396,27 @@ int main(int argc, char* argv[]) {
             params = regtest_params;
         }
         
+        if (vm.count("activationheight")) {
+            if (!vm.count("regtest")) {
+                std::cerr << "Error: -activationheight is only allowed on regtest" << std::endl;
+                return 1;
+            }
+            for (const auto& entry : vm["activationheight"].as<std::vector<std::string>>()) {
+                size_t at = entry.find('@');
+                int32_t height = -1;
+                if (at != std::string::npos) {
+                    try {
+                        height = std::stoi(entry.substr(at + 1));
+                    } catch (const std::exception&) {
+                    }
+                }
+                if (height < 0 || !params.SetActivationHeight(entry.substr(0, at), height)) {
+                    std::cerr << "Error: Invalid activation height: " << entry << std::endl;
+                    return 1;
+                }
+            }
+        }
+        
         // Create and initialize node
         SyncNode node(params);
         